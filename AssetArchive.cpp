@@ -0,0 +1,349 @@
+#include "AssetArchive.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stb_image.h>
+
+#include "CpuProfiler.h"
+#include "Log.h"
+
+using namespace AssetArchiveFormat;
+
+namespace
+{
+	const Header& GetHeader(const unsigned char* Base)
+	{
+		return *reinterpret_cast<const Header*>(Base);
+	}
+
+	const Entry* GetSlots(const unsigned char* Base)
+	{
+		return reinterpret_cast<const Entry*>(Base + sizeof(Header));
+	}
+
+	bool IsValidLayout(const unsigned char* Base, size_t FileSize)
+	{
+		if (FileSize < sizeof(Header))
+		{
+			return false;
+		}
+
+		const Header& Head = GetHeader(Base);
+		if (Head.Magic != Magic || Head.Version != Version)
+		{
+			return false;
+		}
+
+		//A full table would make a missing name probe forever
+		if (Head.NumSlots == 0 || (Head.NumSlots & (Head.NumSlots - 1)) != 0 || Head.NumEntries >= Head.NumSlots)
+		{
+			return false;
+		}
+
+		if (sizeof(Header) + uint64_t{ Head.NumSlots } * sizeof(Entry) > FileSize
+			|| Head.NamesOffset > FileSize || Head.NamesSize > FileSize - Head.NamesOffset)
+		{
+			return false;
+		}
+
+		const Entry* Slots = GetSlots(Base);
+		uint32_t NumEntries = 0;
+		for (uint32_t Slot = 0; Slot < Head.NumSlots; ++Slot)
+		{
+			const Entry& Current = Slots[Slot];
+			if (Current.NameLength == 0)
+			{
+				continue;
+			}
+
+			const bool bCompressed = (Current.Flags & Compressed) != 0;
+			if (uint64_t{ Current.NameOffset } + Current.NameLength > Head.NamesSize
+				|| Current.Offset > FileSize || Current.StoredSize > FileSize - Current.Offset
+				|| (!bCompressed && Current.StoredSize != Current.Size))
+			{
+				return false;
+			}
+			++NumEntries;
+		}
+
+		return NumEntries == Head.NumEntries;
+	}
+}
+
+AssetData::~AssetData()
+{
+	Reset();
+}
+
+AssetData::AssetData(AssetData&& Other) noexcept
+	: Data(std::exchange(Other.Data, nullptr))
+	, Size(std::exchange(Other.Size, 0))
+	, FreeFunction(std::exchange(Other.FreeFunction, nullptr))
+{
+}
+
+AssetData& AssetData::operator=(AssetData&& Other) noexcept
+{
+	if (this != &Other)
+	{
+		Reset();
+		Data = std::exchange(Other.Data, nullptr);
+		Size = std::exchange(Other.Size, 0);
+		FreeFunction = std::exchange(Other.FreeFunction, nullptr);
+	}
+	return *this;
+}
+
+AssetData AssetData::MakeView(const unsigned char* Data, size_t Size)
+{
+	AssetData View;
+	View.Data = Data;
+	View.Size = Size;
+	return View;
+}
+
+AssetData AssetData::MakeOwned(unsigned char* Data, size_t Size, void (*FreeFunction)(void*))
+{
+	AssetData Owned;
+	Owned.Data = Data;
+	Owned.Size = Size;
+	Owned.FreeFunction = FreeFunction;
+	return Owned;
+}
+
+void AssetData::Reset()
+{
+	if (FreeFunction != nullptr)
+	{
+		FreeFunction(const_cast<unsigned char*>(Data));
+	}
+	Data = nullptr;
+	Size = 0;
+	FreeFunction = nullptr;
+}
+
+AssetArchive::~AssetArchive()
+{
+	Close();
+}
+
+bool AssetArchive::Open(const char* FilePath)
+{
+	PROFILE_FUNCTION();
+	Close();
+
+#if defined(_WIN32)
+	HANDLE File = CreateFileA(FilePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER Size;
+	HANDLE Mapping = nullptr;
+	if (GetFileSizeEx(File, &Size) && Size.QuadPart > 0)
+	{
+		Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+
+	if (Mapping == nullptr)
+	{
+		CloseHandle(File);
+		return false;
+	}
+
+	Base = static_cast<const unsigned char*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+	FileSize = static_cast<size_t>(Size.QuadPart);
+	FileHandle = File;
+	MappingHandle = Mapping;
+#else
+	const int File = open(FilePath, O_RDONLY | O_CLOEXEC);
+	if (File < 0)
+	{
+		return false;
+	}
+
+	//The mapping keeps the file alive, the descriptor is not needed past mmap
+	struct stat Status;
+	void* Mapping = MAP_FAILED;
+	if (fstat(File, &Status) == 0 && Status.st_size > 0)
+	{
+		Mapping = mmap(nullptr, static_cast<size_t>(Status.st_size), PROT_READ, MAP_PRIVATE, File, 0);
+	}
+	close(File);
+
+	if (Mapping == MAP_FAILED)
+	{
+		return false;
+	}
+
+	Base = static_cast<const unsigned char*>(Mapping);
+	FileSize = static_cast<size_t>(Status.st_size);
+#endif
+
+	if (Base == nullptr || !IsValidLayout(Base, FileSize))
+	{
+		std::cout << "Invalid asset archive " << FilePath << std::endl;
+		Close();
+		return false;
+	}
+
+	std::cout << "Asset archive " << FilePath << ": " << GetNumEntries() << " entries, "
+		<< FileSize / 1024 << " KB mapped" << std::endl;
+	return true;
+}
+
+void AssetArchive::Close()
+{
+#if defined(_WIN32)
+	if (Base != nullptr)
+	{
+		UnmapViewOfFile(Base);
+	}
+	if (MappingHandle != nullptr)
+	{
+		CloseHandle(MappingHandle);
+	}
+	if (FileHandle != nullptr)
+	{
+		CloseHandle(FileHandle);
+	}
+	MappingHandle = nullptr;
+	FileHandle = nullptr;
+#else
+	if (Base != nullptr)
+	{
+		munmap(const_cast<unsigned char*>(Base), FileSize);
+	}
+#endif
+
+	Base = nullptr;
+	FileSize = 0;
+}
+
+uint32_t AssetArchive::GetNumEntries() const
+{
+	return IsOpen() ? GetHeader(Base).NumEntries : 0;
+}
+
+const Entry* AssetArchive::Find(const char* Name) const
+{
+	if (!IsOpen())
+	{
+		return nullptr;
+	}
+
+	const Header& Head = GetHeader(Base);
+	const Entry* Slots = GetSlots(Base);
+	const char* Names = reinterpret_cast<const char*>(Base + Head.NamesOffset);
+
+	const size_t Length = std::strlen(Name);
+	const uint64_t Hash = HashName(Name, Length);
+	const uint32_t Mask = Head.NumSlots - 1;
+
+	for (uint32_t Slot = static_cast<uint32_t>(Hash) & Mask; ; Slot = (Slot + 1) & Mask)
+	{
+		const Entry& Current = Slots[Slot];
+		if (Current.NameLength == 0)
+		{
+			return nullptr;
+		}
+
+		if (Current.NameHash == Hash && Current.NameLength == Length
+			&& std::memcmp(Names + Current.NameOffset, Name, Length) == 0)
+		{
+			return &Current;
+		}
+	}
+}
+
+AssetData AssetArchive::Read(const char* Name) const
+{
+	const Entry* Found = Find(Name);
+	if (Found == nullptr)
+	{
+		return AssetData();
+	}
+
+	const unsigned char* Stored = Base + Found->Offset;
+	if ((Found->Flags & Compressed) == 0)
+	{
+		return AssetData::MakeView(Stored, static_cast<size_t>(Found->Size));
+	}
+
+	PROFILE_SCOPE("InflateAsset");
+
+	int InflatedSize = 0;
+	char* Inflated = stbi_zlib_decode_malloc_guesssize(reinterpret_cast<const char*>(Stored),
+		static_cast<int>(Found->StoredSize), static_cast<int>(Found->Size), &InflatedSize);
+
+	if (Inflated == nullptr || static_cast<uint64_t>(InflatedSize) != Found->Size)
+	{
+		LOG_ERROR("Archive: could not inflate %s", Name);
+		stbi_image_free(Inflated);
+		return AssetData();
+	}
+
+	return AssetData::MakeOwned(reinterpret_cast<unsigned char*>(Inflated), static_cast<size_t>(InflatedSize), stbi_image_free);
+}
+
+AssetData AssetArchive::ReadOrLoad(const char* Name) const
+{
+	if (IsOpen())
+	{
+		AssetData Data = Read(Name);
+		if (Data.IsValid())
+		{
+			return Data;
+		}
+		LOG_WARNING("Archive: %s is not packed, reading the file", Name);
+	}
+
+	return LoadFile(Name);
+}
+
+AssetData LoadFile(const char* FilePath)
+{
+	std::FILE* File = std::fopen(FilePath, "rb");
+	if (File == nullptr)
+	{
+		return AssetData();
+	}
+
+	unsigned char* Data = nullptr;
+	long Size = -1;
+	if (std::fseek(File, 0, SEEK_END) == 0 && (Size = std::ftell(File)) >= 0 && std::fseek(File, 0, SEEK_SET) == 0)
+	{
+		//One extra byte so an empty file still gives a valid pointer
+		Data = static_cast<unsigned char*>(std::malloc(static_cast<size_t>(Size) + 1));
+		if (Data != nullptr && std::fread(Data, 1, static_cast<size_t>(Size), File) != static_cast<size_t>(Size))
+		{
+			std::free(Data);
+			Data = nullptr;
+		}
+	}
+	std::fclose(File);
+
+	if (Data == nullptr)
+	{
+		return AssetData();
+	}
+
+	return AssetData::MakeOwned(Data, static_cast<size_t>(Size), std::free);
+}
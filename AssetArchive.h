@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Packed asset archive.
+// AssetPacker writes the shaders and textures into one file: a header, a
+// hash table of entries keyed by path, the paths, then the contents of every
+// entry starting on its own page. At runtime the whole file is memory mapped
+// once and an asset is a pointer into the mapping, no read calls and no copy.
+// Entries can be stored zlib compressed, they are inflated with the decoder
+// of stb_image on read.
+//
+// The layout is native endian, the packer and the game run on the same kind
+// of machine.
+namespace AssetArchiveFormat
+{
+	constexpr uint32_t Magic = 0x4B415042; // "BPAK"
+	constexpr uint32_t Version = 1;
+
+	// Alignment of the entry contents in the file
+	constexpr uint64_t PageSize = 4096;
+
+	enum EntryFlags : uint32_t
+	{
+		Compressed = 1 << 0
+	};
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t NumEntries;
+
+		// Slots of the entry table, a power of two, an empty slot has no name
+		uint32_t NumSlots;
+		uint64_t NamesOffset;
+		uint64_t NamesSize;
+	};
+
+	// Slots follow the header
+	struct Entry
+	{
+		uint64_t NameHash;
+		uint64_t Offset;
+		uint64_t StoredSize;
+		uint64_t Size;
+		uint32_t NameOffset;
+		uint32_t NameLength;
+		uint32_t Flags;
+		uint32_t Reserved;
+	};
+
+	// FNV-1a of the path, the table is probed linearly from Hash & (NumSlots - 1)
+	inline uint64_t HashName(const char* Name, size_t Length)
+	{
+		uint64_t Hash = 14695981039346656037ull;
+		for (size_t Index = 0; Index < Length; ++Index)
+		{
+			Hash = (Hash ^ static_cast<unsigned char>(Name[Index])) * 1099511628211ull;
+		}
+		return Hash;
+	}
+}
+
+// Contents of an asset: a view into the archive mapping, or a buffer owned
+// until destruction (inflated entries, loose files)
+class AssetData
+{
+public:
+
+	AssetData() = default;
+	~AssetData();
+
+	AssetData(AssetData&& Other) noexcept;
+	AssetData& operator=(AssetData&& Other) noexcept;
+
+	AssetData(const AssetData&) = delete;
+	AssetData& operator=(const AssetData&) = delete;
+
+	static AssetData MakeView(const unsigned char* Data, size_t Size);
+
+	// FreeFunction releases Data when the asset data is destroyed
+	static AssetData MakeOwned(unsigned char* Data, size_t Size, void (*FreeFunction)(void*));
+
+	const unsigned char* GetData() const { return Data; }
+	const char* GetText() const { return reinterpret_cast<const char*>(Data); }
+	size_t GetSize() const { return Size; }
+	bool IsValid() const { return Data != nullptr; }
+
+	// True when the contents point into the archive mapping
+	bool IsView() const { return Data != nullptr && FreeFunction == nullptr; }
+
+	void Reset();
+
+private:
+
+	const unsigned char* Data = nullptr;
+	size_t Size = 0;
+	void (*FreeFunction)(void*) = nullptr;
+};
+
+// Read-only view of an archive. Find and Read can be called from any thread
+// once Open returned
+class AssetArchive
+{
+public:
+
+	AssetArchive() = default;
+	~AssetArchive();
+
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive& operator=(const AssetArchive&) = delete;
+
+	// Map the file and validate its table, false if missing or malformed
+	bool Open(const char* FilePath);
+	void Close();
+
+	bool IsOpen() const { return Base != nullptr; }
+	uint32_t GetNumEntries() const;
+
+	// Entry stored for the path, nullptr if not in the archive
+	const AssetArchiveFormat::Entry* Find(const char* Name) const;
+
+	// Contents of the entry: a view for stored entries, an inflated buffer for
+	// compressed ones. Invalid if not in the archive or corrupted
+	AssetData Read(const char* Name) const;
+
+	// Read from the archive when open and the entry exists, else from the file
+	AssetData ReadOrLoad(const char* Name) const;
+
+private:
+
+	const unsigned char* Base = nullptr;
+	size_t FileSize = 0;
+
+#if defined(_WIN32)
+	void* FileHandle = nullptr;
+	void* MappingHandle = nullptr;
+#endif
+};
+
+// Whole file in an owned buffer, for assets outside the archive
+AssetData LoadFile(const char* FilePath);
@@ -0,0 +1,286 @@
+#include "AssetManager.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "CpuProfiler.h"
+#include "Log.h"
+
+AssetManager::~AssetManager()
+{
+	//The reads and decode jobs point to this manager
+	WaitForJobs();
+}
+
+void AssetManager::WaitForJobs()
+{
+	//A completed read schedules its decode before it stops counting
+	while (ReadsInFlight.load(std::memory_order_acquire) != 0)
+	{
+		if (!JobSystem::RunOneJob())
+		{
+			std::this_thread::yield();
+		}
+	}
+	JobSystem::Wait(DecodesInFlight);
+}
+
+void AssetManager::StartDecode(std::shared_ptr<Record> Asset)
+{
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Asset->RequestTime = CpuProfiler::Now();
+		if (FirstRequestTime == 0)
+		{
+			FirstRequestTime = Asset->RequestTime;
+		}
+	}
+
+	//Packed files are mapped, the decode job reads them directly
+	if (Asset->SourcePath.empty() || (Archive != nullptr && Archive->Find(Asset->SourcePath.c_str()) != nullptr))
+	{
+		ScheduleDecode(std::move(Asset));
+		return;
+	}
+
+	ReadsInFlight.fetch_add(1, std::memory_order_relaxed);
+	AsyncIO::ReadFile(Asset->SourcePath.c_str(), Asset->SourcePriority, [this, Asset](AsyncIO::Result Outcome, AssetData&& Contents)
+	{
+		Asset->ReadTime = CpuProfiler::Now() - Asset->RequestTime;
+
+		if (Outcome == AsyncIO::Result::Done)
+		{
+			Asset->Source = std::move(Contents);
+			ScheduleDecode(Asset);
+		}
+		else
+		{
+			LOG_ERROR("Could not read %s", Asset->SourcePath.c_str());
+			Asset->State.store(Status::Failed, std::memory_order_release);
+			if (OnDecoded)
+			{
+				OnDecoded();
+			}
+		}
+
+		ReadsInFlight.fetch_sub(1, std::memory_order_release);
+	});
+	AsyncIO::Submit();
+}
+
+void AssetManager::ScheduleDecode(std::shared_ptr<Record> Asset)
+{
+	JobSystem::Run([this, Asset]()
+	{
+		PROFILE_SCOPE("DecodeAsset");
+
+		const uint64_t Begin = CpuProfiler::Now();
+		if (!Asset->SourcePath.empty() && !Asset->Source.IsValid())
+		{
+			Asset->Source = Archive->Read(Asset->SourcePath.c_str());
+		}
+
+		const bool bDecoded = (Asset->SourcePath.empty() || Asset->Source.IsValid()) && Asset->Decode();
+		Asset->Source.Reset();
+		Asset->DecodeTime = CpuProfiler::Now() - Begin;
+
+		if (!bDecoded)
+		{
+			LOG_ERROR("Could not load %s", Asset->Key.c_str());
+			Asset->State.store(Status::Failed, std::memory_order_release);
+		}
+		else
+		{
+			Asset->State.store(Status::Decoded, std::memory_order_release);
+
+			std::lock_guard<std::mutex> Lock(Mutex);
+			ToFinalize.push_back(Asset);
+			NumToFinalize.store(static_cast<int>(ToFinalize.size()), std::memory_order_release);
+		}
+
+		//Failures too, whoever waits on the asset has to notice
+		if (OnDecoded)
+		{
+			OnDecoded();
+		}
+	}, &DecodesInFlight);
+}
+
+int AssetManager::Update()
+{
+	if (NumToFinalize.load(std::memory_order_acquire) == 0)
+	{
+		return 0;
+	}
+
+	PROFILE_FUNCTION();
+
+	std::vector<std::shared_ptr<Record>> Batch;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Batch.swap(ToFinalize);
+		NumToFinalize.store(0, std::memory_order_relaxed);
+	}
+
+	//A dependency can be further in the batch, repeat until nothing changes
+	int NumFinalized = 0;
+	bool bProgress = true;
+	while (bProgress)
+	{
+		bProgress = false;
+
+		for (std::shared_ptr<Record>& Asset : Batch)
+		{
+			if (!Asset)
+			{
+				continue;
+			}
+
+			bool bDependenciesReady = true;
+			bool bDependencyFailed = false;
+			for (const std::shared_ptr<Record>& Dependency : Asset->Dependencies)
+			{
+				const Status DependencyState = Dependency->State.load(std::memory_order_acquire);
+				bDependenciesReady = bDependenciesReady && DependencyState == Status::Ready;
+				bDependencyFailed = bDependencyFailed || DependencyState == Status::Failed;
+			}
+
+			if (bDependencyFailed)
+			{
+				LOG_ERROR("Could not load %s, a dependency failed", Asset->Key.c_str());
+				Asset->State.store(Status::Failed, std::memory_order_release);
+			}
+			else if (bDependenciesReady)
+			{
+				const uint64_t Begin = CpuProfiler::Now();
+				const bool bFinalized = Asset->Finalize();
+				Asset->ReadyTime = CpuProfiler::Now();
+				Asset->FinalizeTime = Asset->ReadyTime - Begin;
+
+				if (!bFinalized)
+				{
+					LOG_ERROR("Could not finalize %s", Asset->Key.c_str());
+				}
+				Asset->State.store(bFinalized ? Status::Ready : Status::Failed, std::memory_order_release);
+				++NumFinalized;
+			}
+			else
+			{
+				continue;
+			}
+
+			Asset.reset();
+			bProgress = true;
+		}
+	}
+
+	//Whatever still waits for a dependency goes back in the queue
+	Batch.erase(std::remove(Batch.begin(), Batch.end(), nullptr), Batch.end());
+	if (!Batch.empty())
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		ToFinalize.insert(ToFinalize.begin(), Batch.begin(), Batch.end());
+		NumToFinalize.store(static_cast<int>(ToFinalize.size()), std::memory_order_release);
+	}
+
+	return NumFinalized;
+}
+
+bool AssetManager::IsPending(const Record& Asset) const
+{
+	const Status State = Asset.State.load(std::memory_order_acquire);
+	return State == Status::Loading || State == Status::Decoded;
+}
+
+void AssetManager::WaitFor(const Record* Asset)
+{
+	PROFILE_FUNCTION();
+
+	auto IsWaiting = [this, Asset]()
+	{
+		if (Asset != nullptr)
+		{
+			return IsPending(*Asset);
+		}
+
+		std::lock_guard<std::mutex> Lock(Mutex);
+		return std::any_of(Assets.begin(), Assets.end(),
+			[this](const auto& Entry) { return IsPending(*Entry.second); });
+	};
+
+	while (IsWaiting())
+	{
+		//Finalize what is decoded, else take a decode job instead of sleeping
+		if (Update() == 0 && !JobSystem::RunOneJob())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void AssetManager::WaitAll()
+{
+	WaitFor(nullptr);
+}
+
+void AssetManager::ReleaseAll()
+{
+	WaitForJobs();
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+	for (auto& Entry : Assets)
+	{
+		Entry.second->Release();
+	}
+	Assets.clear();
+	ToFinalize.clear();
+	NumToFinalize.store(0, std::memory_order_relaxed);
+	FirstRequestTime = 0;
+}
+
+void AssetManager::PrintReport() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	std::vector<const Record*> Sorted;
+	Sorted.reserve(Assets.size());
+	for (const auto& Entry : Assets)
+	{
+		Sorted.push_back(Entry.second.get());
+	}
+	std::sort(Sorted.begin(), Sorted.end(),
+		[](const Record* A, const Record* B) { return A->ReadyTime < B->ReadyTime; });
+
+	uint64_t LastReady = FirstRequestTime;
+	uint64_t TotalWork = 0;
+	for (const Record* Asset : Sorted)
+	{
+		LastReady = std::max(LastReady, Asset->ReadyTime);
+		TotalWork += Asset->ReadTime + Asset->DecodeTime + Asset->FinalizeTime;
+	}
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "Assets: " << Sorted.size() << " requested, done in " << (LastReady - FirstRequestTime) * 1e-6 << " ms"
+		<< " for " << TotalWork * 1e-6 << " ms of read, decode and finalize work" << std::endl;
+
+	for (const Record* Asset : Sorted)
+	{
+		const Status State = Asset->State.load(std::memory_order_acquire);
+		std::cout << "    " << std::left << std::setw(56) << Asset->Key << std::right
+			<< " read " << std::setw(8) << Asset->ReadTime * 1e-6 << " ms"
+			<< " decode " << std::setw(8) << Asset->DecodeTime * 1e-6 << " ms"
+			<< " finalize " << std::setw(8) << Asset->FinalizeTime * 1e-6 << " ms";
+
+		if (State == Status::Ready)
+		{
+			std::cout << " ready at " << std::setw(8) << (Asset->ReadyTime - FirstRequestTime) * 1e-6 << " ms";
+		}
+		else
+		{
+			std::cout << (State == Status::Failed ? " failed" : " loading");
+		}
+		std::cout << std::endl;
+	}
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "AsyncIO.h"
+#include "JobSystem.h"
+
+// Asynchronous asset loading.
+// Request() returns a handle at once, like a future. Loading has two stages:
+// Decode runs as a job on the worker pool (file reads, image decoding, mesh
+// generation) and Finalize runs in Update() on the thread that owns the GL
+// context (uploads, shader compilation). An asset is finalized only once
+// every asset it depends on is ready, a material waits for its program and
+// textures, so independent loads overlap and a batch of requests takes as
+// long as its longest chain instead of the sum of every load.
+//
+// Requests are keyed: asking again for a key being loaded or loaded returns
+// the same asset, the work is done once.
+//
+// RequestFile() adds a read stage before the decode: the file is a view of
+// the archive when packed, otherwise it is read through AsyncIO and the
+// decode job starts when the read completes, no worker blocks on the disk.
+class AssetManager
+{
+public:
+
+	enum class Status : uint8_t
+	{
+		Loading,
+		Decoded,
+		Ready,
+		Failed
+	};
+
+	struct Record
+	{
+		virtual ~Record() = default;
+
+		// Worker thread, false if the asset could not be loaded. Source holds the
+		// file of RequestFile() and is released afterwards
+		virtual bool Decode() = 0;
+
+		// GL thread, once every dependency is ready
+		virtual bool Finalize() = 0;
+
+		// GL thread, free what Decode and Finalize left, whatever stage was reached
+		virtual void Release() = 0;
+
+		std::string Key;
+		std::string SourcePath;
+		AsyncIO::Priority SourcePriority = AsyncIO::Priority::Visible;
+		AssetData Source;
+		std::atomic<Status> State{ Status::Loading };
+		std::vector<std::shared_ptr<Record>> Dependencies;
+
+		// Nanoseconds of CpuProfiler::Now(), for the report
+		uint64_t RequestTime = 0;
+		uint64_t ReadTime = 0;
+		uint64_t DecodeTime = 0;
+		uint64_t FinalizeTime = 0;
+		uint64_t ReadyTime = 0;
+	};
+
+	template <typename Type>
+	struct TypedRecord : Record
+	{
+		bool Decode() override { return !DecodeFunction || DecodeFunction(Value, Source); }
+		bool Finalize() override { return !FinalizeFunction || FinalizeFunction(Value); }
+		void Release() override { if (ReleaseFunction) { ReleaseFunction(Value); } }
+
+		Type Value;
+		std::function<bool(Type&, AssetData&)> DecodeFunction;
+		std::function<bool(Type&)> FinalizeFunction;
+		std::function<void(Type&)> ReleaseFunction;
+	};
+
+	template <typename Type>
+	class Handle
+	{
+	public:
+
+		Handle() = default;
+
+		explicit Handle(std::shared_ptr<TypedRecord<Type>> InAsset)
+			: Asset(std::move(InAsset))
+		{
+		}
+
+		Status GetStatus() const { return Asset ? Asset->State.load(std::memory_order_acquire) : Status::Failed; }
+		bool IsReady() const { return GetStatus() == Status::Ready; }
+
+		// Only once ready
+		const Type& Get() const
+		{
+			assert(IsReady());
+			return Asset->Value;
+		}
+
+		const std::shared_ptr<TypedRecord<Type>>& GetRecord() const { return Asset; }
+
+	private:
+
+		std::shared_ptr<TypedRecord<Type>> Asset;
+	};
+
+	AssetManager() = default;
+	~AssetManager();
+
+	AssetManager(const AssetManager&) = delete;
+	AssetManager& operator=(const AssetManager&) = delete;
+
+	// Called from a worker whenever an asset finished decoding, to wake the GL thread
+	void SetDecodedCallback(std::function<void()> Callback) { OnDecoded = std::move(Callback); }
+
+	// Files of RequestFile() found in the archive are not read from the disk
+	void SetArchive(const AssetArchive* InArchive) { Archive = InArchive; }
+
+	// Start loading an asset, or return the one already requested with this key.
+	// Any of the functions can be empty. Decode failing or a dependency failing
+	// fails the asset, Release still runs for it in ReleaseAll()
+	template <typename Type>
+	Handle<Type> Request(const std::string& Key, std::vector<std::shared_ptr<Record>> Dependencies,
+		std::function<bool(Type&)> Decode, std::function<bool(Type&)> Finalize, std::function<void(Type&)> Release)
+	{
+		std::function<bool(Type&, AssetData&)> DecodeWithoutSource;
+		if (Decode)
+		{
+			DecodeWithoutSource = [Decode = std::move(Decode)](Type& Value, AssetData&) { return Decode(Value); };
+		}
+
+		return Insert<Type>(Key, std::string(), AsyncIO::Priority::Visible, std::move(Dependencies),
+			std::move(DecodeWithoutSource), std::move(Finalize), std::move(Release));
+	}
+
+	// Same with the contents of FilePath given to Decode, keyed by the path
+	template <typename Type>
+	Handle<Type> RequestFile(const std::string& FilePath, AsyncIO::Priority Class, std::vector<std::shared_ptr<Record>> Dependencies,
+		std::function<bool(Type&, AssetData&)> Decode, std::function<bool(Type&)> Finalize, std::function<void(Type&)> Release)
+	{
+		return Insert<Type>(FilePath, FilePath, Class, std::move(Dependencies), std::move(Decode), std::move(Finalize), std::move(Release));
+	}
+
+	// GL thread: finalize the decoded assets whose dependencies are ready.
+	// Returns how many were finalized
+	int Update();
+
+	// GL thread: finalize and help the workers until the asset is ready or failed
+	template <typename Type>
+	bool Wait(const Handle<Type>& Asset)
+	{
+		WaitFor(Asset.GetRecord().get());
+		return Asset.IsReady();
+	}
+
+	// GL thread: wait for every asset requested so far
+	void WaitAll();
+
+	// GL thread: delete every asset, the handles must not be used afterwards
+	void ReleaseAll();
+
+	// Print when each asset was decoded and ready, and the total against the sum of the work
+	void PrintReport() const;
+
+private:
+
+	template <typename Type>
+	Handle<Type> Insert(const std::string& Key, const std::string& SourcePath, AsyncIO::Priority Class,
+		std::vector<std::shared_ptr<Record>> Dependencies, std::function<bool(Type&, AssetData&)> Decode,
+		std::function<bool(Type&)> Finalize, std::function<void(Type&)> Release)
+	{
+		std::shared_ptr<TypedRecord<Type>> Asset;
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+
+			auto Found = Assets.find(Key);
+			if (Found != Assets.end())
+			{
+				Asset = std::dynamic_pointer_cast<TypedRecord<Type>>(Found->second);
+				assert(Asset && "Asset requested again with another type");
+				return Handle<Type>(Asset);
+			}
+
+			Asset = std::make_shared<TypedRecord<Type>>();
+			Asset->Key = Key;
+			Asset->SourcePath = SourcePath;
+			Asset->SourcePriority = Class;
+			Asset->Dependencies = std::move(Dependencies);
+			Asset->DecodeFunction = std::move(Decode);
+			Asset->FinalizeFunction = std::move(Finalize);
+			Asset->ReleaseFunction = std::move(Release);
+			Assets.emplace(Key, Asset);
+		}
+
+		StartDecode(Asset);
+		return Handle<Type>(Asset);
+	}
+
+	void StartDecode(std::shared_ptr<Record> Asset);
+	void ScheduleDecode(std::shared_ptr<Record> Asset);
+	void WaitForJobs();
+	bool IsPending(const Record& Asset) const;
+	void WaitFor(const Record* Asset);
+
+	mutable std::mutex Mutex;
+	std::unordered_map<std::string, std::shared_ptr<Record>> Assets;
+
+	// Decoded assets, in decode order, waiting for Update()
+	std::vector<std::shared_ptr<Record>> ToFinalize;
+	std::atomic<int> NumToFinalize{ 0 };
+
+	JobSystem::Counter DecodesInFlight;
+	std::atomic<int> ReadsInFlight{ 0 };
+	std::function<void()> OnDecoded;
+	const AssetArchive* Archive = nullptr;
+
+	uint64_t FirstRequestTime = 0;
+};
@@ -0,0 +1,221 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "AssetArchive.h"
+
+// Offline packer of the asset archive.
+// Usage: AssetPacker OUTPUT [--compress | --store] FILE...
+// Files are stored under the path given on the command line, so it is run
+// from the directory the game loads its assets from. --compress applies to
+// the files after it, until --store: compression is kept only when it saves
+// space, already compressed formats like JPEG are stored as they are.
+
+using namespace AssetArchiveFormat;
+
+namespace
+{
+	struct PackedFile
+	{
+		std::string Name;
+		std::vector<unsigned char> Contents;
+		std::vector<unsigned char> Stored;
+		bool bCompressed = false;
+		Entry Record{};
+	};
+
+	bool ReadWholeFile(const std::string& FilePath, std::vector<unsigned char>& Contents)
+	{
+		std::ifstream FileStream{ FilePath, std::ios::in | std::ios::binary };
+		if (!FileStream)
+		{
+			return false;
+		}
+
+		Contents.assign(std::istreambuf_iterator<char>(FileStream), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	uint64_t AlignUp(uint64_t Value, uint64_t Alignment)
+	{
+		return (Value + Alignment - 1) / Alignment * Alignment;
+	}
+
+	//The stream is inflated back, a packer bug must not ship a broken archive
+	bool Compress(PackedFile& File)
+	{
+		int CompressedSize = 0;
+		unsigned char* Compressed = stbi_zlib_compress(File.Contents.data(), static_cast<int>(File.Contents.size()), &CompressedSize, 9);
+		if (Compressed == nullptr)
+		{
+			return false;
+		}
+
+		int InflatedSize = 0;
+		char* Inflated = stbi_zlib_decode_malloc(reinterpret_cast<const char*>(Compressed), CompressedSize, &InflatedSize);
+		const bool bRoundTrip = Inflated != nullptr && static_cast<size_t>(InflatedSize) == File.Contents.size()
+			&& std::memcmp(Inflated, File.Contents.data(), File.Contents.size()) == 0;
+		stbi_image_free(Inflated);
+
+		//Worth it only if it saves more than a few percent
+		if (bRoundTrip && static_cast<size_t>(CompressedSize) < File.Contents.size() - File.Contents.size() / 16)
+		{
+			File.Stored.assign(Compressed, Compressed + CompressedSize);
+			File.bCompressed = true;
+		}
+		STBIW_FREE(Compressed);
+
+		return bRoundTrip;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cout << "Usage: AssetPacker OUTPUT [--compress | --store] FILE..." << std::endl;
+		return 1;
+	}
+
+	const char* OutputFile = argv[1];
+
+	std::vector<PackedFile> Files;
+	bool bCompress = false;
+	for (int Index = 2; Index < argc; ++Index)
+	{
+		if (std::strcmp(argv[Index], "--compress") == 0)
+		{
+			bCompress = true;
+			continue;
+		}
+		if (std::strcmp(argv[Index], "--store") == 0)
+		{
+			bCompress = false;
+			continue;
+		}
+
+		PackedFile File;
+		File.Name = argv[Index];
+		if (!ReadWholeFile(File.Name, File.Contents))
+		{
+			std::cout << "Could not read " << File.Name << std::endl;
+			return 1;
+		}
+
+		if (bCompress && !File.Contents.empty() && !Compress(File))
+		{
+			std::cout << "Could not compress " << File.Name << std::endl;
+			return 1;
+		}
+
+		for (const PackedFile& Other : Files)
+		{
+			if (Other.Name == File.Name)
+			{
+				std::cout << File.Name << " is given twice" << std::endl;
+				return 1;
+			}
+		}
+
+		Files.push_back(std::move(File));
+	}
+
+	//At most half full so probes stay short
+	uint32_t NumSlots = 16;
+	while (NumSlots < Files.size() * 2)
+	{
+		NumSlots *= 2;
+	}
+
+	Header Head{};
+	Head.Magic = Magic;
+	Head.Version = Version;
+	Head.NumEntries = static_cast<uint32_t>(Files.size());
+	Head.NumSlots = NumSlots;
+	Head.NamesOffset = sizeof(Header) + uint64_t{ NumSlots } * sizeof(Entry);
+
+	std::string Names;
+	for (PackedFile& File : Files)
+	{
+		File.Record.NameHash = HashName(File.Name.c_str(), File.Name.size());
+		File.Record.NameOffset = static_cast<uint32_t>(Names.size());
+		File.Record.NameLength = static_cast<uint32_t>(File.Name.size());
+		Names += File.Name;
+	}
+	Head.NamesSize = Names.size();
+
+	//Every entry starts on its own page
+	uint64_t Offset = AlignUp(Head.NamesOffset + Head.NamesSize, PageSize);
+	for (PackedFile& File : Files)
+	{
+		const std::vector<unsigned char>& Data = File.bCompressed ? File.Stored : File.Contents;
+		File.Record.Offset = Offset;
+		File.Record.StoredSize = Data.size();
+		File.Record.Size = File.Contents.size();
+		File.Record.Flags = File.bCompressed ? static_cast<uint32_t>(Compressed) : 0u;
+		Offset = AlignUp(Offset + Data.size(), PageSize);
+	}
+
+	std::vector<Entry> Slots(NumSlots);
+	for (const PackedFile& File : Files)
+	{
+		uint32_t Slot = static_cast<uint32_t>(File.Record.NameHash) & (NumSlots - 1);
+		while (Slots[Slot].NameLength != 0)
+		{
+			Slot = (Slot + 1) & (NumSlots - 1);
+		}
+		Slots[Slot] = File.Record;
+	}
+
+	std::ofstream Output{ OutputFile, std::ios::out | std::ios::binary | std::ios::trunc };
+	if (!Output)
+	{
+		std::cout << "Could not write " << OutputFile << std::endl;
+		return 1;
+	}
+
+	Output.write(reinterpret_cast<const char*>(&Head), sizeof(Head));
+	Output.write(reinterpret_cast<const char*>(Slots.data()), Slots.size() * sizeof(Entry));
+	Output.write(Names.data(), Names.size());
+
+	uint64_t TotalSize = 0;
+	uint64_t TotalStored = 0;
+	for (const PackedFile& File : Files)
+	{
+		const std::vector<unsigned char>& Data = File.bCompressed ? File.Stored : File.Contents;
+
+		//Zero padding up to the page of the entry
+		const uint64_t Position = static_cast<uint64_t>(Output.tellp());
+		const std::string Padding(static_cast<size_t>(File.Record.Offset - Position), '\0');
+		Output.write(Padding.data(), Padding.size());
+		Output.write(reinterpret_cast<const char*>(Data.data()), Data.size());
+
+		std::cout << "    " << std::left << std::setw(40) << File.Name << std::right
+			<< std::setw(10) << File.Record.Size << " bytes"
+			<< (File.bCompressed ? " compressed to " : " stored ") << std::setw(10) << File.Record.StoredSize << std::endl;
+
+		TotalSize += File.Record.Size;
+		TotalStored += File.Record.StoredSize;
+	}
+
+	if (!Output)
+	{
+		std::cout << "Could not write " << OutputFile << std::endl;
+		return 1;
+	}
+
+	std::cout << OutputFile << ": " << Files.size() << " entries, " << TotalSize << " bytes stored in "
+		<< TotalStored << " bytes, " << static_cast<uint64_t>(Output.tellp()) << " with the table and padding" << std::endl;
+	return 0;
+}
@@ -0,0 +1,914 @@
+#include "AsyncIO.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "CpuProfiler.h"
+#include "Log.h"
+
+using namespace AsyncIO;
+
+namespace
+{
+	struct Request
+	{
+		RequestId Id = 0;
+		FileHandle File = InvalidFile;
+		uint64_t Offset = 0;
+		unsigned char* Destination = nullptr;
+		size_t Size = 0;
+		size_t BytesRead = 0;
+		Priority Class = Priority::Visible;
+
+		// Registered buffer holding the destination, -1 if none
+		int BufferIndex = -1;
+
+		bool bInFlight = false;
+		bool bCancelled = false;
+		bool bCompleting = false;
+		Completion OnComplete;
+	};
+
+	enum class Backend
+	{
+		Inline,
+		Ring,
+		Pool
+	};
+
+	Backend ActiveBackend = Backend::Inline;
+	Settings Options;
+
+	std::mutex Mutex;
+
+	// Queued and in flight requests by id, the owner of every request
+	std::unordered_map<RequestId, std::unique_ptr<Request>> Requests;
+	RequestId NextId = 1;
+
+	// Read since the last Submit()
+	std::vector<Request*> Unsubmitted;
+
+	// Submitted and waiting for a slot, per priority class
+	std::deque<Request*> Queues[static_cast<int>(Priority::NumPriorities)];
+	uint32_t InFlight[static_cast<int>(Priority::NumPriorities)] = {};
+
+	// Cancelled before being issued, completed by the I/O thread
+	std::vector<Request*> CancelledQueued;
+
+	bool bQuit = false;
+
+	// Pool threads sleep here
+	std::condition_variable WorkAvailable;
+	std::vector<std::thread> Threads;
+
+	uint32_t GetTotalInFlight()
+	{
+		uint32_t Total = 0;
+		for (uint32_t Count : InFlight)
+		{
+			Total += Count;
+		}
+		return Total;
+	}
+
+	// Next request to issue, nullptr if none may go now. Mutex held
+	Request* TakeNext()
+	{
+		std::deque<Request*>& Visible = Queues[static_cast<int>(Priority::Visible)];
+		std::deque<Request*>& Prefetch = Queues[static_cast<int>(Priority::Prefetch)];
+
+		std::deque<Request*>* Source = nullptr;
+		if (!Visible.empty())
+		{
+			Source = &Visible;
+		}
+		else if (!Prefetch.empty() && InFlight[static_cast<int>(Priority::Prefetch)] < Options.MaxPrefetchInFlight)
+		{
+			Source = &Prefetch;
+		}
+
+		if (Source == nullptr)
+		{
+			return nullptr;
+		}
+
+		Request* Next = Source->front();
+		Source->pop_front();
+		Next->bInFlight = true;
+		++InFlight[static_cast<int>(Next->Class)];
+		return Next;
+	}
+
+	// The completion runs without the lock, the request stays pending until it returned
+	void Complete(Request* Finished, Result Outcome)
+	{
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			Finished->bCompleting = true;
+		}
+
+		if (Finished->OnComplete)
+		{
+			Finished->OnComplete(Outcome, Finished->BytesRead);
+		}
+
+		std::unique_ptr<Request> Owned;
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			auto Found = Requests.find(Finished->Id);
+			Owned = std::move(Found->second);
+			Requests.erase(Found);
+		}
+	}
+
+	void CompleteCancelled(std::vector<Request*>& Cancelled)
+	{
+		for (Request* Dropped : Cancelled)
+		{
+			Complete(Dropped, Result::Cancelled);
+		}
+		Cancelled.clear();
+	}
+
+	// Blocking positional read of what is left of the request
+	bool ReadAt(Request& Current)
+	{
+		while (Current.BytesRead < Current.Size)
+		{
+			unsigned char* Destination = Current.Destination + Current.BytesRead;
+			const uint64_t Offset = Current.Offset + Current.BytesRead;
+			const size_t Remaining = std::min<size_t>(Current.Size - Current.BytesRead, 1u << 30);
+
+#if defined(_WIN32)
+			OVERLAPPED Position = {};
+			Position.Offset = static_cast<DWORD>(Offset);
+			Position.OffsetHigh = static_cast<DWORD>(Offset >> 32);
+			DWORD Read = 0;
+			if (!::ReadFile(reinterpret_cast<HANDLE>(Current.File), Destination, static_cast<DWORD>(Remaining), &Read, &Position))
+			{
+				return GetLastError() == ERROR_HANDLE_EOF;
+			}
+#else
+			const ssize_t Read = pread(static_cast<int>(Current.File), Destination, Remaining, static_cast<off_t>(Offset));
+			if (Read < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+#endif
+			if (Read == 0)
+			{
+				break;
+			}
+			Current.BytesRead += static_cast<size_t>(Read);
+		}
+		return true;
+	}
+
+	void PoolThreadMain()
+	{
+		PROFILE_THREAD_NAME("IO");
+
+		std::vector<Request*> Cancelled;
+		while (true)
+		{
+			Request* Next = nullptr;
+			{
+				std::unique_lock<std::mutex> Lock(Mutex);
+				WorkAvailable.wait(Lock, [&Next]()
+				{
+					return bQuit || !CancelledQueued.empty() || (Next = TakeNext()) != nullptr;
+				});
+
+				Cancelled.swap(CancelledQueued);
+				if (Next == nullptr && Cancelled.empty())
+				{
+					//Quitting, the queues were emptied by Shutdown()
+					return;
+				}
+			}
+
+			CompleteCancelled(Cancelled);
+			if (Next == nullptr)
+			{
+				continue;
+			}
+
+			bool bRead = false;
+			{
+				PROFILE_SCOPE("pread");
+				bRead = ReadAt(*Next);
+			}
+
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+				--InFlight[static_cast<int>(Next->Class)];
+			}
+
+			//A prefetch slot may have freed up
+			WorkAvailable.notify_one();
+			Complete(Next, bRead ? Result::Done : Result::Failed);
+		}
+	}
+
+#if defined(__linux__)
+	// Completions that are not reads
+	constexpr uint64_t WakeTag = 0;
+	constexpr uint64_t CancelTag = ~uint64_t{ 0 };
+
+	// Submission and completion rings shared with the kernel
+	struct Ring
+	{
+		int Fd = -1;
+		int WakeFd = -1;
+
+		void* SqMemory = nullptr;
+		size_t SqMemorySize = 0;
+		void* CqMemory = nullptr;
+		size_t CqMemorySize = 0;
+		io_uring_sqe* Sqes = nullptr;
+		size_t SqesSize = 0;
+
+		unsigned* SqHead = nullptr;
+		unsigned* SqTail = nullptr;
+		unsigned SqMask = 0;
+		unsigned SqEntries = 0;
+		unsigned* SqArray = nullptr;
+
+		unsigned* CqHead = nullptr;
+		unsigned* CqTail = nullptr;
+		unsigned CqMask = 0;
+		io_uring_cqe* Cqes = nullptr;
+
+		// Tail as written by this thread, published before entering the kernel
+		unsigned LocalTail = 0;
+		bool bBuffersRegistered = false;
+	};
+
+	Ring Uring;
+
+	// Reads in flight whose cancellation was asked, issued by the I/O thread
+	std::vector<RequestId> ToCancel;
+
+	int SetupRing(unsigned Entries, io_uring_params& Params)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_setup, Entries, &Params));
+	}
+
+	int EnterRing(unsigned ToSubmit, unsigned MinComplete, unsigned Flags)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_enter, Uring.Fd, ToSubmit, MinComplete, Flags, nullptr, 0));
+	}
+
+	int RegisterRing(unsigned Opcode, const void* Arguments, unsigned NumArguments)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_register, Uring.Fd, Opcode, Arguments, NumArguments));
+	}
+
+	void DestroyRing()
+	{
+		if (Uring.Sqes != nullptr)
+		{
+			munmap(Uring.Sqes, Uring.SqesSize);
+		}
+		if (Uring.CqMemory != nullptr && Uring.CqMemory != Uring.SqMemory)
+		{
+			munmap(Uring.CqMemory, Uring.CqMemorySize);
+		}
+		if (Uring.SqMemory != nullptr)
+		{
+			munmap(Uring.SqMemory, Uring.SqMemorySize);
+		}
+		if (Uring.WakeFd >= 0)
+		{
+			close(Uring.WakeFd);
+		}
+		if (Uring.Fd >= 0)
+		{
+			close(Uring.Fd);
+		}
+		Uring = Ring{};
+	}
+
+	bool CreateRing()
+	{
+		io_uring_params Params;
+		std::memset(&Params, 0, sizeof(Params));
+
+		//Room for the reads plus the wake poll and cancellations
+		Uring.Fd = SetupRing(Options.QueueDepth + 8, Params);
+		if (Uring.Fd < 0)
+		{
+			LOG_INFO("Async I/O: io_uring unavailable (%s)", std::strerror(errno));
+			Uring.Fd = -1;
+			return false;
+		}
+
+		//Plain reads need 5.6, older kernels take the pool
+		const size_t ProbeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+		std::unique_ptr<unsigned char[]> ProbeMemory(new unsigned char[ProbeSize]());
+		io_uring_probe* Probe = reinterpret_cast<io_uring_probe*>(ProbeMemory.get());
+		if (RegisterRing(IORING_REGISTER_PROBE, Probe, 256) < 0 || Probe->last_op < IORING_OP_READ
+			|| (Probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) == 0)
+		{
+			LOG_INFO("Async I/O: io_uring without IORING_OP_READ");
+			DestroyRing();
+			return false;
+		}
+
+		Uring.SqMemorySize = Params.sq_off.array + Params.sq_entries * sizeof(unsigned);
+		Uring.CqMemorySize = Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+		const bool bSingleMap = (Params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (bSingleMap)
+		{
+			Uring.SqMemorySize = Uring.CqMemorySize = std::max(Uring.SqMemorySize, Uring.CqMemorySize);
+		}
+
+		void* SqMemory = mmap(nullptr, Uring.SqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Uring.Fd, IORING_OFF_SQ_RING);
+		Uring.SqMemory = SqMemory == MAP_FAILED ? nullptr : SqMemory;
+
+		void* CqMemory = Uring.SqMemory;
+		if (!bSingleMap)
+		{
+			CqMemory = mmap(nullptr, Uring.CqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Uring.Fd, IORING_OFF_CQ_RING);
+		}
+		Uring.CqMemory = CqMemory == MAP_FAILED ? nullptr : CqMemory;
+
+		Uring.SqesSize = Params.sq_entries * sizeof(io_uring_sqe);
+		void* Sqes = mmap(nullptr, Uring.SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Uring.Fd, IORING_OFF_SQES);
+		Uring.Sqes = Sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe*>(Sqes);
+
+		Uring.WakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+		if (Uring.SqMemory == nullptr || Uring.CqMemory == nullptr || Uring.Sqes == nullptr || Uring.WakeFd < 0)
+		{
+			LOG_WARNING("Async I/O: could not map the io_uring rings");
+			DestroyRing();
+			return false;
+		}
+
+		unsigned char* Sq = static_cast<unsigned char*>(Uring.SqMemory);
+		Uring.SqHead = reinterpret_cast<unsigned*>(Sq + Params.sq_off.head);
+		Uring.SqTail = reinterpret_cast<unsigned*>(Sq + Params.sq_off.tail);
+		Uring.SqMask = *reinterpret_cast<unsigned*>(Sq + Params.sq_off.ring_mask);
+		Uring.SqEntries = Params.sq_entries;
+		Uring.SqArray = reinterpret_cast<unsigned*>(Sq + Params.sq_off.array);
+		Uring.LocalTail = *Uring.SqTail;
+
+		unsigned char* Cq = static_cast<unsigned char*>(Uring.CqMemory);
+		Uring.CqHead = reinterpret_cast<unsigned*>(Cq + Params.cq_off.head);
+		Uring.CqTail = reinterpret_cast<unsigned*>(Cq + Params.cq_off.tail);
+		Uring.CqMask = *reinterpret_cast<unsigned*>(Cq + Params.cq_off.ring_mask);
+		Uring.Cqes = reinterpret_cast<io_uring_cqe*>(Cq + Params.cq_off.cqes);
+
+		//Pinned once instead of on every read, refused past RLIMIT_MEMLOCK
+		if (Options.NumBuffers > 0)
+		{
+			std::vector<iovec> Buffers(Options.NumBuffers);
+			for (uint32_t Index = 0; Index < Options.NumBuffers; ++Index)
+			{
+				Buffers[Index].iov_base = Options.Buffers[Index].Memory;
+				Buffers[Index].iov_len = Options.Buffers[Index].Size;
+			}
+
+			Uring.bBuffersRegistered = RegisterRing(IORING_REGISTER_BUFFERS, Buffers.data(), Options.NumBuffers) == 0;
+			if (!Uring.bBuffersRegistered)
+			{
+				LOG_WARNING("Async I/O: could not register %u buffers (%s)", Options.NumBuffers, std::strerror(errno));
+			}
+		}
+
+		return true;
+	}
+
+	// Null when the submission ring is full
+	io_uring_sqe* GetSqe()
+	{
+		const unsigned Head = __atomic_load_n(Uring.SqHead, __ATOMIC_ACQUIRE);
+		if (Uring.LocalTail - Head >= Uring.SqEntries)
+		{
+			return nullptr;
+		}
+
+		const unsigned Index = Uring.LocalTail & Uring.SqMask;
+		io_uring_sqe* Sqe = &Uring.Sqes[Index];
+		std::memset(Sqe, 0, sizeof(io_uring_sqe));
+		Uring.SqArray[Index] = Index;
+		++Uring.LocalTail;
+		return Sqe;
+	}
+
+	void PrepareRead(io_uring_sqe& Sqe, const Request& Current)
+	{
+		const bool bFixed = Current.BufferIndex >= 0 && Uring.bBuffersRegistered;
+		Sqe.opcode = bFixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+		Sqe.fd = static_cast<int>(Current.File);
+		Sqe.off = Current.Offset + Current.BytesRead;
+		Sqe.addr = reinterpret_cast<uint64_t>(Current.Destination + Current.BytesRead);
+		Sqe.len = static_cast<uint32_t>(std::min<size_t>(Current.Size - Current.BytesRead, 1u << 30));
+		Sqe.buf_index = bFixed ? static_cast<uint16_t>(Current.BufferIndex) : 0;
+
+		//Best effort class in the block layer too, prefetches at the lowest level
+		constexpr uint16_t BestEffortClass = 2 << 13;
+		Sqe.ioprio = BestEffortClass | (Current.Class == Priority::Visible ? 0 : 7);
+		Sqe.user_data = Current.Id;
+	}
+
+	bool ArmWake()
+	{
+		io_uring_sqe* Sqe = GetSqe();
+		if (Sqe == nullptr)
+		{
+			return false;
+		}
+
+		Sqe->opcode = IORING_OP_POLL_ADD;
+		Sqe->fd = Uring.WakeFd;
+		Sqe->poll32_events = POLLIN;
+		Sqe->user_data = WakeTag;
+		return true;
+	}
+
+	void WakeRing()
+	{
+		const uint64_t One = 1;
+		const ssize_t Written = write(Uring.WakeFd, &One, sizeof(One));
+		(void)Written;
+	}
+
+	// A read completion, requests to finish are appended to Finished. Mutex held
+	void OnReadCompleted(RequestId Id, int Value, std::vector<std::pair<Request*, Result>>& Finished)
+	{
+		auto Found = Requests.find(Id);
+		if (Found == Requests.end())
+		{
+			return;
+		}
+
+		Request* Current = Found->second.get();
+		--InFlight[static_cast<int>(Current->Class)];
+		Current->bInFlight = false;
+
+		//Finished unless queued again below, Cancel() must leave it alone from now
+		Current->bCompleting = true;
+
+		if ((Value == -EAGAIN || Value == -EINTR) && !Current->bCancelled)
+		{
+			Current->bCompleting = false;
+			Queues[static_cast<int>(Current->Class)].push_front(Current);
+			return;
+		}
+
+		if (Value < 0)
+		{
+			Finished.emplace_back(Current, Value == -ECANCELED || Current->bCancelled ? Result::Cancelled : Result::Failed);
+			return;
+		}
+
+		//Short read: continue where it stopped, unless at the end of the file
+		Current->BytesRead += static_cast<size_t>(Value);
+		if (Value > 0 && Current->BytesRead < Current->Size)
+		{
+			if (Current->bCancelled)
+			{
+				Finished.emplace_back(Current, Result::Cancelled);
+			}
+			else
+			{
+				Current->bCompleting = false;
+				Queues[static_cast<int>(Current->Class)].push_front(Current);
+			}
+			return;
+		}
+
+		Finished.emplace_back(Current, Result::Done);
+	}
+
+	void RingThreadMain()
+	{
+		PROFILE_THREAD_NAME("IO");
+
+		bool bWakeArmed = ArmWake();
+		std::vector<Request*> Cancelled;
+		std::vector<std::pair<Request*, Result>> Finished;
+
+		while (true)
+		{
+			bool bQuitting = false;
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+
+				size_t NumCancels = 0;
+				for (; NumCancels < ToCancel.size(); ++NumCancels)
+				{
+					io_uring_sqe* Sqe = GetSqe();
+					if (Sqe == nullptr)
+					{
+						break;
+					}
+					Sqe->opcode = IORING_OP_ASYNC_CANCEL;
+					Sqe->addr = ToCancel[NumCancels];
+					Sqe->user_data = CancelTag;
+				}
+				ToCancel.erase(ToCancel.begin(), ToCancel.begin() + NumCancels);
+
+				//Keep a few entries for the wake poll and cancellations
+				while (GetTotalInFlight() < Options.QueueDepth && Uring.LocalTail - __atomic_load_n(Uring.SqHead, __ATOMIC_ACQUIRE) + 4 < Uring.SqEntries)
+				{
+					Request* Next = TakeNext();
+					if (Next == nullptr)
+					{
+						break;
+					}
+					PrepareRead(*GetSqe(), *Next);
+				}
+
+				Cancelled.swap(CancelledQueued);
+				bQuitting = bQuit && GetTotalInFlight() == 0;
+			}
+
+			CompleteCancelled(Cancelled);
+			if (bQuitting)
+			{
+				break;
+			}
+
+			if (!bWakeArmed)
+			{
+				bWakeArmed = ArmWake();
+			}
+
+			//Publish the new entries, submit them and sleep until anything completes
+			__atomic_store_n(Uring.SqTail, Uring.LocalTail, __ATOMIC_RELEASE);
+			const unsigned ToSubmit = Uring.LocalTail - __atomic_load_n(Uring.SqHead, __ATOMIC_ACQUIRE);
+			if (EnterRing(ToSubmit, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EBUSY)
+			{
+				LOG_ERROR("Async I/O: io_uring_enter failed (%s)", std::strerror(errno));
+			}
+
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+
+				unsigned Head = *Uring.CqHead;
+				const unsigned Tail = __atomic_load_n(Uring.CqTail, __ATOMIC_ACQUIRE);
+				for (; Head != Tail; ++Head)
+				{
+					const io_uring_cqe& Cqe = Uring.Cqes[Head & Uring.CqMask];
+					if (Cqe.user_data == WakeTag)
+					{
+						uint64_t Count = 0;
+						const ssize_t Read = read(Uring.WakeFd, &Count, sizeof(Count));
+						(void)Read;
+						bWakeArmed = false;
+					}
+					else if (Cqe.user_data != CancelTag)
+					{
+						OnReadCompleted(Cqe.user_data, Cqe.res, Finished);
+					}
+				}
+				__atomic_store_n(Uring.CqHead, Head, __ATOMIC_RELEASE);
+			}
+
+			{
+				PROFILE_SCOPE("IOCompletions");
+				for (const std::pair<Request*, Result>& Done : Finished)
+				{
+					Complete(Done.first, Done.second);
+				}
+				Finished.clear();
+			}
+		}
+	}
+#endif
+
+	// Wake whoever issues the requests
+	void Notify()
+	{
+#if defined(__linux__)
+		if (ActiveBackend == Backend::Ring)
+		{
+			WakeRing();
+			return;
+		}
+#endif
+		WorkAvailable.notify_all();
+	}
+
+	// Without a backend Submit() does the reads itself
+	void SubmitInline()
+	{
+		std::vector<Request*> Batch;
+		std::vector<Request*> Cancelled;
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			Batch.swap(Unsubmitted);
+			Cancelled.swap(CancelledQueued);
+		}
+
+		CompleteCancelled(Cancelled);
+
+		//Visible first, as the backends would
+		std::stable_partition(Batch.begin(), Batch.end(), [](const Request* Current) { return Current->Class == Priority::Visible; });
+		for (Request* Current : Batch)
+		{
+			Complete(Current, ReadAt(*Current) ? Result::Done : Result::Failed);
+		}
+	}
+}
+
+namespace AsyncIO
+{
+	void Initialize(const Settings& InOptions)
+	{
+		assert(ActiveBackend == Backend::Inline && Threads.empty());
+
+		Options = InOptions;
+		Options.QueueDepth = std::max(Options.QueueDepth, 1u);
+		Options.MaxPrefetchInFlight = std::max(std::min(Options.MaxPrefetchInFlight, Options.QueueDepth), 1u);
+		bQuit = false;
+
+#if defined(__linux__)
+		if (!Options.bForceFallback && CreateRing())
+		{
+			ActiveBackend = Backend::Ring;
+			Threads.emplace_back(RingThreadMain);
+			LOG_INFO("Async I/O: io_uring, queue depth %u", Options.QueueDepth);
+			return;
+		}
+#endif
+
+		ActiveBackend = Backend::Pool;
+		for (int Index = 0; Index < std::max(Options.NumFallbackThreads, 1); ++Index)
+		{
+			Threads.emplace_back(PoolThreadMain);
+		}
+		LOG_INFO("Async I/O: pread pool of %d threads", static_cast<int>(Threads.size()));
+	}
+
+	void Shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+
+			//Never submitted or still queued, they complete as cancelled
+			for (Request* Current : Unsubmitted)
+			{
+				CancelledQueued.push_back(Current);
+			}
+			Unsubmitted.clear();
+			for (std::deque<Request*>& Queue : Queues)
+			{
+				CancelledQueued.insert(CancelledQueued.end(), Queue.begin(), Queue.end());
+				Queue.clear();
+			}
+			bQuit = true;
+		}
+
+		if (ActiveBackend == Backend::Inline)
+		{
+			SubmitInline();
+			return;
+		}
+
+		Notify();
+		for (std::thread& Thread : Threads)
+		{
+			Thread.join();
+		}
+		Threads.clear();
+
+#if defined(__linux__)
+		if (ActiveBackend == Backend::Ring)
+		{
+			DestroyRing();
+		}
+#endif
+		ActiveBackend = Backend::Inline;
+	}
+
+	const char* GetBackendName()
+	{
+		switch (ActiveBackend)
+		{
+		case Backend::Ring: return "io_uring";
+		case Backend::Pool: return "pread pool";
+		default: return "inline";
+		}
+	}
+
+	FileHandle OpenFile(const char* FilePath)
+	{
+#if defined(_WIN32)
+		HANDLE File = CreateFileA(FilePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		return File == INVALID_HANDLE_VALUE ? InvalidFile : reinterpret_cast<FileHandle>(File);
+#else
+		const int File = open(FilePath, O_RDONLY | O_CLOEXEC);
+		return File < 0 ? InvalidFile : File;
+#endif
+	}
+
+	void CloseFile(FileHandle File)
+	{
+		if (File == InvalidFile)
+		{
+			return;
+		}
+#if defined(_WIN32)
+		CloseHandle(reinterpret_cast<HANDLE>(File));
+#else
+		close(static_cast<int>(File));
+#endif
+	}
+
+	uint64_t GetFileSize(FileHandle File)
+	{
+#if defined(_WIN32)
+		LARGE_INTEGER Size;
+		return GetFileSizeEx(reinterpret_cast<HANDLE>(File), &Size) ? static_cast<uint64_t>(Size.QuadPart) : 0;
+#else
+		struct stat Status;
+		return fstat(static_cast<int>(File), &Status) == 0 ? static_cast<uint64_t>(Status.st_size) : 0;
+#endif
+	}
+
+	RequestId Read(FileHandle File, uint64_t Offset, size_t Size, void* Destination, Priority Class, Completion OnComplete)
+	{
+		std::unique_ptr<Request> NewRequest(new Request());
+		NewRequest->File = File;
+		NewRequest->Offset = Offset;
+		NewRequest->Destination = static_cast<unsigned char*>(Destination);
+		NewRequest->Size = Size;
+		NewRequest->Class = Class;
+		NewRequest->OnComplete = std::move(OnComplete);
+
+		const unsigned char* Begin = NewRequest->Destination;
+		for (uint32_t Index = 0; Index < Options.NumBuffers; ++Index)
+		{
+			const unsigned char* BufferBegin = static_cast<const unsigned char*>(Options.Buffers[Index].Memory);
+			if (Begin >= BufferBegin && Begin + Size <= BufferBegin + Options.Buffers[Index].Size)
+			{
+				NewRequest->BufferIndex = static_cast<int>(Index);
+				break;
+			}
+		}
+
+		std::lock_guard<std::mutex> Lock(Mutex);
+		NewRequest->Id = NextId++;
+		Unsubmitted.push_back(NewRequest.get());
+
+		const RequestId Id = NewRequest->Id;
+		Requests.emplace(Id, std::move(NewRequest));
+		return Id;
+	}
+
+	RequestId ReadFile(const char* FilePath, Priority Class, std::function<void(Result Outcome, AssetData&& Contents)> OnComplete)
+	{
+		const FileHandle File = OpenFile(FilePath);
+		if (File == InvalidFile)
+		{
+			OnComplete(Result::Failed, AssetData());
+			return 0;
+		}
+
+		//One extra byte so an empty file still gets a buffer
+		const size_t Size = static_cast<size_t>(GetFileSize(File));
+		unsigned char* Contents = static_cast<unsigned char*>(std::malloc(Size + 1));
+		if (Contents == nullptr)
+		{
+			CloseFile(File);
+			OnComplete(Result::Failed, AssetData());
+			return 0;
+		}
+
+		return Read(File, 0, Size, Contents, Class,
+			[File, Contents, Size, Callback = std::move(OnComplete)](Result Outcome, size_t BytesRead)
+			{
+				CloseFile(File);
+				if (Outcome == Result::Done && BytesRead == Size)
+				{
+					Callback(Outcome, AssetData::MakeOwned(Contents, Size, std::free));
+					return;
+				}
+
+				std::free(Contents);
+				Callback(Outcome == Result::Done ? Result::Failed : Outcome, AssetData());
+			});
+	}
+
+	void Submit()
+	{
+		if (ActiveBackend == Backend::Inline)
+		{
+			SubmitInline();
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			if (Unsubmitted.empty())
+			{
+				return;
+			}
+
+			for (Request* Current : Unsubmitted)
+			{
+				Queues[static_cast<int>(Current->Class)].push_back(Current);
+			}
+			Unsubmitted.clear();
+		}
+		Notify();
+	}
+
+	bool Cancel(RequestId Id)
+	{
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+
+			auto Found = Requests.find(Id);
+			if (Found == Requests.end() || Found->second->bCancelled || Found->second->bCompleting)
+			{
+				return false;
+			}
+
+			Request* Current = Found->second.get();
+			Current->bCancelled = true;
+
+			if (Current->bInFlight)
+			{
+#if defined(__linux__)
+				//A pread cannot be interrupted, the ring can be asked to drop the read
+				if (ActiveBackend == Backend::Ring)
+				{
+					ToCancel.push_back(Id);
+				}
+				else
+				{
+					return true;
+				}
+#else
+				return true;
+#endif
+			}
+			else
+			{
+				auto RemoveFrom = [Current](auto& Container)
+				{
+					auto Position = std::find(Container.begin(), Container.end(), Current);
+					if (Position != Container.end())
+					{
+						Container.erase(Position);
+					}
+				};
+				RemoveFrom(Unsubmitted);
+				RemoveFrom(Queues[static_cast<int>(Current->Class)]);
+				CancelledQueued.push_back(Current);
+			}
+		}
+
+		if (ActiveBackend != Backend::Inline)
+		{
+			Notify();
+		}
+		return true;
+	}
+
+	uint32_t GetNumPending()
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		return static_cast<uint32_t>(Requests.size());
+	}
+}
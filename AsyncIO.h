@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "AssetArchive.h"
+
+// Asynchronous file reads.
+// On Linux the reads go through an io_uring: requests are queued by any
+// thread and Submit() hands the whole batch to the kernel in one system
+// call, one I/O thread reaps the completions. Where io_uring is missing or
+// refused (old kernels, seccomp filters in containers) and on other
+// platforms a pool of threads doing positional reads serves the same queues.
+//
+// Two priority classes: Visible requests are always issued before Prefetch
+// ones, and prefetches only use part of the queue depth so a burst of them
+// never delays what the camera needs now. Requests the camera no longer needs
+// can be cancelled, queued ones never reach the disk.
+//
+// Completions run on an I/O thread and must stay short, typically scheduling
+// a decode job. Until Initialize() is called reads are done inline by
+// Submit() so every caller works the same without the I/O thread.
+namespace AsyncIO
+{
+	enum class Priority : uint8_t
+	{
+		Visible,
+		Prefetch,
+		NumPriorities
+	};
+
+	enum class Result : uint8_t
+	{
+		Done,
+		Failed,
+		Cancelled
+	};
+
+	// 0 is never a valid request
+	using RequestId = uint64_t;
+
+	// File descriptor, or HANDLE on Windows
+	using FileHandle = intptr_t;
+	constexpr FileHandle InvalidFile = -1;
+
+	// BytesRead is less than requested only when the file ended before
+	using Completion = std::function<void(Result Outcome, size_t BytesRead)>;
+
+	struct Settings
+	{
+		// Reads in flight in the kernel at once
+		uint32_t QueueDepth = 128;
+
+		// Share of the queue depth prefetches can use
+		uint32_t MaxPrefetchInFlight = 32;
+
+		// Threads of the positional read fallback
+		int NumFallbackThreads = 4;
+
+		// Skip io_uring, to compare the two
+		bool bForceFallback = false;
+
+		// Buffers registered with the ring: reads landing entirely inside one
+		// skip pinning the destination pages on every request
+		struct Buffer
+		{
+			void* Memory;
+			size_t Size;
+		};
+		const Buffer* Buffers = nullptr;
+		uint32_t NumBuffers = 0;
+	};
+
+	void Initialize(const Settings& Options = Settings());
+
+	// Wait for the reads in flight, queued ones complete as cancelled
+	void Shutdown();
+
+	// "io_uring", "pread pool" or "inline"
+	const char* GetBackendName();
+
+	FileHandle OpenFile(const char* FilePath);
+	void CloseFile(FileHandle File);
+
+	// Size in bytes, 0 if unknown
+	uint64_t GetFileSize(FileHandle File);
+
+	// Queue a read of Size bytes at Offset into Destination, issued at the next
+	// Submit(). Destination and the file must stay valid until OnComplete ran
+	RequestId Read(FileHandle File, uint64_t Offset, size_t Size, void* Destination, Priority Class, Completion OnComplete);
+
+	// Queue a read of a whole file into an owned buffer, the file is opened now
+	// and closed once read. Fails right away when the file cannot be opened
+	RequestId ReadFile(const char* FilePath, Priority Class, std::function<void(Result Outcome, AssetData&& Contents)> OnComplete);
+
+	// Issue every queued request, one system call for the batch
+	void Submit();
+
+	// Drop a request still queued, or ask the kernel to abandon it if already
+	// in flight. It completes as Cancelled, or Done if it finished first.
+	// False if the request already completed
+	bool Cancel(RequestId Id);
+
+	// Requests queued or in flight
+	uint32_t GetNumPending();
+}
@@ -0,0 +1,146 @@
+#include "BatchMath.h"
+#include "BatchMathKernels.h"
+
+#include <atomic>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#if BATCHMATH_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	struct ScalarLanes
+	{
+		using Vector = float;
+		static constexpr size_t Width = 1;
+
+		static Vector Load(const float* Source) { return *Source; }
+		static void Store(float* Destination, Vector Value) { *Destination = Value; }
+		static Vector Set(float Value) { return Value; }
+		static Vector Add(Vector A, Vector B) { return A + B; }
+		static Vector Sub(Vector A, Vector B) { return A - B; }
+		static Vector Mul(Vector A, Vector B) { return A * B; }
+		static Vector Div(Vector A, Vector B) { return A / B; }
+		static Vector MulAdd(Vector A, Vector B, Vector C) { return A * B + C; }
+	};
+
+	BatchMath::InstructionSet DetectInstructionSet()
+	{
+#if BATCHMATH_X86 && defined(_MSC_VER)
+		int Registers[4] = {};
+		__cpuid(Registers, 0);
+		const int HighestLeaf = Registers[0];
+
+		__cpuid(Registers, 1);
+		const bool bOsSavesYmm = (Registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x06) == 0x06;
+		const bool bFma = (Registers[2] & (1 << 12)) != 0;
+		if (HighestLeaf < 7 || !bOsSavesYmm)
+		{
+			return BatchMath::InstructionSet::SSE;
+		}
+
+		__cpuidex(Registers, 7, 0);
+		const bool bAvx2 = (Registers[1] & (1 << 5)) != 0;
+		const bool bAvx512 = (Registers[1] & (1 << 16)) != 0 && (_xgetbv(0) & 0xE6) == 0xE6;
+
+		if (bAvx512)
+		{
+			return BatchMath::InstructionSet::AVX512;
+		}
+		return bAvx2 && bFma ? BatchMath::InstructionSet::AVX2 : BatchMath::InstructionSet::SSE;
+#elif BATCHMATH_X86
+		//The compiler runtime also checks that the OS saves the wide registers
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f"))
+		{
+			return BatchMath::InstructionSet::AVX512;
+		}
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		{
+			return BatchMath::InstructionSet::AVX2;
+		}
+		return BatchMath::InstructionSet::SSE;
+#else
+		return BatchMath::InstructionSet::Scalar;
+#endif
+	}
+
+	const BatchMath::Detail::KernelTable& GetKernelTable(BatchMath::InstructionSet Set)
+	{
+		switch (Set)
+		{
+#if BATCHMATH_X86
+		case BatchMath::InstructionSet::SSE: return BatchMath::Detail::SseKernels;
+		case BatchMath::InstructionSet::AVX2: return BatchMath::Detail::Avx2Kernels;
+		case BatchMath::InstructionSet::AVX512: return BatchMath::Detail::Avx512Kernels;
+#endif
+		default: return BatchMath::Detail::ScalarKernels;
+		}
+	}
+
+	std::atomic<int> SelectedSet{ -1 };
+
+	const BatchMath::Detail::KernelTable& GetKernels()
+	{
+		return GetKernelTable(BatchMath::GetInstructionSet());
+	}
+}
+
+const BatchMath::Detail::KernelTable BatchMath::Detail::ScalarKernels = BatchMath::Detail::MakeKernelTable<ScalarLanes>();
+
+BatchMath::InstructionSet BatchMath::GetBestInstructionSet()
+{
+	static const InstructionSet Best = DetectInstructionSet();
+	return Best;
+}
+
+BatchMath::InstructionSet BatchMath::GetInstructionSet()
+{
+	const int Selected = SelectedSet.load(std::memory_order_relaxed);
+	return Selected < 0 ? GetBestInstructionSet() : static_cast<InstructionSet>(Selected);
+}
+
+void BatchMath::SetInstructionSet(InstructionSet Set)
+{
+	if (Set > GetBestInstructionSet())
+	{
+		Set = GetBestInstructionSet();
+	}
+	SelectedSet.store(static_cast<int>(Set), std::memory_order_relaxed);
+}
+
+const char* BatchMath::GetInstructionSetName(InstructionSet Set)
+{
+	switch (Set)
+	{
+	case InstructionSet::Scalar: return "Scalar";
+	case InstructionSet::SSE: return "SSE";
+	case InstructionSet::AVX2: return "AVX2";
+	case InstructionSet::AVX512: return "AVX512";
+	default: return "Unknown";
+	}
+}
+
+void BatchMath::TransformPoints(const glm::mat4& Matrix, const float* X, const float* Y, const float* Z, size_t Count,
+	float* OutX, float* OutY, float* OutZ, float* OutW)
+{
+	GetKernels().TransformPoints(glm::value_ptr(Matrix), X, Y, Z, Count, OutX, OutY, OutZ, OutW);
+}
+
+void BatchMath::TransformDirections(const glm::mat4& Matrix, const float* X, const float* Y, const float* Z, size_t Count,
+	float* OutX, float* OutY, float* OutZ)
+{
+	GetKernels().TransformDirections(glm::value_ptr(Matrix), X, Y, Z, Count, OutX, OutY, OutZ);
+}
+
+void BatchMath::MultiplyMatrices(const glm::mat4& Left, const Mat4Arrays& Right, size_t Count, const Mat4Arrays& Out)
+{
+	GetKernels().MultiplyMatrices(glm::value_ptr(Left), Right.Elements, Count, Out.Elements);
+}
+
+void BatchMath::NormalMatrices(const Mat4Arrays& Matrices, size_t Count, const Mat3Arrays& Out)
+{
+	GetKernels().NormalMatrices(Matrices.Elements, Count, Out.Elements);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// Math over many objects at once, one SIMD lane per object.
+// Inputs and outputs are structures of arrays: the x of every point in one
+// array, the y in another, and one array per element of a matrix. A kernel
+// then loads 4, 8 or 16 objects with each instruction. The per object shuffles
+// of glm::mat4 * glm::vec4 on a single object go away.
+//
+// The instruction set is picked once at runtime among SSE, AVX2 (with FMA) and
+// AVX-512 according to the CPU, with a scalar fallback. Each one is compiled
+// in its own translation unit with the matching compiler flags, so the
+// binary still runs on a CPU without the wider units.
+//
+// Counts need not be multiples of the lane width. The arrays need no special
+// alignment.
+namespace BatchMath
+{
+	enum class InstructionSet : uint8_t
+	{
+		Scalar,
+		SSE,
+		AVX2,
+		AVX512
+	};
+
+	// Widest set the CPU and the OS support
+	InstructionSet GetBestInstructionSet();
+
+	// Set used by the kernels, the best one unless overridden
+	InstructionSet GetInstructionSet();
+
+	// Force a narrower set, to compare them. Clamped to the best one
+	void SetInstructionSet(InstructionSet Set);
+
+	const char* GetInstructionSetName(InstructionSet Set);
+
+	// Elements[Column * 4 + Row][Index], the order of glm::value_ptr
+	struct Mat4Arrays
+	{
+		float* Elements[16];
+	};
+
+	// Elements[Column * 3 + Row][Index]
+	struct Mat3Arrays
+	{
+		float* Elements[9];
+	};
+
+	// Out = Matrix * (X, Y, Z, 1) for Count points
+	void TransformPoints(const glm::mat4& Matrix, const float* X, const float* Y, const float* Z, size_t Count,
+		float* OutX, float* OutY, float* OutZ, float* OutW);
+
+	// Out = Matrix * (X, Y, Z, 0), the translation does not apply
+	void TransformDirections(const glm::mat4& Matrix, const float* X, const float* Y, const float* Z, size_t Count,
+		float* OutX, float* OutY, float* OutZ);
+
+	// Out[i] = Left * Right[i], such as a shared view projection times every
+	// model matrix. Out may be Right
+	void MultiplyMatrices(const glm::mat4& Left, const Mat4Arrays& Right, size_t Count, const Mat4Arrays& Out);
+
+	// Out[i] = inverse transpose of the upper 3x3 of Matrices[i], for normals
+	void NormalMatrices(const Mat4Arrays& Matrices, size_t Count, const Mat3Arrays& Out);
+}
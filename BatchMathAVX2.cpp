@@ -0,0 +1,28 @@
+#include "BatchMathKernels.h"
+
+// Compiled with AVX2 and FMA enabled (CMakeLists.txt), only called when the CPU has them
+#if BATCHMATH_X86
+
+#include <immintrin.h>
+
+namespace
+{
+	struct Avx2Lanes
+	{
+		using Vector = __m256;
+		static constexpr size_t Width = 8;
+
+		static Vector Load(const float* Source) { return _mm256_loadu_ps(Source); }
+		static void Store(float* Destination, Vector Value) { _mm256_storeu_ps(Destination, Value); }
+		static Vector Set(float Value) { return _mm256_set1_ps(Value); }
+		static Vector Add(Vector A, Vector B) { return _mm256_add_ps(A, B); }
+		static Vector Sub(Vector A, Vector B) { return _mm256_sub_ps(A, B); }
+		static Vector Mul(Vector A, Vector B) { return _mm256_mul_ps(A, B); }
+		static Vector Div(Vector A, Vector B) { return _mm256_div_ps(A, B); }
+		static Vector MulAdd(Vector A, Vector B, Vector C) { return _mm256_fmadd_ps(A, B, C); }
+	};
+}
+
+const BatchMath::Detail::KernelTable BatchMath::Detail::Avx2Kernels = BatchMath::Detail::MakeKernelTable<Avx2Lanes>();
+
+#endif
@@ -0,0 +1,28 @@
+#include "BatchMathKernels.h"
+
+// Compiled with AVX-512F enabled (CMakeLists.txt), only called when the CPU has it
+#if BATCHMATH_X86
+
+#include <immintrin.h>
+
+namespace
+{
+	struct Avx512Lanes
+	{
+		using Vector = __m512;
+		static constexpr size_t Width = 16;
+
+		static Vector Load(const float* Source) { return _mm512_loadu_ps(Source); }
+		static void Store(float* Destination, Vector Value) { _mm512_storeu_ps(Destination, Value); }
+		static Vector Set(float Value) { return _mm512_set1_ps(Value); }
+		static Vector Add(Vector A, Vector B) { return _mm512_add_ps(A, B); }
+		static Vector Sub(Vector A, Vector B) { return _mm512_sub_ps(A, B); }
+		static Vector Mul(Vector A, Vector B) { return _mm512_mul_ps(A, B); }
+		static Vector Div(Vector A, Vector B) { return _mm512_div_ps(A, B); }
+		static Vector MulAdd(Vector A, Vector B, Vector C) { return _mm512_fmadd_ps(A, B, C); }
+	};
+}
+
+const BatchMath::Detail::KernelTable BatchMath::Detail::Avx512Kernels = BatchMath::Detail::MakeKernelTable<Avx512Lanes>();
+
+#endif
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstddef>
+
+// Kernels of BatchMath, written once over a Lanes type that wraps the
+// intrinsics of one instruction set:
+//   Vector, Width, Load, Store, Set, Add, Sub, Mul, MulAdd (A * B + C), Div
+// Every instruction set includes this from its own translation unit with
+// Lanes in an anonymous namespace. The instantiations never merge across
+// compiler flags at link time. Matrices are passed as float pointers, so
+// no glm inline function is compiled here with wider flags either.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define BATCHMATH_X86 1
+#else
+#define BATCHMATH_X86 0
+#endif
+
+namespace BatchMath
+{
+	namespace Detail
+	{
+		struct KernelTable
+		{
+			void (*TransformPoints)(const float* Matrix, const float* X, const float* Y, const float* Z, size_t Count,
+				float* OutX, float* OutY, float* OutZ, float* OutW);
+			void (*TransformDirections)(const float* Matrix, const float* X, const float* Y, const float* Z, size_t Count,
+				float* OutX, float* OutY, float* OutZ);
+			void (*MultiplyMatrices)(const float* Left, float* const* Right, size_t Count, float* const* Out);
+			void (*NormalMatrices)(float* const* Matrices, size_t Count, float* const* Out);
+		};
+
+		extern const KernelTable ScalarKernels;
+#if BATCHMATH_X86
+		extern const KernelTable SseKernels;
+		extern const KernelTable Avx2Kernels;
+		extern const KernelTable Avx512Kernels;
+#endif
+
+		// Run Block(Inputs, Outputs, Index) over whole vectors. The last partial
+		// vector goes through zero padded copies of NumInputs and NumOutputs arrays
+		template <typename Lanes, int NumInputs, int NumOutputs, typename Function>
+		void ForEachVector(const float* const* Inputs, float* const* Outputs, size_t Count, const Function& Block)
+		{
+			const size_t NumWhole = Count - Count % Lanes::Width;
+			for (size_t Index = 0; Index < NumWhole; Index += Lanes::Width)
+			{
+				Block(Inputs, Outputs, Index);
+			}
+
+			const size_t Remaining = Count - NumWhole;
+			if (Remaining == 0)
+			{
+				return;
+			}
+
+			float InputTail[NumInputs][Lanes::Width] = {};
+			float OutputTail[NumOutputs][Lanes::Width];
+			const float* TailInputs[NumInputs];
+			float* TailOutputs[NumOutputs];
+
+			for (int Input = 0; Input < NumInputs; ++Input)
+			{
+				for (size_t Lane = 0; Lane < Remaining; ++Lane)
+				{
+					InputTail[Input][Lane] = Inputs[Input][NumWhole + Lane];
+				}
+				TailInputs[Input] = InputTail[Input];
+			}
+			for (int Output = 0; Output < NumOutputs; ++Output)
+			{
+				TailOutputs[Output] = OutputTail[Output];
+			}
+
+			Block(TailInputs, TailOutputs, 0);
+
+			for (int Output = 0; Output < NumOutputs; ++Output)
+			{
+				for (size_t Lane = 0; Lane < Remaining; ++Lane)
+				{
+					Outputs[Output][NumWhole + Lane] = OutputTail[Output][Lane];
+				}
+			}
+		}
+
+		template <typename Lanes>
+		void TransformPoints(const float* Matrix, const float* X, const float* Y, const float* Z, size_t Count,
+			float* OutX, float* OutY, float* OutZ, float* OutW)
+		{
+			using Vector = typename Lanes::Vector;
+
+			Vector M[16];
+			for (int Element = 0; Element < 16; ++Element)
+			{
+				M[Element] = Lanes::Set(Matrix[Element]);
+			}
+
+			const float* Inputs[3] = { X, Y, Z };
+			float* Outputs[4] = { OutX, OutY, OutZ, OutW };
+			ForEachVector<Lanes, 3, 4>(Inputs, Outputs, Count, [&M](const float* const* In, float* const* Out, size_t Index)
+			{
+				const Vector PX = Lanes::Load(In[0] + Index);
+				const Vector PY = Lanes::Load(In[1] + Index);
+				const Vector PZ = Lanes::Load(In[2] + Index);
+
+				for (int Row = 0; Row < 4; ++Row)
+				{
+					const Vector Result = Lanes::MulAdd(M[Row], PX, Lanes::MulAdd(M[4 + Row], PY, Lanes::MulAdd(M[8 + Row], PZ, M[12 + Row])));
+					Lanes::Store(Out[Row] + Index, Result);
+				}
+			});
+		}
+
+		template <typename Lanes>
+		void TransformDirections(const float* Matrix, const float* X, const float* Y, const float* Z, size_t Count,
+			float* OutX, float* OutY, float* OutZ)
+		{
+			using Vector = typename Lanes::Vector;
+
+			Vector M[12];
+			for (int Element = 0; Element < 12; ++Element)
+			{
+				M[Element] = Lanes::Set(Matrix[Element]);
+			}
+
+			const float* Inputs[3] = { X, Y, Z };
+			float* Outputs[3] = { OutX, OutY, OutZ };
+			ForEachVector<Lanes, 3, 3>(Inputs, Outputs, Count, [&M](const float* const* In, float* const* Out, size_t Index)
+			{
+				const Vector DX = Lanes::Load(In[0] + Index);
+				const Vector DY = Lanes::Load(In[1] + Index);
+				const Vector DZ = Lanes::Load(In[2] + Index);
+
+				for (int Row = 0; Row < 3; ++Row)
+				{
+					const Vector Result = Lanes::MulAdd(M[Row], DX, Lanes::MulAdd(M[4 + Row], DY, Lanes::Mul(M[8 + Row], DZ)));
+					Lanes::Store(Out[Row] + Index, Result);
+				}
+			});
+		}
+
+		template <typename Lanes>
+		void MultiplyMatrices(const float* Left, float* const* Right, size_t Count, float* const* Out)
+		{
+			using Vector = typename Lanes::Vector;
+
+			Vector L[16];
+			for (int Element = 0; Element < 16; ++Element)
+			{
+				L[Element] = Lanes::Set(Left[Element]);
+			}
+
+			ForEachVector<Lanes, 16, 16>(Right, Out, Count, [&L](const float* const* In, float* const* Result, size_t Index)
+			{
+				//A column of the result only reads the same column of the right matrix, so Out may be Right
+				for (int Column = 0; Column < 4; ++Column)
+				{
+					const Vector R0 = Lanes::Load(In[Column * 4 + 0] + Index);
+					const Vector R1 = Lanes::Load(In[Column * 4 + 1] + Index);
+					const Vector R2 = Lanes::Load(In[Column * 4 + 2] + Index);
+					const Vector R3 = Lanes::Load(In[Column * 4 + 3] + Index);
+
+					for (int Row = 0; Row < 4; ++Row)
+					{
+						const Vector Sum = Lanes::MulAdd(L[Row], R0, Lanes::MulAdd(L[4 + Row], R1,
+							Lanes::MulAdd(L[8 + Row], R2, Lanes::Mul(L[12 + Row], R3))));
+						Lanes::Store(Result[Column * 4 + Row] + Index, Sum);
+					}
+				}
+			});
+		}
+
+		template <typename Lanes>
+		void NormalMatrices(float* const* Matrices, size_t Count, float* const* Out)
+		{
+			using Vector = typename Lanes::Vector;
+
+			//Only the upper 3x3 is read
+			const float* Inputs[9];
+			for (int Column = 0; Column < 3; ++Column)
+			{
+				for (int Row = 0; Row < 3; ++Row)
+				{
+					Inputs[Column * 3 + Row] = Matrices[Column * 4 + Row];
+				}
+			}
+
+			ForEachVector<Lanes, 9, 9>(Inputs, Out, Count, [](const float* const* In, float* const* Result, size_t Index)
+			{
+				Vector C[9];
+				for (int Element = 0; Element < 9; ++Element)
+				{
+					C[Element] = Lanes::Load(In[Element] + Index);
+				}
+
+				//Columns of the cofactor matrix: cross products of the other two columns
+				Vector Cofactor[9];
+				for (int Column = 0; Column < 3; ++Column)
+				{
+					const Vector* A = C + ((Column + 1) % 3) * 3;
+					const Vector* B = C + ((Column + 2) % 3) * 3;
+					Cofactor[Column * 3 + 0] = Lanes::Sub(Lanes::Mul(A[1], B[2]), Lanes::Mul(A[2], B[1]));
+					Cofactor[Column * 3 + 1] = Lanes::Sub(Lanes::Mul(A[2], B[0]), Lanes::Mul(A[0], B[2]));
+					Cofactor[Column * 3 + 2] = Lanes::Sub(Lanes::Mul(A[0], B[1]), Lanes::Mul(A[1], B[0]));
+				}
+
+				const Vector Determinant = Lanes::MulAdd(C[0], Cofactor[0], Lanes::MulAdd(C[1], Cofactor[1], Lanes::Mul(C[2], Cofactor[2])));
+				const Vector InverseDeterminant = Lanes::Div(Lanes::Set(1.0f), Determinant);
+
+				for (int Element = 0; Element < 9; ++Element)
+				{
+					Lanes::Store(Result[Element] + Index, Lanes::Mul(Cofactor[Element], InverseDeterminant));
+				}
+			});
+		}
+
+		template <typename Lanes>
+		constexpr KernelTable MakeKernelTable()
+		{
+			return KernelTable{ TransformPoints<Lanes>, TransformDirections<Lanes>, MultiplyMatrices<Lanes>, NormalMatrices<Lanes> };
+		}
+	}
+}
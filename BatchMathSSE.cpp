@@ -0,0 +1,29 @@
+#include "BatchMathKernels.h"
+
+#if BATCHMATH_X86
+
+#include <emmintrin.h>
+
+namespace
+{
+	struct SseLanes
+	{
+		using Vector = __m128;
+		static constexpr size_t Width = 4;
+
+		static Vector Load(const float* Source) { return _mm_loadu_ps(Source); }
+		static void Store(float* Destination, Vector Value) { _mm_storeu_ps(Destination, Value); }
+		static Vector Set(float Value) { return _mm_set1_ps(Value); }
+		static Vector Add(Vector A, Vector B) { return _mm_add_ps(A, B); }
+		static Vector Sub(Vector A, Vector B) { return _mm_sub_ps(A, B); }
+		static Vector Mul(Vector A, Vector B) { return _mm_mul_ps(A, B); }
+		static Vector Div(Vector A, Vector B) { return _mm_div_ps(A, B); }
+
+		//No FMA before AVX2
+		static Vector MulAdd(Vector A, Vector B, Vector C) { return _mm_add_ps(_mm_mul_ps(A, B), C); }
+	};
+}
+
+const BatchMath::Detail::KernelTable BatchMath::Detail::SseKernels = BatchMath::Detail::MakeKernelTable<SseLanes>();
+
+#endif
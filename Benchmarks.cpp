@@ -0,0 +1,768 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "AsyncIO.h"
+#include "BatchMath.h"
+#include "EntityWorld.h"
+#include "FrameGraph.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "PerfCounters.h"
+#include "SphereMesh.h"
+
+#ifndef BLUEPLANET_SOURCE_DIR
+#define BLUEPLANET_SOURCE_DIR "."
+#endif
+
+// Only benchmarks whose name contains this text are run (first command line argument)
+const char* Filter = nullptr;
+
+// Highest thread count of the job system scaling runs (second argument), 0 for every hardware thread
+int MaxJobThreads = 0;
+
+// Results are accumulated here so the compiler cannot drop the benchmarked work
+volatile float Sink = 0.0f;
+
+// Run Body Iterations times and print wall time plus hardware counters per element
+template <typename Function>
+void RunBenchmark(PerfCounters& Counters, const char* Name, uint64_t ElementsPerIteration, int Iterations, Function&& Body)
+{
+	if (Filter != nullptr && std::strstr(Name, Filter) == nullptr)
+	{
+		return;
+	}
+
+	//Warm up caches, allocations and branch predictors
+	Body();
+
+	const auto Begin = std::chrono::steady_clock::now();
+	Counters.Start();
+
+	for (int Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		Body();
+	}
+
+	const PerfCounters::Sample Sample = Counters.Stop();
+	const auto End = std::chrono::steady_clock::now();
+
+	const double Seconds = std::chrono::duration<double>(End - Begin).count();
+	const double NumElements = static_cast<double>(ElementsPerIteration) * Iterations;
+
+	std::cout << std::left << std::setw(28) << Name << std::right << std::fixed
+		<< std::setw(10) << std::setprecision(3) << 1000.0 * Seconds / Iterations << " ms/iter"
+		<< std::setw(10) << std::setprecision(2) << 1e9 * Seconds / NumElements << " ns/elem";
+
+	if (Sample.Has(PerfCounters::Cycles) && Sample.Has(PerfCounters::Instructions))
+	{
+		std::cout << "  IPC " << std::setprecision(2)
+			<< static_cast<double>(Sample.Get(PerfCounters::Instructions)) / std::max<uint64_t>(Sample.Get(PerfCounters::Cycles), 1);
+	}
+
+	const PerfCounters::Counter PerElement[] = {
+		PerfCounters::L1DataMisses,
+		PerfCounters::LastLevelCacheMisses,
+		PerfCounters::BranchMisses
+	};
+
+	for (PerfCounters::Counter Which : PerElement)
+	{
+		if (Sample.Has(Which))
+		{
+			std::cout << "  " << PerfCounters::GetName(Which) << "/elem " << std::setprecision(4)
+				<< Sample.Get(Which) / NumElements;
+		}
+	}
+
+	std::cout << std::endl;
+}
+
+void SphereMeshBenchmarks(PerfCounters& Counters)
+{
+	std::vector<Vertex> Vertexes;
+	std::vector<glm::ivec3> Indexes;
+
+	for (GLuint Resolution : { 50u, 256u, 1024u })
+	{
+		const std::string Name = "GenerateSphereMesh/" + std::to_string(Resolution);
+		RunBenchmark(Counters, Name.c_str(), Resolution * Resolution, Resolution > 256 ? 3 : 50, [&]()
+		{
+			GenerateSphereMesh(Resolution, Vertexes, Indexes);
+			Sink = Sink + Vertexes.back().Position.x;
+		});
+	}
+}
+
+void TextureDecodeBenchmarks(PerfCounters& Counters)
+{
+	const char* TextureFile = BLUEPLANET_SOURCE_DIR "/textures/earth_2k.jpg";
+
+	std::ifstream FileStream{ TextureFile, std::ios::in | std::ios::binary };
+	if (!FileStream)
+	{
+		std::cout << "Skipping JPEG decode, " << TextureFile << " not found" << std::endl;
+		return;
+	}
+
+	const std::vector<unsigned char> Encoded{ std::istreambuf_iterator<char>(FileStream), std::istreambuf_iterator<char>() };
+
+	int Width = 0;
+	int Height = 0;
+	int NumberOfComponents = 0;
+	stbi_info_from_memory(Encoded.data(), static_cast<int>(Encoded.size()), &Width, &Height, &NumberOfComponents);
+
+	RunBenchmark(Counters, "DecodeJPEG/earth_2k", static_cast<uint64_t>(Width) * Height, 5, [&]()
+	{
+		int DecodedWidth = 0;
+		int DecodedHeight = 0;
+		unsigned char* Pixels = stbi_load_from_memory(Encoded.data(), static_cast<int>(Encoded.size()),
+			&DecodedWidth, &DecodedHeight, &NumberOfComponents, 3);
+		Sink = Sink + Pixels[0];
+		stbi_image_free(Pixels);
+	});
+}
+
+void MatrixBenchmarks(PerfCounters& Counters)
+{
+	constexpr int NumObjects = 4096;
+	constexpr int NumPoints = 1 << 16;
+
+	std::vector<glm::vec3> Translations(NumObjects);
+	std::vector<float> Angles(NumObjects);
+	std::vector<glm::mat4> ModelMatrices(NumObjects);
+
+	for (int Index = 0; Index < NumObjects; ++Index)
+	{
+		Translations[Index] = glm::vec3{ Index % 64, Index / 64, 0.0f };
+		Angles[Index] = Index * 0.01f;
+	}
+
+	const glm::mat4 I = glm::identity<glm::mat4>();
+
+	//Same composition as Matrices.cpp: Translation * Rotation * Scale
+	RunBenchmark(Counters, "ComposeModelMatrices", NumObjects, 200, [&]()
+	{
+		for (int Index = 0; Index < NumObjects; ++Index)
+		{
+			const glm::mat4 Translation = glm::translate(I, Translations[Index]);
+			const glm::mat4 Rotation = glm::rotate(I, Angles[Index], glm::vec3{ 0, 0, 1 });
+			const glm::mat4 Scale = glm::scale(I, glm::vec3{ 2, 2, 2 });
+			ModelMatrices[Index] = Translation * Rotation * Scale;
+		}
+		Sink = Sink + ModelMatrices[NumObjects - 1][3][0];
+	});
+
+	const glm::mat4 ViewProjection =
+		glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 1.0f, 1000.0f) *
+		glm::lookAt(glm::vec3{ 0, 0, 10 }, glm::vec3{ 0, 0, 0 }, glm::vec3{ 0, 1, 0 });
+
+	std::vector<glm::vec4> Points(NumPoints, glm::vec4{ 1.0f, 2.0f, 3.0f, 1.0f });
+	std::vector<glm::vec4> Transformed(NumPoints);
+
+	RunBenchmark(Counters, "TransformPoints", NumPoints, 200, [&]()
+	{
+		for (int Index = 0; Index < NumPoints; ++Index)
+		{
+			Transformed[Index] = ViewProjection * Points[Index];
+		}
+		Sink = Sink + Transformed[NumPoints - 1].w;
+	});
+}
+
+// Compare every kernel of the current instruction set with glm, within a
+// relative tolerance for the different rounding of the fused multiply adds.
+// The count leaves a partial vector for every lane width, and MultiplyMatrices
+// also runs in place. Prints the first mismatch and returns false
+bool CheckBatchMath(const glm::mat4& ViewProjection)
+{
+	constexpr int Count = 1037;
+	const char* SetName = BatchMath::GetInstructionSetName(BatchMath::GetInstructionSet());
+
+	const auto Matches = [SetName](const char* Kernel, int Index, float Value, float Expected)
+	{
+		if (std::abs(Value - Expected) <= 1e-4f * std::max(1.0f, std::abs(Expected)))
+		{
+			return true;
+		}
+		std::cout << "BatchMath " << SetName << " " << Kernel << " differs from glm at " << Index
+			<< ": " << std::setprecision(6) << Value << " instead of " << Expected << std::endl;
+		return false;
+	};
+
+	std::vector<glm::vec3> Points(Count);
+	std::vector<float> PointComponents(3 * Count);
+	std::vector<float> OutComponents(4 * Count);
+	for (int Index = 0; Index < Count; ++Index)
+	{
+		Points[Index] = glm::vec3{ Index % 37, Index / 37, Index * 0.01f };
+		for (int Component = 0; Component < 3; ++Component)
+		{
+			PointComponents[Component * Count + Index] = Points[Index][Component];
+		}
+	}
+
+	const float* X = PointComponents.data();
+	float* Out = OutComponents.data();
+
+	BatchMath::TransformPoints(ViewProjection, X, X + Count, X + 2 * Count, Count, Out, Out + Count, Out + 2 * Count, Out + 3 * Count);
+	for (int Index = 0; Index < Count; ++Index)
+	{
+		const glm::vec4 Expected = ViewProjection * glm::vec4{ Points[Index], 1.0f };
+		for (int Component = 0; Component < 4; ++Component)
+		{
+			if (!Matches("TransformPoints", Index, Out[Component * Count + Index], Expected[Component]))
+			{
+				return false;
+			}
+		}
+	}
+
+	BatchMath::TransformDirections(ViewProjection, X, X + Count, X + 2 * Count, Count, Out, Out + Count, Out + 2 * Count);
+	for (int Index = 0; Index < Count; ++Index)
+	{
+		const glm::vec4 Expected = ViewProjection * glm::vec4{ Points[Index], 0.0f };
+		for (int Component = 0; Component < 3; ++Component)
+		{
+			if (!Matches("TransformDirections", Index, Out[Component * Count + Index], Expected[Component]))
+			{
+				return false;
+			}
+		}
+	}
+
+	std::vector<glm::mat4> Models(Count);
+	std::vector<float> ModelElements(16 * Count);
+	std::vector<float> ResultElements(16 * Count);
+	std::vector<float> NormalElements(9 * Count);
+
+	BatchMath::Mat4Arrays ModelArrays;
+	BatchMath::Mat4Arrays ResultArrays;
+	BatchMath::Mat3Arrays NormalArrays;
+	for (int Element = 0; Element < 16; ++Element)
+	{
+		ModelArrays.Elements[Element] = ModelElements.data() + Element * Count;
+		ResultArrays.Elements[Element] = ResultElements.data() + Element * Count;
+	}
+	for (int Element = 0; Element < 9; ++Element)
+	{
+		NormalArrays.Elements[Element] = NormalElements.data() + Element * Count;
+	}
+
+	const glm::mat4 I = glm::identity<glm::mat4>();
+	for (int Index = 0; Index < Count; ++Index)
+	{
+		Models[Index] = glm::translate(I, glm::vec3{ Index % 64, Index / 64, 0.0f }) *
+			glm::rotate(I, Index * 0.01f, glm::vec3{ 0, 0, 1 }) *
+			glm::scale(I, glm::vec3{ 1.0f, 2.0f, 1.0f + Index % 3 });
+
+		const float* Elements = glm::value_ptr(Models[Index]);
+		for (int Element = 0; Element < 16; ++Element)
+		{
+			ModelArrays.Elements[Element][Index] = Elements[Element];
+		}
+	}
+
+	BatchMath::NormalMatrices(ModelArrays, Count, NormalArrays);
+	for (int Index = 0; Index < Count; ++Index)
+	{
+		const glm::mat3 Expected = glm::inverseTranspose(glm::mat3{ Models[Index] });
+		for (int Element = 0; Element < 9; ++Element)
+		{
+			if (!Matches("NormalMatrices", Index, NormalArrays.Elements[Element][Index], glm::value_ptr(Expected)[Element]))
+			{
+				return false;
+			}
+		}
+	}
+
+	//Separate output first, then the model arrays overwritten in place
+	for (const BatchMath::Mat4Arrays* Result : { &ResultArrays, &ModelArrays })
+	{
+		BatchMath::MultiplyMatrices(ViewProjection, ModelArrays, Count, *Result);
+		for (int Index = 0; Index < Count; ++Index)
+		{
+			const glm::mat4 Expected = ViewProjection * Models[Index];
+			for (int Element = 0; Element < 16; ++Element)
+			{
+				if (!Matches(Result == &ModelArrays ? "MultiplyMatrices in place" : "MultiplyMatrices",
+					Index, Result->Elements[Element][Index], glm::value_ptr(Expected)[Element]))
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+// The batched SoA kernels for every instruction set the CPU has, against the
+// same math one object at a time with glm
+void BatchMathBenchmarks(PerfCounters& Counters)
+{
+	constexpr int NumPoints = 1 << 16;
+	constexpr int NumObjects = 4096;
+
+	const glm::mat4 ViewProjection =
+		glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 1.0f, 1000.0f) *
+		glm::lookAt(glm::vec3{ 0, 0, 10 }, glm::vec3{ 0, 0, 0 }, glm::vec3{ 0, 1, 0 });
+
+	//Points and directions: the same values as arrays of vec3 and as one array per component
+	std::vector<glm::vec3> Points(NumPoints);
+	std::vector<glm::vec4> TransformedPoints(NumPoints);
+	std::vector<glm::vec3> TransformedDirections(NumPoints);
+	std::vector<float> PointComponents(3 * NumPoints);
+	std::vector<float> OutComponents(4 * NumPoints);
+
+	for (int Index = 0; Index < NumPoints; ++Index)
+	{
+		Points[Index] = glm::vec3{ Index % 256, Index / 256, Index * 0.001f };
+		PointComponents[Index] = Points[Index].x;
+		PointComponents[NumPoints + Index] = Points[Index].y;
+		PointComponents[2 * NumPoints + Index] = Points[Index].z;
+	}
+
+	const float* X = PointComponents.data();
+	const float* Y = X + NumPoints;
+	const float* Z = Y + NumPoints;
+	float* OutX = OutComponents.data();
+	float* OutY = OutX + NumPoints;
+	float* OutZ = OutY + NumPoints;
+	float* OutW = OutZ + NumPoints;
+
+	//Model matrices of the objects: glm matrices and one array per element
+	std::vector<glm::mat4> Models(NumObjects);
+	std::vector<glm::mat4> ModelViewProjections(NumObjects);
+	std::vector<glm::mat3> Normals(NumObjects);
+	std::vector<float> ModelElements(16 * NumObjects);
+	std::vector<float> ResultElements(16 * NumObjects);
+	std::vector<float> NormalElements(9 * NumObjects);
+
+	BatchMath::Mat4Arrays ModelArrays;
+	BatchMath::Mat4Arrays ResultArrays;
+	BatchMath::Mat3Arrays NormalArrays;
+	for (int Element = 0; Element < 16; ++Element)
+	{
+		ModelArrays.Elements[Element] = ModelElements.data() + Element * NumObjects;
+		ResultArrays.Elements[Element] = ResultElements.data() + Element * NumObjects;
+	}
+	for (int Element = 0; Element < 9; ++Element)
+	{
+		NormalArrays.Elements[Element] = NormalElements.data() + Element * NumObjects;
+	}
+
+	const glm::mat4 I = glm::identity<glm::mat4>();
+	for (int Index = 0; Index < NumObjects; ++Index)
+	{
+		Models[Index] = glm::translate(I, glm::vec3{ Index % 64, Index / 64, 0.0f }) *
+			glm::rotate(I, Index * 0.01f, glm::vec3{ 0, 0, 1 }) *
+			glm::scale(I, glm::vec3{ 1.0f, 2.0f, 1.0f + Index % 3 });
+
+		const float* Elements = glm::value_ptr(Models[Index]);
+		for (int Element = 0; Element < 16; ++Element)
+		{
+			ModelArrays.Elements[Element][Index] = Elements[Element];
+		}
+	}
+
+	RunBenchmark(Counters, "Glm/Points", NumPoints, 200, [&]()
+	{
+		for (int Index = 0; Index < NumPoints; ++Index)
+		{
+			TransformedPoints[Index] = ViewProjection * glm::vec4{ Points[Index], 1.0f };
+		}
+		Sink = Sink + TransformedPoints[NumPoints - 1].w;
+	});
+
+	RunBenchmark(Counters, "Glm/Directions", NumPoints, 200, [&]()
+	{
+		for (int Index = 0; Index < NumPoints; ++Index)
+		{
+			TransformedDirections[Index] = glm::vec3{ ViewProjection * glm::vec4{ Points[Index], 0.0f } };
+		}
+		Sink = Sink + TransformedDirections[NumPoints - 1].z;
+	});
+
+	RunBenchmark(Counters, "Glm/Matrices", NumObjects, 200, [&]()
+	{
+		for (int Index = 0; Index < NumObjects; ++Index)
+		{
+			ModelViewProjections[Index] = ViewProjection * Models[Index];
+		}
+		Sink = Sink + ModelViewProjections[NumObjects - 1][3][3];
+	});
+
+	RunBenchmark(Counters, "Glm/NormalMatrices", NumObjects, 200, [&]()
+	{
+		for (int Index = 0; Index < NumObjects; ++Index)
+		{
+			Normals[Index] = glm::inverseTranspose(glm::mat3{ Models[Index] });
+		}
+		Sink = Sink + Normals[NumObjects - 1][2][2];
+	});
+
+	const int Best = static_cast<int>(BatchMath::GetBestInstructionSet());
+	for (int Set = 0; Set <= Best; ++Set)
+	{
+		BatchMath::SetInstructionSet(static_cast<BatchMath::InstructionSet>(Set));
+		const std::string Suffix = std::string("/") + BatchMath::GetInstructionSetName(BatchMath::GetInstructionSet());
+
+		//A wrong kernel is not worth timing
+		if (!CheckBatchMath(ViewProjection))
+		{
+			std::exit(EXIT_FAILURE);
+		}
+
+		RunBenchmark(Counters, ("Batch/Points" + Suffix).c_str(), NumPoints, 200, [&]()
+		{
+			BatchMath::TransformPoints(ViewProjection, X, Y, Z, NumPoints, OutX, OutY, OutZ, OutW);
+			Sink = Sink + OutW[NumPoints - 1];
+		});
+
+		RunBenchmark(Counters, ("Batch/Directions" + Suffix).c_str(), NumPoints, 200, [&]()
+		{
+			BatchMath::TransformDirections(ViewProjection, X, Y, Z, NumPoints, OutX, OutY, OutZ);
+			Sink = Sink + OutZ[NumPoints - 1];
+		});
+
+		RunBenchmark(Counters, ("Batch/Matrices" + Suffix).c_str(), NumObjects, 200, [&]()
+		{
+			BatchMath::MultiplyMatrices(ViewProjection, ModelArrays, NumObjects, ResultArrays);
+			Sink = Sink + ResultArrays.Elements[15][NumObjects - 1];
+		});
+
+		RunBenchmark(Counters, ("Batch/NormalMatrices" + Suffix).c_str(), NumObjects, 200, [&]()
+		{
+			BatchMath::NormalMatrices(ModelArrays, NumObjects, NormalArrays);
+			Sink = Sink + NormalArrays.Elements[8][NumObjects - 1];
+		});
+	}
+
+	BatchMath::SetInstructionSet(BatchMath::GetBestInstructionSet());
+}
+
+// Cost of a log call on the calling thread. Bursts of half the ring are
+// flushed in between, untimed, so no message is dropped
+void LogBenchmarks()
+{
+	const char* Name = "Log/Write";
+	if (Filter != nullptr && std::strstr(Name, Filter) == nullptr)
+	{
+		return;
+	}
+
+	const char* LogFile = "Benchmarks.log";
+	Log::Initialize(LogFile);
+
+	constexpr int BurstSize = Log::RingSize / 2;
+	constexpr int NumBursts = 200;
+
+	double Seconds = 0.0;
+	for (int Burst = 0; Burst < NumBursts; ++Burst)
+	{
+		Log::Flush();
+
+		const auto Begin = std::chrono::steady_clock::now();
+		for (int Index = 0; Index < BurstSize; ++Index)
+		{
+			LOG_INFO("Button: %d Action: %d Mouse delta: %.1f, %.1f", Index, Burst, Index * 0.5f, Burst * 0.25f);
+		}
+		Seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - Begin).count();
+	}
+
+	const uint64_t NumDropped = Log::GetNumDropped();
+	Log::Shutdown();
+	std::remove(LogFile);
+
+	std::cout << std::left << std::setw(28) << Name << std::right << std::fixed
+		<< std::setw(10) << std::setprecision(3) << 1000.0 * Seconds / NumBursts << " ms/iter"
+		<< std::setw(10) << std::setprecision(2) << 1e9 * Seconds / (static_cast<double>(BurstSize) * NumBursts) << " ns/elem"
+		<< "  dropped " << NumDropped << std::endl;
+}
+
+// Scaling of the job system from 1 to N threads, over the same work for each count
+void JobSystemBenchmarks(PerfCounters& Counters)
+{
+	const int HardwareThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	const int HighestThreads = std::min(MaxJobThreads > 0 ? MaxJobThreads : HardwareThreads, JobSystem::MaxThreads);
+
+	std::vector<int> ThreadCounts;
+	for (int NumThreads = 1; NumThreads < HighestThreads; NumThreads *= 2)
+	{
+		ThreadCounts.push_back(NumThreads);
+	}
+	ThreadCounts.push_back(HighestThreads);
+
+	constexpr int NumPoints = 1 << 20;
+	std::vector<glm::vec4> Points(NumPoints, glm::vec4{ 1.0f, 2.0f, 3.0f, 1.0f });
+	std::vector<glm::vec4> Transformed(NumPoints);
+	const glm::mat4 ViewProjection =
+		glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 1.0f, 1000.0f) *
+		glm::lookAt(glm::vec3{ 0, 0, 10 }, glm::vec3{ 0, 0, 0 }, glm::vec3{ 0, 1, 0 });
+
+	std::vector<Vertex> Vertexes;
+	std::vector<glm::ivec3> Indexes;
+
+	constexpr int NumEmptyJobs = 2048;
+
+	FrameGraph Graph;
+	const FrameGraph::ResourceId Simulation = Graph.AddResource("Simulation");
+	const FrameGraph::ResourceId View = Graph.AddResource("View");
+	const FrameGraph::ResourceId Redraw = Graph.AddResource("Redraw");
+	const FrameGraph::ResourceId Occlusion = Graph.AddResource("Occlusion");
+	const FrameGraph::ResourceId Status = Graph.AddResource("Status");
+	const FrameGraph::ResourceId Snapshot = Graph.AddResource("Snapshot");
+	Graph.AddTask("Simulate", {}, { Simulation }, []() {});
+	Graph.AddTask("Camera", { Simulation }, { View }, []() {});
+	Graph.AddTask("RedrawCheck", { View }, { Redraw }, []() {});
+	Graph.AddTask("OcclusionCulling", { View, Redraw }, { Occlusion }, []() {});
+	Graph.AddTask("StatusText", { Simulation, Redraw }, { Status }, []() {});
+	Graph.AddTask("Snapshot", { View, Redraw, Occlusion, Status }, { Snapshot }, []() {});
+	Graph.Compile();
+
+	for (int NumThreads : ThreadCounts)
+	{
+		JobSystem::Initialize(NumThreads);
+
+		const std::string Suffix = "/T" + std::to_string(NumThreads);
+
+		RunBenchmark(Counters, ("Jobs/TransformPoints" + Suffix).c_str(), NumPoints, 50, [&]()
+		{
+			JobSystem::ParallelFor(0, NumPoints, 4096, [&](int64_t Begin, int64_t End)
+			{
+				for (int64_t Index = Begin; Index < End; ++Index)
+				{
+					Transformed[Index] = ViewProjection * Points[Index];
+				}
+			});
+			Sink = Sink + Transformed[NumPoints - 1].w;
+		});
+
+		RunBenchmark(Counters, ("Jobs/SphereMesh1024" + Suffix).c_str(), 1024 * 1024, 5, [&]()
+		{
+			GenerateSphereMesh(1024, Vertexes, Indexes);
+			Sink = Sink + Vertexes.back().Position.x;
+		});
+
+		//Scheduling overhead: jobs that do nothing, from one producer
+		RunBenchmark(Counters, ("Jobs/EmptyJobs" + Suffix).c_str(), NumEmptyJobs, 200, [&]()
+		{
+			JobSystem::Counter Done;
+			for (int Index = 0; Index < NumEmptyJobs; ++Index)
+			{
+				JobSystem::Run([]() {}, &Done);
+			}
+			JobSystem::Wait(Done);
+		});
+
+		//Per frame cost of the graph itself: the stages of the simulation frame with empty bodies
+		RunBenchmark(Counters, ("Jobs/FrameGraph" + Suffix).c_str(), 6, 2000, [&]()
+		{
+			Graph.Execute();
+		});
+
+		JobSystem::Shutdown();
+	}
+}
+
+struct TransformComponent
+{
+	glm::vec3 Translation;
+	float Scale;
+	glm::quat Rotation;
+};
+
+struct BoundsComponent
+{
+	glm::vec3 Center;
+	float Radius;
+};
+
+struct SelectedComponent
+{
+	uint8_t bSelected;
+};
+
+// Bounds of every object from its transform, in the entity world against
+// the same data in one struct per object with the fields a game object drags along
+void EntityBenchmarks(PerfCounters& Counters)
+{
+	constexpr int NumEntities = 1 << 20;
+	constexpr int NumMoved = 1 << 16;
+
+	struct GameObject
+	{
+		TransformComponent Transform;
+		BoundsComponent Bounds;
+		glm::mat4 World;
+		char Name[32];
+	};
+
+	std::vector<GameObject> Objects(NumEntities);
+	EntityWorld World;
+	std::vector<Entity> Entities(NumEntities);
+
+	for (int Index = 0; Index < NumEntities; ++Index)
+	{
+		const TransformComponent Transform{ glm::vec3{ Index % 1024, Index / 1024, 0.0f }, 1.0f + (Index % 7), glm::quat{ 1.0f, 0.0f, 0.0f, 0.0f } };
+		Objects[Index].Transform = Transform;
+		Entities[Index] = World.Create(Transform, BoundsComponent{ glm::vec3{ 0.0f }, 0.0f });
+	}
+
+	RunBenchmark(Counters, "Objects/Bounds1M", NumEntities, 20, [&]()
+	{
+		for (GameObject& Object : Objects)
+		{
+			Object.Bounds.Center = Object.Transform.Translation;
+			Object.Bounds.Radius = Object.Transform.Scale * 1.5f;
+		}
+		Sink = Sink + Objects[NumEntities - 1].Bounds.Radius;
+	});
+
+	RunBenchmark(Counters, "Entities/Bounds1M", NumEntities, 20, [&]()
+	{
+		World.ForEach<TransformComponent, BoundsComponent>([](const TransformComponent& Transform, BoundsComponent& Bounds)
+		{
+			Bounds.Center = Transform.Translation;
+			Bounds.Radius = Transform.Scale * 1.5f;
+		});
+		Sink = Sink + World.Get<BoundsComponent>(Entities[NumEntities - 1]).Radius;
+	});
+
+	JobSystem::Initialize(MaxJobThreads);
+
+	RunBenchmark(Counters, ("Entities/Bounds1M/T" + std::to_string(JobSystem::GetNumThreads())).c_str(), NumEntities, 20, [&]()
+	{
+		World.ParallelForEach<TransformComponent, BoundsComponent>([](const TransformComponent& Transform, BoundsComponent& Bounds)
+		{
+			Bounds.Center = Transform.Translation;
+			Bounds.Radius = Transform.Scale * 1.5f;
+		});
+		Sink = Sink + World.Get<BoundsComponent>(Entities[NumEntities - 1]).Radius;
+	});
+
+	JobSystem::Shutdown();
+
+	//Structural changes: every add and remove moves the entity to another archetype
+	RunBenchmark(Counters, "Entities/AddRemove", 2 * NumMoved, 20, [&]()
+	{
+		for (int Index = 0; Index < NumMoved; ++Index)
+		{
+			World.Add(Entities[Index * 16], SelectedComponent{ 1 });
+		}
+		for (int Index = 0; Index < NumMoved; ++Index)
+		{
+			World.Remove<SelectedComponent>(Entities[Index * 16]);
+		}
+	});
+}
+
+void AsyncIOBenchmarks(PerfCounters& Counters)
+{
+	const char* DataFile = BLUEPLANET_SOURCE_DIR "/textures/earth_clouds_2k.jpg";
+
+	const AsyncIO::FileHandle File = AsyncIO::OpenFile(DataFile);
+	if (File == AsyncIO::InvalidFile)
+	{
+		std::cout << "Skipping async I/O, " << DataFile << " not found" << std::endl;
+		return;
+	}
+
+	//Small random reads, like tiles streamed around the camera, the file stays in the page cache
+	constexpr size_t ReadSize = 4096;
+	constexpr int NumReads = 4096;
+	const uint64_t NumBlocks = std::max<uint64_t>(AsyncIO::GetFileSize(File) / ReadSize, 1);
+	std::vector<unsigned char> Destination(ReadSize * NumReads);
+
+	std::vector<uint64_t> Offsets(NumReads);
+	uint32_t Random = 12345;
+	for (uint64_t& Offset : Offsets)
+	{
+		Random = Random * 1664525u + 1013904223u;
+		Offset = (Random % NumBlocks) * ReadSize;
+	}
+
+	AsyncIO::Settings::Buffer Registered{ Destination.data(), Destination.size() };
+
+	//Not initialized the reads are done inline, then the pool, then the ring if the kernel allows it
+	for (int Mode = 0; Mode < 3; ++Mode)
+	{
+		if (Mode > 0)
+		{
+			AsyncIO::Settings Options;
+			Options.bForceFallback = Mode == 1;
+			Options.Buffers = &Registered;
+			Options.NumBuffers = 1;
+			AsyncIO::Initialize(Options);
+		}
+
+		if (Mode < 2 || std::strcmp(AsyncIO::GetBackendName(), "io_uring") == 0)
+		{
+			const std::string Name = std::string("IO/RandomReads4K/") + AsyncIO::GetBackendName();
+			RunBenchmark(Counters, Name.c_str(), NumReads, 20, [&]()
+			{
+				std::atomic<int> Remaining{ NumReads };
+				for (int Index = 0; Index < NumReads; ++Index)
+				{
+					const AsyncIO::Priority Class = Index % 4 == 0 ? AsyncIO::Priority::Visible : AsyncIO::Priority::Prefetch;
+					AsyncIO::Read(File, Offsets[Index], ReadSize, &Destination[Index * ReadSize], Class,
+						[&Remaining](AsyncIO::Result, size_t) { Remaining.fetch_sub(1, std::memory_order_release); });
+				}
+				AsyncIO::Submit();
+
+				while (Remaining.load(std::memory_order_acquire) != 0)
+				{
+					std::this_thread::yield();
+				}
+				Sink = Sink + Destination[ReadSize];
+			});
+		}
+
+		if (Mode > 0)
+		{
+			AsyncIO::Shutdown();
+		}
+	}
+
+	AsyncIO::CloseFile(File);
+}
+
+int main(int argc, char** argv)
+{
+	Filter = argc > 1 ? argv[1] : nullptr;
+	MaxJobThreads = argc > 2 ? std::atoi(argv[2]) : 0;
+
+	PerfCounters Counters;
+	if (!Counters.IsAvailable())
+	{
+		std::cout << "Hardware counters unavailable, reporting wall time only" << std::endl;
+	}
+
+	SphereMeshBenchmarks(Counters);
+	TextureDecodeBenchmarks(Counters);
+	MatrixBenchmarks(Counters);
+	BatchMathBenchmarks(Counters);
+	LogBenchmarks();
+	JobSystemBenchmarks(Counters);
+	EntityBenchmarks(Counters);
+	AsyncIOBenchmarks(Counters);
+
+	return 0;
+}
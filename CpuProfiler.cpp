@@ -0,0 +1,224 @@
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace
+{
+	struct ZoneEvent
+	{
+		const char* Name;
+		uint64_t Begin;
+		uint64_t End;
+		uint32_t Depth;
+	};
+
+	// Single writer (the owning thread), read only by EndCapture(). A slot is
+	// only written after the count of the events before it was published, so a
+	// reader that copied a slot and then still sees the old count knows the
+	// slot was not being overwritten
+	struct ThreadBuffer
+	{
+		uint32_t ThreadId = 0;
+		const char* Name = nullptr;
+		std::unique_ptr<ZoneEvent[]> Events{ new ZoneEvent[CpuProfiler::EventsPerThread] };
+		std::atomic<uint64_t> NumWritten{ 0 };
+	};
+
+	// Buffers outlive their threads so a capture can still read them
+	std::mutex RegistryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> Registry;
+
+	std::atomic<bool> bCapturing{ false };
+	std::atomic<uint64_t> CaptureBegin{ 0 };
+
+	thread_local ThreadBuffer* LocalBuffer = nullptr;
+	thread_local uint32_t LocalDepth = 0;
+
+	ThreadBuffer& GetLocalBuffer()
+	{
+		if (LocalBuffer == nullptr)
+		{
+			std::lock_guard<std::mutex> Lock(RegistryMutex);
+			Registry.push_back(std::make_unique<ThreadBuffer>());
+			LocalBuffer = Registry.back().get();
+			LocalBuffer->ThreadId = static_cast<uint32_t>(Registry.size());
+		}
+
+		return *LocalBuffer;
+	}
+
+	//Trace event timestamps are microseconds, keep the nanoseconds as decimals
+	void WriteMicroseconds(std::ostream& Out, uint64_t Nanoseconds)
+	{
+		Out << Nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << Nanoseconds % 1000 << std::setfill(' ');
+	}
+
+	void WriteEscaped(std::ostream& Out, const char* Text)
+	{
+		for (; *Text; ++Text)
+		{
+			if (*Text == '"' || *Text == '\\')
+			{
+				Out << '\\';
+			}
+			Out << *Text;
+		}
+	}
+}
+
+uint64_t CpuProfiler::Now()
+{
+#if defined(_WIN32)
+	static const uint64_t Frequency = []()
+	{
+		LARGE_INTEGER Value;
+		QueryPerformanceFrequency(&Value);
+		return static_cast<uint64_t>(Value.QuadPart);
+	}();
+
+	LARGE_INTEGER Counter;
+	QueryPerformanceCounter(&Counter);
+
+	//Split to avoid overflowing the 64 bit multiplication
+	const uint64_t Ticks = static_cast<uint64_t>(Counter.QuadPart);
+	return (Ticks / Frequency) * 1000000000ull + (Ticks % Frequency) * 1000000000ull / Frequency;
+#else
+	timespec Time;
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return static_cast<uint64_t>(Time.tv_sec) * 1000000000ull + static_cast<uint64_t>(Time.tv_nsec);
+#endif
+}
+
+void CpuProfiler::SetThreadName(const char* Name)
+{
+	GetLocalBuffer().Name = Name;
+}
+
+void CpuProfiler::RecordZone(const char* Name, uint64_t Begin, uint64_t End, uint32_t Depth)
+{
+	if (!bCapturing.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	ThreadBuffer& Buffer = GetLocalBuffer();
+	const uint64_t Index = Buffer.NumWritten.load(std::memory_order_relaxed);
+
+	//The slot may still be read by EndCapture(), keep the write after the count published last time
+	std::atomic_thread_fence(std::memory_order_release);
+	Buffer.Events[Index % EventsPerThread] = ZoneEvent{ Name, Begin, End, Depth };
+	Buffer.NumWritten.store(Index + 1, std::memory_order_release);
+}
+
+uint32_t CpuProfiler::EnterZone()
+{
+	return LocalDepth++;
+}
+
+void CpuProfiler::LeaveZone()
+{
+	--LocalDepth;
+}
+
+void CpuProfiler::BeginCapture()
+{
+	CaptureBegin = Now();
+	bCapturing = true;
+}
+
+bool CpuProfiler::IsCapturing()
+{
+	return bCapturing;
+}
+
+bool CpuProfiler::EndCapture(const char* FilePath)
+{
+	bCapturing = false;
+
+	std::ofstream Out{ FilePath };
+	if (!Out)
+	{
+		std::cout << "Could not write profiler capture " << FilePath << std::endl;
+		return false;
+	}
+
+	const uint64_t Origin = CaptureBegin;
+	size_t NumEvents = 0;
+
+	Out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+	std::lock_guard<std::mutex> Lock(RegistryMutex);
+
+	//A thread that saw bCapturing just before it was cleared may still be writing its ring
+	std::vector<ZoneEvent> Events;
+	Events.reserve(EventsPerThread);
+
+	bool bFirst = true;
+	for (const std::unique_ptr<ThreadBuffer>& Buffer : Registry)
+	{
+		if (Buffer->Name != nullptr)
+		{
+			Out << (bFirst ? "" : ",\n")
+				<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << Buffer->ThreadId
+				<< ",\"args\":{\"name\":\"";
+			WriteEscaped(Out, Buffer->Name);
+			Out << "\"}}";
+			bFirst = false;
+		}
+
+		const uint64_t NumWritten = Buffer->NumWritten.load(std::memory_order_acquire);
+		const uint64_t First = NumWritten > EventsPerThread ? NumWritten - EventsPerThread : 0;
+
+		Events.clear();
+		for (uint64_t Index = First; Index < NumWritten; ++Index)
+		{
+			Events.push_back(Buffer->Events[Index % EventsPerThread]);
+		}
+
+		//Slots of the events written meanwhile, and the one being written now, may be torn
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64_t NewNumWritten = Buffer->NumWritten.load(std::memory_order_relaxed);
+		const uint64_t FirstIntact = NewNumWritten + 1 > EventsPerThread ? NewNumWritten + 1 - EventsPerThread : 0;
+
+		for (uint64_t Index = std::max(First, FirstIntact); Index < NumWritten; ++Index)
+		{
+			const ZoneEvent& Event = Events[Index - First];
+			if (Event.Begin < Origin)
+			{
+				continue;
+			}
+
+			Out << (bFirst ? "" : ",\n")
+				<< "{\"name\":\"";
+			WriteEscaped(Out, Event.Name);
+			Out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << Buffer->ThreadId
+				<< ",\"ts\":";
+			WriteMicroseconds(Out, Event.Begin - Origin);
+			Out << ",\"dur\":";
+			WriteMicroseconds(Out, Event.End - Event.Begin);
+			Out << ",\"args\":{\"depth\":" << Event.Depth << "}}";
+			bFirst = false;
+			++NumEvents;
+		}
+	}
+
+	Out << "\n]}\n";
+
+	std::cout << "Profiler capture written to " << FilePath << " (" << NumEvents << " zones)" << std::endl;
+	return true;
+}
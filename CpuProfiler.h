@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+// Hierarchical CPU profiler.
+// Scoped zones record their begin and end timestamps (nanoseconds, monotonic
+// clock) into a ring buffer owned by the calling thread, so recording never
+// takes a lock. A capture collects the zones of every thread between
+// BeginCapture() and EndCapture() and writes them as Chrome trace event
+// JSON, which can be opened in chrome://tracing or ui.perfetto.dev.
+//
+// Use the PROFILE_* macros. Unless BLUEPLANET_PROFILE is defined they
+// expand to nothing, so disabled zones cost nothing in release builds.
+namespace CpuProfiler
+{
+	// Events kept per thread, older events are overwritten
+	constexpr uint32_t EventsPerThread = 1 << 16;
+
+	// Current time of the monotonic clock in nanoseconds
+	uint64_t Now();
+
+	// Name shown for the calling thread in the trace
+	void SetThreadName(const char* Name);
+
+	// Record a finished zone. Name must have static storage (a literal)
+	void RecordZone(const char* Name, uint64_t Begin, uint64_t End, uint32_t Depth);
+
+	// Nesting depth of the calling thread, maintained by Zone
+	uint32_t EnterZone();
+	void LeaveZone();
+
+	void BeginCapture();
+	bool IsCapturing();
+
+	// Write every zone recorded since BeginCapture() to FilePath
+	bool EndCapture(const char* FilePath);
+
+	class Zone
+	{
+	public:
+		explicit Zone(const char* InName)
+			: Name(InName)
+			, Depth(EnterZone())
+			, Begin(Now())
+		{
+		}
+
+		~Zone()
+		{
+			RecordZone(Name, Begin, Now(), Depth);
+			LeaveZone();
+		}
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* Name;
+		uint32_t Depth;
+		uint64_t Begin;
+	};
+}
+
+#define PROFILE_CONCAT_INNER(A, B) A##B
+#define PROFILE_CONCAT(A, B) PROFILE_CONCAT_INNER(A, B)
+
+#if defined(BLUEPLANET_PROFILE) && BLUEPLANET_PROFILE
+#define PROFILE_SCOPE(Name) CpuProfiler::Zone PROFILE_CONCAT(ProfileZone, __LINE__)(Name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_THREAD_NAME(Name) CpuProfiler::SetThreadName(Name)
+#else
+#define PROFILE_SCOPE(Name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(Name)
+#endif
@@ -0,0 +1,191 @@
+#include "EntityWorld.h"
+
+#include <algorithm>
+#include <cstdio>
+
+std::array<EntityWorld::ComponentType, EntityWorld::MaxComponentTypes> EntityWorld::ComponentTypes;
+std::atomic<uint32_t> EntityWorld::NumComponentTypes{ 0 };
+
+uint32_t EntityWorld::RegisterComponentType(size_t Size, size_t Alignment)
+{
+	const uint32_t Id = NumComponentTypes.fetch_add(1);
+	assert(Id < MaxComponentTypes && "Too many component types for the mask");
+	assert(Alignment <= alignof(Chunk));
+
+	ComponentTypes[Id] = ComponentType{ static_cast<uint32_t>(Size), static_cast<uint32_t>(Alignment) };
+	return Id;
+}
+
+void EntityWorld::Destroy(Entity Target)
+{
+	if (!IsAlive(Target))
+	{
+		return;
+	}
+
+	Record& Location = Records[Target.Index];
+	RemoveRow(*Location.Type, Location.Row);
+
+	Location.Type = nullptr;
+	Location.Generation = NextGeneration(Location.Generation);
+	FreeIndexes.push_back(Target.Index);
+	--NumEntities;
+}
+
+uint32_t EntityWorld::GetNumChunks() const
+{
+	uint32_t NumChunks = 0;
+	for (const std::unique_ptr<Archetype>& Type : Archetypes)
+	{
+		NumChunks += static_cast<uint32_t>(Type->Chunks.size());
+	}
+	return NumChunks;
+}
+
+void EntityWorld::FormatSummary(char* Text, size_t TextSize) const
+{
+	std::snprintf(Text, TextSize, "Entities %u in %u archetypes, %u chunks of %zu KB",
+		NumEntities, GetNumArchetypes(), GetNumChunks(), ChunkSize / 1024);
+}
+
+EntityWorld::Archetype& EntityWorld::FindArchetype(ComponentMask Mask)
+{
+	const auto Found = ArchetypesByMask.find(Mask);
+	if (Found != ArchetypesByMask.end())
+	{
+		return *Found->second;
+	}
+
+	std::unique_ptr<Archetype> Type(new Archetype());
+	Type->Mask = Mask;
+	Type->Columns.fill(-1);
+
+	uint32_t RowSize = sizeof(Entity);
+	for (uint32_t Id = 0; Id < MaxComponentTypes; ++Id)
+	{
+		if (Mask & (ComponentMask{ 1 } << Id))
+		{
+			Type->Columns[Id] = static_cast<int8_t>(Type->ComponentIds.size());
+			Type->ComponentIds.push_back(Id);
+			Type->Sizes.push_back(ComponentTypes[Id].Size);
+			RowSize += ComponentTypes[Id].Size;
+		}
+	}
+
+	//As many rows as fit once every array is aligned, the padding costs a row at most
+	uint32_t Capacity = static_cast<uint32_t>(ChunkSize / RowSize);
+	for (;; --Capacity)
+	{
+		assert(Capacity > 0 && "Components too large for a chunk");
+
+		size_t Offset = sizeof(Entity) * Capacity;
+		Type->Offsets.clear();
+		for (uint32_t Id : Type->ComponentIds)
+		{
+			const size_t Alignment = ComponentTypes[Id].Alignment;
+			Offset = (Offset + Alignment - 1) / Alignment * Alignment;
+			Type->Offsets.push_back(static_cast<uint32_t>(Offset));
+			Offset += static_cast<size_t>(ComponentTypes[Id].Size) * Capacity;
+		}
+
+		if (Offset <= ChunkSize)
+		{
+			break;
+		}
+	}
+	Type->Capacity = Capacity;
+
+	Archetype& Created = *Type;
+	ArchetypesByMask.emplace(Mask, Type.get());
+	Archetypes.push_back(std::move(Type));
+	return Created;
+}
+
+EntityWorld::Archetype* EntityWorld::GetAddEdge(Archetype& Source, uint32_t ComponentId)
+{
+	Archetype*& Edge = Source.AddEdges[ComponentId];
+	if (Edge == nullptr)
+	{
+		Edge = &FindArchetype(Source.Mask | (ComponentMask{ 1 } << ComponentId));
+	}
+	return Edge;
+}
+
+EntityWorld::Archetype* EntityWorld::GetRemoveEdge(Archetype& Source, uint32_t ComponentId)
+{
+	Archetype*& Edge = Source.RemoveEdges[ComponentId];
+	if (Edge == nullptr)
+	{
+		Edge = &FindArchetype(Source.Mask & ~(ComponentMask{ 1 } << ComponentId));
+	}
+	return Edge;
+}
+
+Entity EntityWorld::AllocateEntity()
+{
+	++NumEntities;
+
+	if (!FreeIndexes.empty())
+	{
+		const uint32_t Index = FreeIndexes.back();
+		FreeIndexes.pop_back();
+		return Entity{ Index, Records[Index].Generation };
+	}
+
+	const uint32_t Index = static_cast<uint32_t>(Records.size());
+	Records.push_back(Record{ nullptr, 0, 1 });
+	return Entity{ Index, 1 };
+}
+
+uint32_t EntityWorld::AllocateRow(Archetype& Type, Entity Owner)
+{
+	const uint32_t Row = Type.NumRows++;
+	if (Row / Type.Capacity == Type.Chunks.size())
+	{
+		Type.Chunks.emplace_back(new Chunk());
+	}
+
+	Type.GetEntities(Row / Type.Capacity)[Row % Type.Capacity] = Owner;
+	return Row;
+}
+
+void EntityWorld::RemoveRow(Archetype& Type, uint32_t Row)
+{
+	const uint32_t LastRow = --Type.NumRows;
+	if (Row != LastRow)
+	{
+		const Entity Moved = Type.GetEntities(LastRow / Type.Capacity)[LastRow % Type.Capacity];
+		Type.GetEntities(Row / Type.Capacity)[Row % Type.Capacity] = Moved;
+		for (uint32_t Column = 0; Column < Type.ComponentIds.size(); ++Column)
+		{
+			std::memcpy(Type.GetCell(Column, Row), Type.GetCell(Column, LastRow), Type.Sizes[Column]);
+		}
+		Records[Moved.Index].Row = Row;
+	}
+
+	//Keep one empty chunk so an entity moving back and forth does not allocate every time
+	if (Type.Chunks.size() > 1 && Type.NumRows <= (Type.Chunks.size() - 2) * Type.Capacity)
+	{
+		Type.Chunks.pop_back();
+	}
+}
+
+void EntityWorld::Move(Entity Target, Archetype* Destination)
+{
+	Record& Location = Records[Target.Index];
+	Archetype& Source = *Location.Type;
+
+	const uint32_t NewRow = AllocateRow(*Destination, Target);
+	for (uint32_t Column = 0; Column < Source.ComponentIds.size(); ++Column)
+	{
+		const int8_t DestinationColumn = Destination->Columns[Source.ComponentIds[Column]];
+		if (DestinationColumn >= 0)
+		{
+			std::memcpy(Destination->GetCell(static_cast<uint32_t>(DestinationColumn), NewRow), Source.GetCell(Column, Location.Row), Source.Sizes[Column]);
+		}
+	}
+
+	RemoveRow(Source, Location.Row);
+	Location.Type = Destination;
+	Location.Row = NewRow;
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "JobSystem.h"
+#include "ResourceHandle.h"
+
+// Entities and their components, stored by archetype.
+// An archetype is one set of component types. Its entities live in fixed
+// size chunks. Each chunk holds an array per component type (structure of
+// arrays), so a system reading two components streams through two dense
+// arrays and never loads the components it does not use.
+//
+// Rows stay packed: destroying an entity, or moving it to another archetype
+// when a component is added or removed, fills the hole with the last row of
+// the archetype. The archetype reached by adding or removing each
+// component is cached, so moving only copies the components.
+//
+// Components must be trivially copyable, they are moved with memcpy.
+// An entity is a generational handle to its record: a destroyed entity goes
+// stale instead of pointing at whatever reuses its slot.
+//
+// Not thread safe. Iterations may run their bodies in parallel, but no entity
+// or component may be created or removed while one is running. Systems that
+// touch different components can overlap as tasks of a FrameGraph.
+struct EntityTag;
+
+using Entity = ResourceHandle<EntityTag>;
+
+class EntityWorld
+{
+public:
+
+	static constexpr size_t ChunkSize = 16 * 1024;
+	static constexpr uint32_t MaxComponentTypes = 64;
+
+	using ComponentMask = uint64_t;
+
+	EntityWorld() = default;
+	~EntityWorld() = default;
+
+	EntityWorld(const EntityWorld&) = delete;
+	EntityWorld& operator=(const EntityWorld&) = delete;
+
+	template <typename... Components>
+	Entity Create(const Components&... Values)
+	{
+		Archetype& Type = FindArchetype(GetMask<Components...>());
+		const Entity NewEntity = AllocateEntity();
+		const uint32_t Row = AllocateRow(Type, NewEntity);
+		Records[NewEntity.Index] = Record{ &Type, Row, NewEntity.Generation };
+
+		//Comma fold of C++11: one store per component
+		const int Stores[] = { 0, (Store(Type, Row, Values), 0)... };
+		(void)Stores;
+
+		return NewEntity;
+	}
+
+	// Stale and null entities are ignored
+	void Destroy(Entity Target);
+
+	bool IsAlive(Entity Target) const
+	{
+		return Target.Index < Records.size() && Records[Target.Index].Generation == Target.Generation && Target.Generation != 0;
+	}
+
+	template <typename Component>
+	bool Has(Entity Target) const
+	{
+		assert(IsAlive(Target));
+		return (Records[Target.Index].Type->Mask & GetBit<Component>()) != 0;
+	}
+
+	// The entity must have the component
+	template <typename Component>
+	Component& Get(Entity Target)
+	{
+		assert(IsAlive(Target) && Has<Component>(Target));
+		const Record& Location = Records[Target.Index];
+		return *GetColumn<Component>(*Location.Type, Location.Row);
+	}
+
+	// Add the component, or overwrite it when the entity has it already
+	template <typename Component>
+	void Add(Entity Target, const Component& Value)
+	{
+		assert(IsAlive(Target));
+		const uint32_t Id = GetComponentId<Component>();
+		if (!Has<Component>(Target))
+		{
+			Move(Target, GetAddEdge(*Records[Target.Index].Type, Id));
+		}
+		const Record& Location = Records[Target.Index];
+		Store(*Location.Type, Location.Row, Value);
+	}
+
+	template <typename Component>
+	void Remove(Entity Target)
+	{
+		assert(IsAlive(Target));
+		if (Has<Component>(Target))
+		{
+			Move(Target, GetRemoveEdge(*Records[Target.Index].Type, GetComponentId<Component>()));
+		}
+	}
+
+	// Body(Count, Components*...) for every chunk of the archetypes having all
+	// the components, with the arrays of the chunk
+	template <typename... Components, typename Function>
+	void ForEachChunk(Function&& Body)
+	{
+		const ComponentMask Required = GetMask<Components...>();
+		for (const std::unique_ptr<Archetype>& Type : Archetypes)
+		{
+			if ((Type->Mask & Required) != Required)
+			{
+				continue;
+			}
+
+			for (uint32_t ChunkIndex = 0; ChunkIndex < Type->Chunks.size(); ++ChunkIndex)
+			{
+				CallChunk<Components...>(*Type, ChunkIndex, Body);
+			}
+		}
+	}
+
+	// Body(Components&...) for every entity having all the components
+	template <typename... Components, typename Function>
+	void ForEach(Function&& Body)
+	{
+		ForEachChunk<Components...>([&Body](uint32_t Count, Components*... Arrays)
+		{
+			for (uint32_t Row = 0; Row < Count; ++Row)
+			{
+				Body(Arrays[Row]...);
+			}
+		});
+	}
+
+	// Same as ForEach with the chunks spread over the job system, returns once
+	// every entity was visited. Body runs concurrently and must only write
+	// the components it is given
+	template <typename... Components, typename Function>
+	void ParallelForEach(const Function& Body)
+	{
+		const ComponentMask Required = GetMask<Components...>();
+
+		//Owned by the call, systems may iterate from several threads at once
+		std::vector<ChunkRef> Matching;
+		for (const std::unique_ptr<Archetype>& Type : Archetypes)
+		{
+			if ((Type->Mask & Required) != Required)
+			{
+				continue;
+			}
+
+			for (uint32_t ChunkIndex = 0; ChunkIndex < Type->Chunks.size(); ++ChunkIndex)
+			{
+				Matching.push_back(ChunkRef{ Type.get(), ChunkIndex });
+			}
+		}
+
+		JobSystem::ParallelFor(0, static_cast<int64_t>(Matching.size()), 0, [&Matching, &Body](int64_t Begin, int64_t End)
+		{
+			for (int64_t Index = Begin; Index < End; ++Index)
+			{
+				CallChunk<Components...>(*Matching[Index].Type, Matching[Index].ChunkIndex, [&Body](uint32_t Count, Components*... Arrays)
+				{
+					for (uint32_t Row = 0; Row < Count; ++Row)
+					{
+						Body(Arrays[Row]...);
+					}
+				});
+			}
+		});
+	}
+
+	uint32_t GetNumEntities() const { return NumEntities; }
+	uint32_t GetNumArchetypes() const { return static_cast<uint32_t>(Archetypes.size()); }
+	uint32_t GetNumChunks() const;
+
+	// One line with the entities, archetypes and chunks, for reports
+	void FormatSummary(char* Text, size_t TextSize) const;
+
+	// Same id in every world, given out on first use
+	template <typename Component>
+	static uint32_t GetComponentId()
+	{
+		static_assert(std::is_trivially_copyable<Component>::value, "Components are moved with memcpy");
+		static const uint32_t Id = RegisterComponentType(sizeof(Component), alignof(Component));
+		return Id;
+	}
+
+private:
+
+	struct alignas(64) Chunk
+	{
+		unsigned char Bytes[ChunkSize];
+	};
+
+	struct Archetype
+	{
+		ComponentMask Mask = 0;
+
+		// Column of every component id, -1 when absent
+		std::array<int8_t, MaxComponentTypes> Columns;
+
+		// Per column, in order of the component ids
+		std::vector<uint32_t> ComponentIds;
+		std::vector<uint32_t> Sizes;
+		std::vector<uint32_t> Offsets;
+
+		// The entity of every row comes first in a chunk
+		uint32_t Capacity = 0;
+		uint32_t NumRows = 0;
+		std::vector<std::unique_ptr<Chunk>> Chunks;
+
+		// Archetype reached by adding or removing a component id
+		std::unordered_map<uint32_t, Archetype*> AddEdges;
+		std::unordered_map<uint32_t, Archetype*> RemoveEdges;
+
+		Entity* GetEntities(uint32_t ChunkIndex) const { return reinterpret_cast<Entity*>(Chunks[ChunkIndex]->Bytes); }
+		// Rows of the chunk, the spare chunk kept after the last row has none
+		uint32_t GetChunkCount(uint32_t ChunkIndex) const
+		{
+			const uint32_t FirstRow = ChunkIndex * Capacity;
+			return NumRows <= FirstRow ? 0 : NumRows - FirstRow < Capacity ? NumRows - FirstRow : Capacity;
+		}
+		void* GetCell(uint32_t Column, uint32_t Row) const
+		{
+			return Chunks[Row / Capacity]->Bytes + Offsets[Column] + static_cast<size_t>(Row % Capacity) * Sizes[Column];
+		}
+	};
+
+	struct Record
+	{
+		Archetype* Type = nullptr;
+		uint32_t Row = 0;
+		uint32_t Generation = 0;
+	};
+
+	struct ChunkRef
+	{
+		Archetype* Type;
+		uint32_t ChunkIndex;
+	};
+
+	struct ComponentType
+	{
+		uint32_t Size = 0;
+		uint32_t Alignment = 0;
+	};
+
+	static uint32_t RegisterComponentType(size_t Size, size_t Alignment);
+
+	template <typename Component>
+	static ComponentMask GetBit()
+	{
+		return ComponentMask{ 1 } << GetComponentId<Component>();
+	}
+
+	template <typename... Components>
+	static ComponentMask GetMask()
+	{
+		ComponentMask Mask = 0;
+		const ComponentMask Bits[] = { 0, GetBit<Components>()... };
+		for (ComponentMask Bit : Bits)
+		{
+			Mask |= Bit;
+		}
+		return Mask;
+	}
+
+	template <typename Component>
+	static Component* GetColumn(const Archetype& Type, uint32_t Row)
+	{
+		const int8_t Column = Type.Columns[GetComponentId<Component>()];
+		assert(Column >= 0);
+		return static_cast<Component*>(Type.GetCell(static_cast<uint32_t>(Column), Row));
+	}
+
+	template <typename Component>
+	static void Store(const Archetype& Type, uint32_t Row, const Component& Value)
+	{
+		std::memcpy(static_cast<void*>(GetColumn<Component>(Type, Row)), &Value, sizeof(Component));
+	}
+
+	template <typename... Components, typename Function>
+	static void CallChunk(const Archetype& Type, uint32_t ChunkIndex, Function&& Body)
+	{
+		unsigned char* Bytes = Type.Chunks[ChunkIndex]->Bytes;
+		Body(Type.GetChunkCount(ChunkIndex),
+			reinterpret_cast<Components*>(Bytes + Type.Offsets[Type.Columns[GetComponentId<Components>()]])...);
+	}
+
+	Archetype& FindArchetype(ComponentMask Mask);
+	Archetype* GetAddEdge(Archetype& Source, uint32_t ComponentId);
+	Archetype* GetRemoveEdge(Archetype& Source, uint32_t ComponentId);
+
+	Entity AllocateEntity();
+
+	// Append a row for the entity, its components are left uninitialized
+	uint32_t AllocateRow(Archetype& Type, Entity Owner);
+
+	// Fill the row with the last one of the archetype
+	void RemoveRow(Archetype& Type, uint32_t Row);
+
+	// Copy the shared components to the other archetype
+	void Move(Entity Target, Archetype* Destination);
+
+	static std::array<ComponentType, MaxComponentTypes> ComponentTypes;
+	static std::atomic<uint32_t> NumComponentTypes;
+
+	std::vector<std::unique_ptr<Archetype>> Archetypes;
+	std::unordered_map<ComponentMask, Archetype*> ArchetypesByMask;
+
+	std::vector<Record> Records;
+	std::vector<uint32_t> FreeIndexes;
+	uint32_t NumEntities = 0;
+};
@@ -0,0 +1,93 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+FrameArena::FrameArena(size_t Capacity)
+	: Memory(new unsigned char[Capacity])
+	, Capacity(Capacity)
+{
+	OverflowBlocks.reserve(64);
+}
+
+FrameArena::~FrameArena()
+{
+	Reset();
+}
+
+void* FrameArena::Allocate(size_t Size, size_t Alignment)
+{
+	assert(Alignment > 0 && (Alignment & (Alignment - 1)) == 0);
+
+	const uintptr_t Base = reinterpret_cast<uintptr_t>(Memory.get());
+	const uintptr_t Aligned = (Base + Offset + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1);
+	const size_t NewOffset = Aligned - Base + Size;
+
+	if (NewOffset <= Capacity)
+	{
+		Offset = NewOffset;
+		HighWaterMark = std::max(HighWaterMark, Offset + OverflowBytes);
+		return reinterpret_cast<void*>(Aligned);
+	}
+
+	//Out of space: keep going from the heap, the block is freed with the arena
+	if (NumOverflows == 0)
+	{
+		std::cout << "Frame arena of " << Capacity << " bytes overflowed, falling back to the heap" << std::endl;
+	}
+	++NumOverflows;
+
+	void* Block = std::malloc(Size + Alignment);
+	if (Block == nullptr)
+	{
+		return nullptr;
+	}
+	OverflowBlocks.push_back(Block);
+	OverflowBytes += Size;
+	HighWaterMark = std::max(HighWaterMark, Offset + OverflowBytes);
+
+	const uintptr_t BlockAligned = (reinterpret_cast<uintptr_t>(Block) + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1);
+	return reinterpret_cast<void*>(BlockAligned);
+}
+
+const char* FrameArena::Format(const char* Text, ...)
+{
+	va_list Arguments;
+
+	va_start(Arguments, Text);
+	const int Length = std::vsnprintf(nullptr, 0, Text, Arguments);
+	va_end(Arguments);
+
+	if (Length < 0)
+	{
+		return "";
+	}
+
+	char* Result = AllocateArray<char>(Length + 1);
+	if (Result == nullptr)
+	{
+		return "";
+	}
+
+	va_start(Arguments, Text);
+	std::vsnprintf(Result, Length + 1, Text, Arguments);
+	va_end(Arguments);
+
+	return Result;
+}
+
+void FrameArena::Reset()
+{
+	for (void* Block : OverflowBlocks)
+	{
+		std::free(Block);
+	}
+	OverflowBlocks.clear();
+
+	Offset = 0;
+	OverflowBytes = 0;
+}
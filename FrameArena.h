@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Linear allocator for data that lives for one frame.
+// Allocations bump an offset into a block reserved up front and are all
+// released at once by Reset(), individual frees do nothing. When the block
+// is exhausted allocations fall back to the heap and are counted as
+// overflows, the capacity should then be raised so the steady state frame
+// stays allocation free. The high water mark tells how much is really used.
+//
+// Not thread safe: an arena is filled by a single thread. Data handed to
+// another thread must stay alive until that thread is done with it, see
+// the double buffering in main.cpp.
+class FrameArena
+{
+public:
+
+	explicit FrameArena(size_t Capacity = 256 * 1024);
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void* Allocate(size_t Size, size_t Alignment = alignof(std::max_align_t));
+
+	template <typename Type>
+	Type* AllocateArray(size_t Count)
+	{
+		return static_cast<Type*>(Allocate(Count * sizeof(Type), alignof(Type)));
+	}
+
+	// printf into arena memory, the string is valid until the next Reset()
+	const char* Format(const char* Text, ...);
+
+	// Release every allocation, including the overflow blocks
+	void Reset();
+
+	size_t GetCapacity() const { return Capacity; }
+	size_t GetUsed() const { return Offset; }
+
+	// Largest amount used by a frame since construction, overflows included
+	size_t GetHighWaterMark() const { return HighWaterMark; }
+
+	// Allocations that did not fit since construction
+	uint64_t GetNumOverflows() const { return NumOverflows; }
+
+private:
+
+	std::unique_ptr<unsigned char[]> Memory;
+	size_t Capacity = 0;
+	size_t Offset = 0;
+
+	// Bytes taken from the heap this frame
+	size_t OverflowBytes = 0;
+	std::vector<void*> OverflowBlocks;
+
+	size_t HighWaterMark = 0;
+	uint64_t NumOverflows = 0;
+};
+
+// Standard allocator adaptor, so scratch containers can live in a FrameArena:
+//     std::vector<int, ArenaAllocator<int>> Visible{ ArenaAllocator<int>{ Arena } };
+// Memory is only given back on Reset(), reserve() avoids wasting the blocks
+// left behind when a vector grows.
+template <typename Type>
+class ArenaAllocator
+{
+public:
+
+	using value_type = Type;
+
+	explicit ArenaAllocator(FrameArena& InArena)
+		: Arena(&InArena)
+	{
+	}
+
+	template <typename OtherType>
+	ArenaAllocator(const ArenaAllocator<OtherType>& Other)
+		: Arena(Other.GetArena())
+	{
+	}
+
+	Type* allocate(size_t Count)
+	{
+		return Arena->AllocateArray<Type>(Count);
+	}
+
+	void deallocate(Type*, size_t)
+	{
+	}
+
+	FrameArena* GetArena() const { return Arena; }
+
+private:
+
+	FrameArena* Arena;
+};
+
+template <typename A, typename B>
+bool operator==(const ArenaAllocator<A>& Left, const ArenaAllocator<B>& Right)
+{
+	return Left.GetArena() == Right.GetArena();
+}
+
+template <typename A, typename B>
+bool operator!=(const ArenaAllocator<A>& Left, const ArenaAllocator<B>& Right)
+{
+	return !(Left == Right);
+}
+
+template <typename Type>
+using FrameVector = std::vector<Type, ArenaAllocator<Type>>;
@@ -0,0 +1,256 @@
+#include "FrameGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+
+#include "CpuProfiler.h"
+#include "Log.h"
+
+FrameGraph::FrameGraph(double ReportInterval)
+	: ReportInterval(ReportInterval)
+{
+}
+
+FrameGraph::ResourceId FrameGraph::AddResource(const char* Name)
+{
+	assert(!bCompiled);
+	Resources.push_back(Name);
+	return static_cast<ResourceId>(Resources.size() - 1);
+}
+
+FrameGraph::TaskId FrameGraph::AddTask(const char* Name, std::initializer_list<ResourceId> Reads,
+	std::initializer_list<ResourceId> Writes, std::function<void()> Body)
+{
+	assert(!bCompiled);
+
+	Task NewTask;
+	NewTask.Name = Name;
+	NewTask.Body = std::move(Body);
+	NewTask.Reads = Reads;
+	NewTask.Writes = Writes;
+	Tasks.push_back(std::move(NewTask));
+	return static_cast<TaskId>(Tasks.size() - 1);
+}
+
+void FrameGraph::AddDependency(TaskId From, TaskId To, ResourceId Resource)
+{
+	if (From == To)
+	{
+		return;
+	}
+
+	std::vector<TaskId>& Successors = Tasks[From].Successors;
+	if (std::find(Successors.begin(), Successors.end(), To) != Successors.end())
+	{
+		return;
+	}
+
+	Successors.push_back(To);
+	Tasks[To].Predecessors.push_back(From);
+	LOG_DEBUG("Frame graph: %s -> %s (%s)", Tasks[From].Name, Tasks[To].Name, Resources[Resource]);
+}
+
+void FrameGraph::Compile()
+{
+	assert(!bCompiled);
+
+	//Replay the tasks in the order they were added, like the serial loop they replace
+	std::vector<TaskId> LastWriter(Resources.size(), -1);
+	std::vector<std::vector<TaskId>> Readers(Resources.size());
+
+	for (TaskId Index = 0; Index < static_cast<TaskId>(Tasks.size()); ++Index)
+	{
+		for (ResourceId Resource : Tasks[Index].Reads)
+		{
+			assert(Resource >= 0 && Resource < static_cast<ResourceId>(Resources.size()));
+			if (LastWriter[Resource] >= 0)
+			{
+				AddDependency(LastWriter[Resource], Index, Resource);
+			}
+			Readers[Resource].push_back(Index);
+		}
+
+		for (ResourceId Resource : Tasks[Index].Writes)
+		{
+			assert(Resource >= 0 && Resource < static_cast<ResourceId>(Resources.size()));
+			if (LastWriter[Resource] >= 0)
+			{
+				AddDependency(LastWriter[Resource], Index, Resource);
+			}
+
+			//Whoever read the previous value must be done before it is overwritten
+			for (TaskId Reader : Readers[Resource])
+			{
+				AddDependency(Reader, Index, Resource);
+			}
+			Readers[Resource].clear();
+			LastWriter[Resource] = Index;
+		}
+
+		if (Tasks[Index].Predecessors.empty())
+		{
+			Roots.push_back(Index);
+		}
+	}
+
+	Remaining.reset(new std::atomic<int>[Tasks.size()]);
+	FrameDurations.assign(Tasks.size(), 0.0);
+	AverageDurations.assign(Tasks.size(), 0.0);
+	PathFinish.assign(Tasks.size(), 0.0);
+	PathPrevious.assign(Tasks.size(), -1);
+	CriticalPath.reserve(Tasks.size());
+	bCompiled = true;
+}
+
+void FrameGraph::Execute()
+{
+	assert(bCompiled);
+	PROFILE_SCOPE("FrameGraph");
+
+	for (size_t Index = 0; Index < Tasks.size(); ++Index)
+	{
+		Remaining[Index].store(static_cast<int>(Tasks[Index].Predecessors.size()), std::memory_order_relaxed);
+	}
+
+	const uint64_t FrameBegin = CpuProfiler::Now();
+
+	JobSystem::Counter Done;
+	FrameDone = &Done;
+
+	for (TaskId Root : Roots)
+	{
+		Launch(Root);
+	}
+	JobSystem::Wait(Done);
+
+	FrameDone = nullptr;
+	const uint64_t FrameEnd = CpuProfiler::Now();
+
+	//Every task has finished, its timestamps are visible through the counter
+	double WorkMs = 0.0;
+	for (size_t Index = 0; Index < Tasks.size(); ++Index)
+	{
+		FrameDurations[Index] = (Tasks[Index].End - Tasks[Index].Begin) * 1e-6;
+		Tasks[Index].TotalMs += FrameDurations[Index];
+		WorkMs += FrameDurations[Index];
+	}
+
+	++WindowFrames;
+	WindowWallMs += (FrameEnd - FrameBegin) * 1e-6;
+	WindowWorkMs += WorkMs;
+	WindowCriticalMs += FindCriticalPath(FrameDurations, nullptr);
+}
+
+void FrameGraph::Launch(TaskId Index)
+{
+	JobSystem::Run([this, Index]()
+	{
+		RunTask(Index);
+	}, FrameDone);
+}
+
+void FrameGraph::RunTask(TaskId Index)
+{
+	Task& Current = Tasks[Index];
+
+	{
+		PROFILE_SCOPE(Current.Name);
+		Current.Begin = CpuProfiler::Now();
+		Current.Body();
+		Current.End = CpuProfiler::Now();
+	}
+
+	//The last predecessor to finish launches the successor
+	for (TaskId Successor : Current.Successors)
+	{
+		if (Remaining[Successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			Launch(Successor);
+		}
+	}
+}
+
+double FrameGraph::FindCriticalPath(const std::vector<double>& Durations, std::vector<TaskId>* Path)
+{
+	//Tasks only depend on tasks added before them, so the order is topological
+	std::vector<double>& Finish = PathFinish;
+	std::vector<TaskId>& Previous = PathPrevious;
+	TaskId Last = -1;
+
+	for (TaskId Index = 0; Index < static_cast<TaskId>(Tasks.size()); ++Index)
+	{
+		double Start = 0.0;
+		Previous[Index] = -1;
+		for (TaskId Predecessor : Tasks[Index].Predecessors)
+		{
+			if (Finish[Predecessor] > Start)
+			{
+				Start = Finish[Predecessor];
+				Previous[Index] = Predecessor;
+			}
+		}
+
+		Finish[Index] = Start + Durations[Index];
+		if (Last < 0 || Finish[Index] > Finish[Last])
+		{
+			Last = Index;
+		}
+	}
+
+	if (Path != nullptr)
+	{
+		Path->clear();
+		for (TaskId Index = Last; Index >= 0; Index = Previous[Index])
+		{
+			Path->push_back(Index);
+		}
+		std::reverse(Path->begin(), Path->end());
+	}
+
+	return Last >= 0 ? Finish[Last] : 0.0;
+}
+
+void FrameGraph::ReportIfDue(double Now)
+{
+	if (LastReport < 0.0)
+	{
+		LastReport = Now;
+		return;
+	}
+
+	if (Now - LastReport < ReportInterval || WindowFrames == 0)
+	{
+		return;
+	}
+
+	for (size_t Index = 0; Index < Tasks.size(); ++Index)
+	{
+		AverageDurations[Index] = Tasks[Index].TotalMs / WindowFrames;
+		Tasks[Index].TotalMs = 0.0;
+	}
+
+	FindCriticalPath(AverageDurations, &CriticalPath);
+
+	const double CriticalMs = WindowCriticalMs / WindowFrames;
+	std::cout << std::fixed << std::setprecision(3)
+		<< "Frame graph: wall " << WindowWallMs / WindowFrames << " ms"
+		<< " work " << WindowWorkMs / WindowFrames << " ms"
+		<< " critical path " << CriticalMs << " ms"
+		<< " parallelism " << std::setprecision(2) << WindowWorkMs / WindowFrames / std::max(CriticalMs, 1e-6) << "x:";
+
+	std::cout << std::setprecision(3);
+	for (size_t Step = 0; Step < CriticalPath.size(); ++Step)
+	{
+		const TaskId Index = CriticalPath[Step];
+		std::cout << (Step == 0 ? " " : " > ") << Tasks[Index].Name << " " << AverageDurations[Index];
+	}
+	std::cout << std::endl;
+
+	WindowFrames = 0;
+	WindowWallMs = 0.0;
+	WindowWorkMs = 0.0;
+	WindowCriticalMs = 0.0;
+	LastReport = Now;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include "JobSystem.h"
+
+// Graph of the CPU tasks of a frame.
+// Tasks declare the resources they read and write, the dependencies are
+// derived from the order the tasks were added: a task runs after the last
+// writer of what it reads, and after the readers and the last writer of
+// what it writes. The graph is built once, then Execute() runs every task
+// on the job system each frame as soon as its predecessors are done, so
+// independent tasks overlap without the frame loop spelling out an order.
+//
+// Every task is timed, ReportIfDue() prints the average frame wall time,
+// the total work, the critical path (the longest chain of dependent tasks,
+// the wall time with unlimited threads) and the tasks on it.
+class FrameGraph
+{
+public:
+
+	using ResourceId = int;
+	using TaskId = int;
+
+	explicit FrameGraph(double ReportInterval = 2.0);
+
+	// Name must have static storage (a literal)
+	ResourceId AddResource(const char* Name);
+
+	TaskId AddTask(const char* Name, std::initializer_list<ResourceId> Reads, std::initializer_list<ResourceId> Writes,
+		std::function<void()> Body);
+
+	// Derive the dependencies, no task can be added afterwards
+	void Compile();
+
+	// Run every task once and return when all are done
+	void Execute();
+
+	// Print the statistics once every ReportInterval seconds, Now as returned by glfwGetTime()
+	void ReportIfDue(double Now);
+
+private:
+
+	struct Task
+	{
+		const char* Name = nullptr;
+		std::function<void()> Body;
+		std::vector<ResourceId> Reads;
+		std::vector<ResourceId> Writes;
+		std::vector<TaskId> Predecessors;
+		std::vector<TaskId> Successors;
+
+		// Last frame, nanoseconds of CpuProfiler::Now()
+		uint64_t Begin = 0;
+		uint64_t End = 0;
+
+		// Sum over the report window
+		double TotalMs = 0.0;
+	};
+
+	void AddDependency(TaskId From, TaskId To, ResourceId Resource);
+	void Launch(TaskId Index);
+	void RunTask(TaskId Index);
+
+	// Longest chain of tasks for the given durations, returns its length
+	double FindCriticalPath(const std::vector<double>& Durations, std::vector<TaskId>* Path);
+
+	std::vector<const char*> Resources;
+	std::vector<Task> Tasks;
+	std::vector<TaskId> Roots;
+	bool bCompiled = false;
+
+	// Predecessors still running this frame, per task
+	std::unique_ptr<std::atomic<int>[]> Remaining;
+
+	// Counts the tasks of the frame being executed
+	JobSystem::Counter* FrameDone = nullptr;
+
+	// Scratch arrays sized once, the frame loop does not allocate
+	std::vector<double> FrameDurations;
+	std::vector<double> AverageDurations;
+	std::vector<double> PathFinish;
+	std::vector<TaskId> PathPrevious;
+	std::vector<TaskId> CriticalPath;
+
+	double ReportInterval;
+	double LastReport = -1.0;
+	int WindowFrames = 0;
+	double WindowWallMs = 0.0;
+	double WindowWorkMs = 0.0;
+	double WindowCriticalMs = 0.0;
+};
@@ -0,0 +1,172 @@
+#include "FramePacer.h"
+#include "GLTrace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+
+#include <GLFW/glfw3.h>
+
+namespace
+{
+	// Weight of the newest sample in the render time prediction
+	constexpr double PredictionWeight = 0.1;
+
+	// One second, glClientWaitSync takes nanoseconds
+	constexpr GLuint64 BlockingTimeout = 1000000000ull;
+}
+
+FramePacer::FramePacer(const Settings& InSettings)
+	: PacerSettings(InSettings)
+{
+	PacerSettings.MaxFramesInFlight = std::min(std::max(PacerSettings.MaxFramesInFlight, 1), MaxSupportedFramesInFlight);
+
+	//Must be called from the thread owning the context
+	glfwSwapInterval(PacerSettings.SwapInterval);
+}
+
+FramePacer::~FramePacer()
+{
+	for (int Index = 0; Index < NumInFlight; ++Index)
+	{
+		glDeleteSync(Frames[(OldestFrame + Index) % MaxSupportedFramesInFlight].Fence);
+	}
+}
+
+void FramePacer::SetRefreshRate(double RefreshRate)
+{
+	if (RefreshRate > 0.0)
+	{
+		RefreshInterval = 1.0 / RefreshRate;
+	}
+}
+
+void FramePacer::WaitForFrameSlot()
+{
+	if (NumInFlight >= PacerSettings.MaxFramesInFlight)
+	{
+		++NumSlotWaits;
+	}
+
+	RetireFrames(BlockingTimeout, PacerSettings.MaxFramesInFlight - 1);
+}
+
+void FramePacer::BeginSubmit(double Now)
+{
+	CurrentSubmitBegin = Now;
+}
+
+void FramePacer::EndFrame(double Now, double InputSampleTime)
+{
+	LastSwapEnd = Now;
+
+	//Retire anything the GPU already finished so latencies are measured close to completion
+	RetireFrames(0, 0);
+
+	assert(NumInFlight < MaxSupportedFramesInFlight);
+
+	InFlightFrame& Frame = Frames[(OldestFrame + NumInFlight) % MaxSupportedFramesInFlight];
+	Frame.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	Frame.SubmitBegin = CurrentSubmitBegin;
+	Frame.InputSampleTime = InputSampleTime;
+	++NumInFlight;
+}
+
+double FramePacer::GetNextRenderStart(double Now) const
+{
+	if (!PacerSettings.bJustInTime || PacerSettings.SwapInterval <= 0)
+	{
+		return 0.0;
+	}
+
+	// With a bounded queue the swap returns close to a vblank, use it as the vsync phase
+	const double Interval = RefreshInterval * PacerSettings.SwapInterval;
+	const double Lead = PredictedRenderTime + PacerSettings.SafetyMargin;
+
+	double NextVsync = LastSwapEnd + Interval;
+	if (NextVsync - Lead < Now)
+	{
+		NextVsync += std::ceil((Now + Lead - NextVsync) / Interval) * Interval;
+	}
+
+	return NextVsync - Lead;
+}
+
+void FramePacer::ReportIfDue(double Now)
+{
+	if (LastReport < 0.0)
+	{
+		LastReport = Now;
+		return;
+	}
+
+	if (Now - LastReport < 1.0)
+	{
+		return;
+	}
+
+	if (NumLatencySamples > 0)
+	{
+		std::cout << std::fixed << std::setprecision(2)
+			<< "Input to present: avg " << 1000.0 * LatencySum / NumLatencySamples << " ms"
+			<< " min " << 1000.0 * LatencyMin << " ms"
+			<< " max " << 1000.0 * LatencyMax << " ms"
+			<< " | Render: " << 1000.0 * PredictedRenderTime << " ms"
+			<< " | Frames in flight: " << PacerSettings.MaxFramesInFlight
+			<< " (" << NumSlotWaits << " waits)"
+			<< std::endl;
+	}
+
+	NumLatencySamples = 0;
+	LatencySum = 0.0;
+	NumSlotWaits = 0;
+	LastReport = Now;
+}
+
+void FramePacer::RetireFrames(GLuint64 Timeout, int KeepInFlight)
+{
+	while (NumInFlight > KeepInFlight)
+	{
+		const GLenum Result = glClientWaitSync(Frames[OldestFrame].Fence, GL_SYNC_FLUSH_COMMANDS_BIT, Timeout);
+
+		if (Result == GL_TIMEOUT_EXPIRED)
+		{
+			//Non blocking check and the frame is still running
+			if (Timeout == 0)
+			{
+				break;
+			}
+
+			//Keep blocking, the GPU is just slow
+			continue;
+		}
+
+		//Signaled, or the wait failed. Failed fences are retired too so the pacer never deadlocks
+		RetireOldest(glfwGetTime());
+	}
+}
+
+void FramePacer::RetireOldest(double PresentTime)
+{
+	InFlightFrame& Frame = Frames[OldestFrame];
+
+	// GPU completion of a swapped frame is the earliest it can be presented
+	const double Latency = PresentTime - Frame.InputSampleTime;
+	LatencyMin = NumLatencySamples == 0 ? Latency : std::min(LatencyMin, Latency);
+	LatencyMax = NumLatencySamples == 0 ? Latency : std::max(LatencyMax, Latency);
+	LatencySum += Latency;
+	++NumLatencySamples;
+
+	const double RenderTime = std::min(PresentTime - Frame.SubmitBegin, RefreshInterval * std::max(PacerSettings.SwapInterval, 1));
+	PredictedRenderTime = PredictedRenderTime == 0.0
+		? RenderTime
+		: PredictedRenderTime + (RenderTime - PredictedRenderTime) * PredictionWeight;
+
+	glDeleteSync(Frame.Fence);
+	Frame.Fence = nullptr;
+
+	OldestFrame = (OldestFrame + 1) % MaxSupportedFramesInFlight;
+	--NumInFlight;
+}
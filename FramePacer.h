@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+
+#include <GL/glew.h>
+
+// Latency oriented frame pacing for the render thread.
+// A fence is inserted after every swap and submission of a new frame waits
+// until at most MaxFramesInFlight frames are still queued on the GPU, so
+// the driver cannot buffer several frames of input lag. Optionally the
+// pacer predicts when the next frame must start to make the next vsync,
+// letting the simulation thread sample input just in time.
+class FramePacer
+{
+public:
+
+	static constexpr int MaxSupportedFramesInFlight = 4;
+
+	struct Settings
+	{
+		int SwapInterval = 1;
+		int MaxFramesInFlight = 1;
+		bool bJustInTime = false;
+
+		// Slack kept before the predicted vsync, in seconds
+		double SafetyMargin = 0.002;
+	};
+
+	explicit FramePacer(const Settings& InSettings);
+	~FramePacer();
+
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+
+	const Settings& GetSettings() const { return PacerSettings; }
+
+	// Refresh rate of the monitor showing the window, queried by the main thread
+	void SetRefreshRate(double RefreshRate);
+
+	// Block until a new frame may be submitted without exceeding MaxFramesInFlight
+	void WaitForFrameSlot();
+
+	// Mark the start of GL submission for the frame
+	void BeginSubmit(double Now);
+
+	// Insert the fence of the frame right after glfwSwapBuffers
+	void EndFrame(double Now, double InputSampleTime);
+
+	// Time at which the next frame should start rendering to hit the next
+	// vsync, or 0 when just-in-time pacing is disabled
+	double GetNextRenderStart(double Now) const;
+
+	// Print frames in flight and input to present latency once per second
+	void ReportIfDue(double Now);
+
+private:
+
+	struct InFlightFrame
+	{
+		GLsync Fence = nullptr;
+		double SubmitBegin = 0.0;
+		double InputSampleTime = 0.0;
+	};
+
+	// Check the oldest fences, Timeout in nanoseconds
+	void RetireFrames(GLuint64 Timeout, int KeepInFlight);
+	void RetireOldest(double PresentTime);
+
+	Settings PacerSettings;
+	double RefreshInterval = 1.0 / 60.0;
+
+	std::array<InFlightFrame, MaxSupportedFramesInFlight> Frames;
+	int OldestFrame = 0;
+	int NumInFlight = 0;
+
+	double CurrentSubmitBegin = 0.0;
+	double LastSwapEnd = 0.0;
+
+	// Exponential moving average of submit begin until GPU completion
+	double PredictedRenderTime = 0.0;
+
+	// Statistics since the last report
+	double LastReport = -1.0;
+	int NumLatencySamples = 0;
+	double LatencySum = 0.0;
+	double LatencyMin = 0.0;
+	double LatencyMax = 0.0;
+	int NumSlotWaits = 0;
+};
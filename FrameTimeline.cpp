@@ -0,0 +1,103 @@
+#include "FrameTimeline.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+FrameTimeline::FrameTimeline(double ReportInterval)
+	: ReportInterval(ReportInterval)
+{
+	SimulationIntervals.reserve(1024);
+	RenderIntervals.reserve(1024);
+}
+
+void FrameTimeline::AddInterval(Track Which, double Begin, double End)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	if (Which == Track::Simulation)
+	{
+		SimulationIntervals.push_back(Interval{ Begin, End });
+	}
+	else
+	{
+		RenderIntervals.push_back(Interval{ Begin, End });
+	}
+}
+
+void FrameTimeline::ReportIfDue(double Now)
+{
+	if (LastReport < 0.0)
+	{
+		LastReport = Now;
+		return;
+	}
+
+	if (Now - LastReport < ReportInterval)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	const double Elapsed = Now - LastReport;
+	const size_t NumFrames = RenderIntervals.size();
+
+	if (NumFrames > 0)
+	{
+		const double SimulationTime = SumDuration(SimulationIntervals);
+		const double RenderTime = SumDuration(RenderIntervals);
+		const double OverlapTime = SumOverlap(SimulationIntervals, RenderIntervals);
+
+		std::cout << std::fixed << std::setprecision(2)
+			<< "FPS: " << NumFrames / Elapsed
+			<< " Simulation: " << 1000.0 * SimulationTime / std::max<size_t>(SimulationIntervals.size(), 1) << " ms"
+			<< " Render: " << 1000.0 * RenderTime / NumFrames << " ms"
+			<< " Overlap: " << 100.0 * OverlapTime / std::max(RenderTime, 1e-9) << "% of render time"
+			<< std::endl;
+	}
+
+	SimulationIntervals.clear();
+	RenderIntervals.clear();
+	LastReport = Now;
+}
+
+double FrameTimeline::SumDuration(const std::vector<Interval>& Intervals)
+{
+	double Total = 0.0;
+	for (const Interval& Current : Intervals)
+	{
+		Total += Current.End - Current.Begin;
+	}
+	return Total;
+}
+
+double FrameTimeline::SumOverlap(const std::vector<Interval>& A, const std::vector<Interval>& B)
+{
+	//Intervals of each track are appended in time order by a single thread, walk both at once
+	double Total = 0.0;
+	size_t IndexA = 0;
+	size_t IndexB = 0;
+
+	while (IndexA < A.size() && IndexB < B.size())
+	{
+		const double Begin = std::max(A[IndexA].Begin, B[IndexB].Begin);
+		const double End = std::min(A[IndexA].End, B[IndexB].End);
+
+		if (End > Begin)
+		{
+			Total += End - Begin;
+		}
+
+		if (A[IndexA].End < B[IndexB].End)
+		{
+			++IndexA;
+		}
+		else
+		{
+			++IndexB;
+		}
+	}
+
+	return Total;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+// Collects the busy intervals of the simulation and render threads and
+// periodically reports how much of the frame time both ran at once.
+class FrameTimeline
+{
+public:
+
+	enum class Track
+	{
+		Simulation,
+		Render
+	};
+
+	explicit FrameTimeline(double ReportInterval = 1.0);
+
+	// Register a busy interval, in seconds as returned by glfwGetTime()
+	void AddInterval(Track Which, double Begin, double End);
+
+	// Print the statistics once every ReportInterval seconds
+	void ReportIfDue(double Now);
+
+private:
+
+	struct Interval
+	{
+		double Begin;
+		double End;
+	};
+
+	static double SumDuration(const std::vector<Interval>& Intervals);
+	static double SumOverlap(const std::vector<Interval>& A, const std::vector<Interval>& B);
+
+	double ReportInterval;
+	double LastReport = -1.0;
+
+	std::mutex Mutex;
+	std::vector<Interval> SimulationIntervals;
+	std::vector<Interval> RenderIntervals;
+};
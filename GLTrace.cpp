@@ -0,0 +1,326 @@
+#define GLTRACE_IMPLEMENTATION
+#include "GLTrace.h"
+
+#if defined(BLUEPLANET_GL_TRACE) && BLUEPLANET_GL_TRACE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+#include "CpuProfiler.h"
+
+namespace
+{
+	constexpr int NumCalls = static_cast<int>(GLTrace::Call::NumCalls);
+
+	// Nanoseconds between two console reports
+	constexpr uint64_t ReportInterval = 2000000000;
+
+	#define GLTRACE_NAME(Name) "gl" #Name,
+
+	const char* const Names[NumCalls] = {
+		GLTRACE_CORE_FUNCTIONS(GLTRACE_NAME)
+		GLTRACE_EXTENSION_FUNCTIONS(GLTRACE_NAME)
+	};
+
+	#undef GLTRACE_NAME
+
+	struct CallCounters
+	{
+		std::array<uint32_t, NumCalls> Calls{};
+		std::array<uint64_t, NumCalls> Time{};
+		GLTrace::FrameStatistics Totals;
+	};
+
+	CallCounters CurrentFrame;
+	CallCounters ReportWindow;
+	GLTrace::FrameStatistics LastFrame;
+	uint32_t ReportFrames = 0;
+	uint64_t LastReport = 0;
+
+	// Last value set for each piece of tracked state. The key combines the
+	// call with its target (capability, texture unit and target, uniform
+	// location), a missing key means the state is unknown.
+	std::unordered_map<uint64_t, uint64_t> ShadowState;
+	GLuint ActiveTextureUnit = 0;
+	GLuint CurrentProgram = 0;
+
+	std::atomic<bool> bFrameLogRequested{ false };
+	bool bLoggingFrame = false;
+	std::ostringstream FrameLog;
+
+	uint64_t MakeKey(GLTrace::Call Id, uint64_t Target)
+	{
+		return (static_cast<uint64_t>(Id) << 56) | Target;
+	}
+
+	// Store the new value, return true if it was already set
+	bool Update(GLTrace::Call Id, uint64_t Target, uint64_t Value)
+	{
+		auto Result = ShadowState.emplace(MakeKey(Id, Target), Value);
+		if (Result.second)
+		{
+			return false;
+		}
+
+		const bool bRedundant = Result.first->second == Value;
+		Result.first->second = Value;
+		return bRedundant;
+	}
+
+	void Forget(GLTrace::Call Id, uint64_t Target)
+	{
+		ShadowState.erase(MakeKey(Id, Target));
+	}
+
+	uint64_t FloatBits(GLfloat Value)
+	{
+		uint32_t Bits = 0;
+		static_assert(sizeof(Bits) == sizeof(Value), "GLfloat is expected to be 32 bits");
+		std::copy_n(reinterpret_cast<const unsigned char*>(&Value), sizeof(Value), reinterpret_cast<unsigned char*>(&Bits));
+		return Bits;
+	}
+
+	void Report(uint64_t Now)
+	{
+		const double Frames = std::max<uint32_t>(ReportFrames, 1);
+
+		std::cout << std::fixed << std::setprecision(1)
+			<< "GL calls/frame: " << ReportWindow.Totals.NumCalls / Frames
+			<< " draws: " << ReportWindow.Totals.NumDrawCalls / Frames
+			<< " redundant: " << ReportWindow.Totals.NumRedundant / Frames
+			<< std::setprecision(3)
+			<< " driver: " << 1e-6 * ReportWindow.Totals.DriverTime / Frames << " ms";
+
+		//The three most expensive entry points
+		std::array<int, NumCalls> Order;
+		for (int Index = 0; Index < NumCalls; ++Index)
+		{
+			Order[Index] = Index;
+		}
+		std::partial_sort(Order.begin(), Order.begin() + 3, Order.end(), [](int A, int B)
+		{
+			return ReportWindow.Time[A] > ReportWindow.Time[B];
+		});
+
+		int Rank = 0;
+		for (; Rank < 3 && ReportWindow.Calls[Order[Rank]] > 0; ++Rank)
+		{
+			std::cout << (Rank == 0 ? " (" : ", ") << Names[Order[Rank]]
+				<< " x" << std::setprecision(1) << ReportWindow.Calls[Order[Rank]] / Frames
+				<< " " << std::setprecision(3) << 1e-6 * ReportWindow.Time[Order[Rank]] / Frames << " ms";
+		}
+		std::cout << (Rank > 0 ? ")" : "") << std::endl;
+
+		ReportWindow = CallCounters{};
+		ReportFrames = 0;
+		LastReport = Now;
+	}
+}
+
+namespace GLTrace
+{
+	const char* GetName(Call Id)
+	{
+		return Names[static_cast<int>(Id)];
+	}
+
+	FrameStatistics GetLastFrameStatistics()
+	{
+		return LastFrame;
+	}
+
+	void EndFrame()
+	{
+		LastFrame = CurrentFrame.Totals;
+
+		for (int Index = 0; Index < NumCalls; ++Index)
+		{
+			ReportWindow.Calls[Index] += CurrentFrame.Calls[Index];
+			ReportWindow.Time[Index] += CurrentFrame.Time[Index];
+		}
+		ReportWindow.Totals.NumCalls += CurrentFrame.Totals.NumCalls;
+		ReportWindow.Totals.NumRedundant += CurrentFrame.Totals.NumRedundant;
+		ReportWindow.Totals.NumDrawCalls += CurrentFrame.Totals.NumDrawCalls;
+		ReportWindow.Totals.DriverTime += CurrentFrame.Totals.DriverTime;
+		++ReportFrames;
+
+		CurrentFrame = CallCounters{};
+
+		if (bLoggingFrame)
+		{
+			std::ofstream File{ FrameLogFile };
+			File << FrameLog.str();
+			std::cout << "GL frame log written to " << FrameLogFile << " (" << LastFrame.NumCalls << " calls)" << std::endl;
+
+			FrameLog.str(std::string{});
+			bLoggingFrame = false;
+		}
+
+		//Start at a frame boundary so the log holds exactly one frame
+		if (bFrameLogRequested.exchange(false))
+		{
+			bLoggingFrame = true;
+		}
+
+		const uint64_t Now = CpuProfiler::Now();
+		if (LastReport == 0)
+		{
+			LastReport = Now;
+		}
+		else if (Now - LastReport >= ReportInterval)
+		{
+			Report(Now);
+		}
+	}
+
+	void RequestFrameLog()
+	{
+		bFrameLogRequested = true;
+	}
+
+	std::ostream* GetFrameLog()
+	{
+		return bLoggingFrame ? &FrameLog : nullptr;
+	}
+
+	uint64_t BeginCall()
+	{
+		return CpuProfiler::Now();
+	}
+
+	void EndCall(Call Id, bool bRedundant, uint64_t Begin)
+	{
+		const uint64_t Elapsed = CpuProfiler::Now() - Begin;
+		const int Index = static_cast<int>(Id);
+
+		++CurrentFrame.Calls[Index];
+		CurrentFrame.Time[Index] += Elapsed;
+
+		FrameStatistics& Totals = CurrentFrame.Totals;
+		++Totals.NumCalls;
+		Totals.DriverTime += Elapsed;
+		Totals.NumRedundant += bRedundant ? 1 : 0;
+		Totals.NumDrawCalls += Id == Call::DrawArrays || Id == Call::DrawElements ? 1 : 0;
+
+		if (bLoggingFrame)
+		{
+			FrameLog << "  " << std::fixed << std::setprecision(2) << 1e-3 * Elapsed << " us"
+				<< (bRedundant ? "  [redundant]" : "") << '\n';
+		}
+	}
+
+	bool TrackState(Call Id, GLuint Value)
+	{
+		switch (Id)
+		{
+		case Call::UseProgram:
+			CurrentProgram = Value;
+			return Update(Id, 0, Value);
+		case Call::BindVertexArray:
+			//The element array binding is part of the vertex array object
+			Forget(Call::BindBuffer, GL_ELEMENT_ARRAY_BUFFER);
+			return Update(Id, 0, Value);
+		case Call::ActiveTexture:
+			ActiveTextureUnit = Value - GL_TEXTURE0;
+			return Update(Id, 0, Value);
+		case Call::Enable:
+			return Update(Call::Enable, Value, GL_TRUE);
+		case Call::Disable:
+			return Update(Call::Enable, Value, GL_FALSE);
+		case Call::DepthFunc:
+		case Call::CullFace:
+			return Update(Id, 0, Value);
+		case Call::LinkProgram:
+			//Linking resets every uniform of the program to zero
+			for (auto It = ShadowState.begin(); It != ShadowState.end();)
+			{
+				It = (It->first >> 56) == static_cast<uint64_t>(Call::Uniform1i) ? ShadowState.erase(It) : std::next(It);
+			}
+			return false;
+		default:
+			return false;
+		}
+	}
+
+	bool TrackState(Call Id, GLboolean Value)
+	{
+		return Id == Call::DepthMask && Update(Id, 0, Value);
+	}
+
+	bool TrackState(Call Id, GLenum Target, GLuint Value)
+	{
+		switch (Id)
+		{
+		case Call::BindTexture:
+			return Update(Id, (static_cast<uint64_t>(ActiveTextureUnit) << 32) | Target, Value);
+		case Call::BindBuffer:
+			return Update(Id, Target, Value);
+		case Call::BlendFunc:
+			return Update(Id, 0, (static_cast<uint64_t>(Target) << 32) | Value);
+		case Call::PolygonMode:
+			return Update(Id, Target, Value);
+		default:
+			return false;
+		}
+	}
+
+	bool TrackState(Call Id, GLint Location, GLint Value)
+	{
+		//Uniform values belong to the program in use, both uniform types share the key space
+		if (Id != Call::Uniform1i || Location < 0)
+		{
+			return false;
+		}
+		return Update(Call::Uniform1i, (static_cast<uint64_t>(CurrentProgram) << 32) | static_cast<uint32_t>(Location), static_cast<uint32_t>(Value));
+	}
+
+	bool TrackState(Call Id, GLint Location, GLfloat Value)
+	{
+		if (Id != Call::Uniform1f || Location < 0)
+		{
+			return false;
+		}
+		return Update(Call::Uniform1i, (static_cast<uint64_t>(CurrentProgram) << 32) | static_cast<uint32_t>(Location), FloatBits(Value));
+	}
+
+	bool TrackState(Call Id, GLsizei, const GLuint*)
+	{
+		//A deleted name is unbound everywhere and may be returned again by glGen*,
+		//forget the bindings rather than tracking every binding point
+		if (Id == Call::DeleteTextures || Id == Call::DeleteBuffers || Id == Call::DeleteVertexArrays)
+		{
+			ShadowState.clear();
+		}
+		return false;
+	}
+
+	bool TrackState(Call Id, GLint X, GLint Y, GLsizei Width, GLsizei Height)
+	{
+		if (Id != Call::Viewport)
+		{
+			return false;
+		}
+		const bool bSameOrigin = Update(Id, 0, (static_cast<uint64_t>(static_cast<uint32_t>(X)) << 32) | static_cast<uint32_t>(Y));
+		const bool bSameSize = Update(Id, 1, (static_cast<uint64_t>(static_cast<uint32_t>(Width)) << 32) | static_cast<uint32_t>(Height));
+		return bSameOrigin && bSameSize;
+	}
+
+	bool TrackState(Call Id, GLfloat Red, GLfloat Green, GLfloat Blue, GLfloat Alpha)
+	{
+		if (Id != Call::ClearColor)
+		{
+			return false;
+		}
+		const bool bSameRedGreen = Update(Id, 0, (FloatBits(Red) << 32) | FloatBits(Green));
+		const bool bSameBlueAlpha = Update(Id, 1, (FloatBits(Blue) << 32) | FloatBits(Alpha));
+		return bSameRedGreen && bSameBlueAlpha;
+	}
+}
+
+#endif
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// GL call tracing.
+// When BLUEPLANET_GL_TRACE is defined, every GL entry point the application
+// uses is replaced by a macro that forwards to the real function through
+// GLTrace::Traced. Each call is counted per type and per frame, timed to
+// measure the CPU time spent inside the driver, and checked against a shadow
+// copy of the bound objects and fixed function state to find redundant state
+// changes. RequestFrameLog() writes every call of the next frame, with its
+// arguments and duration, to a text file.
+//
+// Include this header after GL/glew.h in every file that makes GL calls and
+// mark frame boundaries with GLTRACE_END_FRAME(). Without BLUEPLANET_GL_TRACE
+// the macros expand to nothing and the GL functions are called directly.
+//
+// The GL context is only current on the render thread, so the statistics are
+// not synchronized. RequestFrameLog() may be called from any thread.
+
+//Entry points resolved at link time (OpenGL 1.1)
+#define GLTRACE_CORE_FUNCTIONS(X) \
+	X(BindTexture) X(BlendFunc) X(Clear) X(ClearColor) X(CullFace) X(DeleteTextures) \
+	X(DepthFunc) X(DepthMask) X(Disable) X(DrawArrays) X(DrawElements) X(Enable) \
+	X(GenTextures) X(GetIntegerv) X(GetString) X(GetTexLevelParameteriv) X(PixelStorei) X(PolygonMode) \
+	X(TexImage2D) X(TexParameteri) X(TexSubImage2D) X(Viewport)
+
+//Entry points loaded by GLEW
+#define GLTRACE_EXTENSION_FUNCTIONS(X) \
+	X(ActiveTexture) X(AttachShader) X(BindBuffer) X(BindVertexArray) X(BufferData) X(BufferStorage) \
+	X(BufferSubData) X(ClientWaitSync) X(CompileShader) X(CopyBufferSubData) X(CreateProgram) X(CreateShader) \
+	X(DeleteBuffers) X(DeleteProgram) X(DeleteQueries) X(DeleteShader) X(DeleteSync) X(DeleteVertexArrays) \
+	X(DetachShader) X(EnableVertexAttribArray) X(FenceSync) X(GenBuffers) X(GenQueries) \
+	X(GenVertexArrays) X(GenerateMipmap) X(GetProgramInfoLog) X(GetProgramiv) \
+	X(GetQueryObjectiv) X(GetQueryObjectui64v) X(GetShaderInfoLog) X(GetShaderiv) \
+	X(GetUniformLocation) X(LinkProgram) X(MapBufferRange) X(ObjectLabel) X(QueryCounter) X(ShaderSource) X(TexImage3D) X(TexStorage3D) \
+	X(TextureParameteri) X(Uniform1f) X(Uniform1i) X(Uniform2fv) X(Uniform3fv) X(UniformMatrix3fv) \
+	X(UniformMatrix4fv) X(UnmapBuffer) X(UseProgram) X(VertexAttribPointer)
+
+#if defined(BLUEPLANET_GL_TRACE) && BLUEPLANET_GL_TRACE
+
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+
+namespace GLTrace
+{
+	#define GLTRACE_ENUM(Name) Name,
+
+	enum class Call : uint8_t
+	{
+		GLTRACE_CORE_FUNCTIONS(GLTRACE_ENUM)
+		GLTRACE_EXTENSION_FUNCTIONS(GLTRACE_ENUM)
+		NumCalls
+	};
+
+	#undef GLTRACE_ENUM
+
+	const char* GetName(Call Id);
+
+	struct FrameStatistics
+	{
+		uint32_t NumCalls = 0;
+		uint32_t NumRedundant = 0;
+		uint32_t NumDrawCalls = 0;
+		uint64_t DriverTime = 0;
+	};
+
+	// Counters of the last finished frame
+	FrameStatistics GetLastFrameStatistics();
+
+	// Close the current frame, print the averages every few seconds and
+	// start or finish a pending frame log
+	void EndFrame();
+
+	// Log every call of the next complete frame to FrameLogFile
+	void RequestFrameLog();
+
+	constexpr const char* FrameLogFile = "gl_frame.log";
+
+	// Compare a state change with the shadow state, return true if it
+	// changes nothing. Calls that do not set tracked state use the template.
+	bool TrackState(Call Id, GLuint Value);
+	bool TrackState(Call Id, GLboolean Value);
+	bool TrackState(Call Id, GLenum Target, GLuint Value);
+	bool TrackState(Call Id, GLint Location, GLint Value);
+	bool TrackState(Call Id, GLint Location, GLfloat Value);
+	bool TrackState(Call Id, GLsizei Count, const GLuint* Names);
+	bool TrackState(Call Id, GLint X, GLint Y, GLsizei Width, GLsizei Height);
+	bool TrackState(Call Id, GLfloat Red, GLfloat Green, GLfloat Blue, GLfloat Alpha);
+
+	template <typename... Arguments>
+	bool TrackState(Call, const Arguments&...)
+	{
+		return false;
+	}
+
+	uint64_t BeginCall();
+	void EndCall(Call Id, bool bRedundant, uint64_t Begin);
+
+	// Non-null while the current frame is being logged
+	std::ostream* GetFrameLog();
+
+	// GLenum and GLuint are the same type, large values are printed as
+	// hexadecimal since they are almost always enums
+	inline void WriteArgument(std::ostream& Out, GLuint Value)
+	{
+		if (Value >= 0x100)
+		{
+			Out << std::hex << "0x" << Value << std::dec;
+		}
+		else
+		{
+			Out << Value;
+		}
+	}
+
+	inline void WriteArgument(std::ostream& Out, GLboolean Value)
+	{
+		Out << (Value ? "GL_TRUE" : "GL_FALSE");
+	}
+
+	template <typename Type>
+	void WriteArgument(std::ostream& Out, const Type& Value)
+	{
+		Out << Value;
+	}
+
+	template <typename Result, typename... Parameters>
+	struct TracedFunction
+	{
+		Call Id;
+		Result (*Function)(Parameters...);
+
+		Result operator()(Parameters... Arguments) const
+		{
+			const bool bRedundant = TrackState(Id, Arguments...);
+
+			if (std::ostream* Log = GetFrameLog())
+			{
+				*Log << GetName(Id) << '(';
+				int Index = 0;
+				(void)std::initializer_list<int>{ ((*Log << (Index++ > 0 ? ", " : "")), WriteArgument(*Log, Arguments), 0)... };
+				*Log << ')';
+			}
+
+			//Timed by a scope object so calls returning void work the same way
+			const Timer Scope{ Id, bRedundant, BeginCall() };
+			return Function(Arguments...);
+		}
+
+		struct Timer
+		{
+			Call Id;
+			bool bRedundant;
+			uint64_t Begin;
+
+			~Timer()
+			{
+				EndCall(Id, bRedundant, Begin);
+			}
+		};
+	};
+
+	//GL entry points are __stdcall on 32-bit Windows, the application only
+	//targets x64 where every calling convention is the same
+	template <typename Result, typename... Parameters>
+	TracedFunction<Result, Parameters...> Traced(Call Id, Result (*Function)(Parameters...))
+	{
+		return TracedFunction<Result, Parameters...>{ Id, Function };
+	}
+}
+
+#define GLTRACE_END_FRAME() GLTrace::EndFrame()
+#define GLTRACE_REQUEST_FRAME_LOG() GLTrace::RequestFrameLog()
+
+//Inside its own expansion a macro name is not expanded again, so Function
+//below is the real entry point
+#define GLTRACE_CALL(Name, Function) GLTrace::Traced(GLTrace::Call::Name, Function)
+
+#if !defined(GLTRACE_IMPLEMENTATION)
+
+#define glBindTexture(...) GLTRACE_CALL(BindTexture, glBindTexture)(__VA_ARGS__)
+#define glBlendFunc(...) GLTRACE_CALL(BlendFunc, glBlendFunc)(__VA_ARGS__)
+#define glClear(...) GLTRACE_CALL(Clear, glClear)(__VA_ARGS__)
+#define glClearColor(...) GLTRACE_CALL(ClearColor, glClearColor)(__VA_ARGS__)
+#define glCullFace(...) GLTRACE_CALL(CullFace, glCullFace)(__VA_ARGS__)
+#define glDeleteTextures(...) GLTRACE_CALL(DeleteTextures, glDeleteTextures)(__VA_ARGS__)
+#define glDepthFunc(...) GLTRACE_CALL(DepthFunc, glDepthFunc)(__VA_ARGS__)
+#define glDepthMask(...) GLTRACE_CALL(DepthMask, glDepthMask)(__VA_ARGS__)
+#define glDisable(...) GLTRACE_CALL(Disable, glDisable)(__VA_ARGS__)
+#define glDrawArrays(...) GLTRACE_CALL(DrawArrays, glDrawArrays)(__VA_ARGS__)
+#define glDrawElements(...) GLTRACE_CALL(DrawElements, glDrawElements)(__VA_ARGS__)
+#define glEnable(...) GLTRACE_CALL(Enable, glEnable)(__VA_ARGS__)
+#define glGenTextures(...) GLTRACE_CALL(GenTextures, glGenTextures)(__VA_ARGS__)
+#define glGetIntegerv(...) GLTRACE_CALL(GetIntegerv, glGetIntegerv)(__VA_ARGS__)
+#define glGetString(...) GLTRACE_CALL(GetString, glGetString)(__VA_ARGS__)
+#define glGetTexLevelParameteriv(...) GLTRACE_CALL(GetTexLevelParameteriv, glGetTexLevelParameteriv)(__VA_ARGS__)
+#define glPixelStorei(...) GLTRACE_CALL(PixelStorei, glPixelStorei)(__VA_ARGS__)
+#define glPolygonMode(...) GLTRACE_CALL(PolygonMode, glPolygonMode)(__VA_ARGS__)
+#define glTexImage2D(...) GLTRACE_CALL(TexImage2D, glTexImage2D)(__VA_ARGS__)
+#define glTexParameteri(...) GLTRACE_CALL(TexParameteri, glTexParameteri)(__VA_ARGS__)
+#define glTexSubImage2D(...) GLTRACE_CALL(TexSubImage2D, glTexSubImage2D)(__VA_ARGS__)
+#define glViewport(...) GLTRACE_CALL(Viewport, glViewport)(__VA_ARGS__)
+
+//GLEW defines these as macros reading its function pointers
+#undef glActiveTexture
+#undef glAttachShader
+#undef glBindBuffer
+#undef glBindVertexArray
+#undef glBufferData
+#undef glBufferStorage
+#undef glBufferSubData
+#undef glClientWaitSync
+#undef glCompileShader
+#undef glCopyBufferSubData
+#undef glCreateProgram
+#undef glCreateShader
+#undef glDeleteBuffers
+#undef glDeleteProgram
+#undef glDeleteQueries
+#undef glDeleteShader
+#undef glDeleteSync
+#undef glDeleteVertexArrays
+#undef glDetachShader
+#undef glEnableVertexAttribArray
+#undef glFenceSync
+#undef glGenBuffers
+#undef glGenQueries
+#undef glGenVertexArrays
+#undef glGenerateMipmap
+#undef glGetProgramInfoLog
+#undef glGetProgramiv
+#undef glGetQueryObjectiv
+#undef glGetQueryObjectui64v
+#undef glGetShaderInfoLog
+#undef glGetShaderiv
+#undef glGetUniformLocation
+#undef glLinkProgram
+#undef glMapBufferRange
+#undef glObjectLabel
+#undef glQueryCounter
+#undef glShaderSource
+#undef glTexImage3D
+#undef glTexStorage3D
+#undef glTextureParameteri
+#undef glUniform1f
+#undef glUniform1i
+#undef glUniform2fv
+#undef glUniform3fv
+#undef glUniformMatrix3fv
+#undef glUniformMatrix4fv
+#undef glUnmapBuffer
+#undef glUseProgram
+#undef glVertexAttribPointer
+
+#define glActiveTexture(...) GLTRACE_CALL(ActiveTexture, GLEW_GET_FUN(__glewActiveTexture))(__VA_ARGS__)
+#define glAttachShader(...) GLTRACE_CALL(AttachShader, GLEW_GET_FUN(__glewAttachShader))(__VA_ARGS__)
+#define glBindBuffer(...) GLTRACE_CALL(BindBuffer, GLEW_GET_FUN(__glewBindBuffer))(__VA_ARGS__)
+#define glBindVertexArray(...) GLTRACE_CALL(BindVertexArray, GLEW_GET_FUN(__glewBindVertexArray))(__VA_ARGS__)
+#define glBufferData(...) GLTRACE_CALL(BufferData, GLEW_GET_FUN(__glewBufferData))(__VA_ARGS__)
+#define glBufferStorage(...) GLTRACE_CALL(BufferStorage, GLEW_GET_FUN(__glewBufferStorage))(__VA_ARGS__)
+#define glBufferSubData(...) GLTRACE_CALL(BufferSubData, GLEW_GET_FUN(__glewBufferSubData))(__VA_ARGS__)
+#define glClientWaitSync(...) GLTRACE_CALL(ClientWaitSync, GLEW_GET_FUN(__glewClientWaitSync))(__VA_ARGS__)
+#define glCompileShader(...) GLTRACE_CALL(CompileShader, GLEW_GET_FUN(__glewCompileShader))(__VA_ARGS__)
+#define glCopyBufferSubData(...) GLTRACE_CALL(CopyBufferSubData, GLEW_GET_FUN(__glewCopyBufferSubData))(__VA_ARGS__)
+#define glCreateProgram(...) GLTRACE_CALL(CreateProgram, GLEW_GET_FUN(__glewCreateProgram))(__VA_ARGS__)
+#define glCreateShader(...) GLTRACE_CALL(CreateShader, GLEW_GET_FUN(__glewCreateShader))(__VA_ARGS__)
+#define glDeleteBuffers(...) GLTRACE_CALL(DeleteBuffers, GLEW_GET_FUN(__glewDeleteBuffers))(__VA_ARGS__)
+#define glDeleteProgram(...) GLTRACE_CALL(DeleteProgram, GLEW_GET_FUN(__glewDeleteProgram))(__VA_ARGS__)
+#define glDeleteQueries(...) GLTRACE_CALL(DeleteQueries, GLEW_GET_FUN(__glewDeleteQueries))(__VA_ARGS__)
+#define glDeleteShader(...) GLTRACE_CALL(DeleteShader, GLEW_GET_FUN(__glewDeleteShader))(__VA_ARGS__)
+#define glDeleteSync(...) GLTRACE_CALL(DeleteSync, GLEW_GET_FUN(__glewDeleteSync))(__VA_ARGS__)
+#define glDeleteVertexArrays(...) GLTRACE_CALL(DeleteVertexArrays, GLEW_GET_FUN(__glewDeleteVertexArrays))(__VA_ARGS__)
+#define glDetachShader(...) GLTRACE_CALL(DetachShader, GLEW_GET_FUN(__glewDetachShader))(__VA_ARGS__)
+#define glEnableVertexAttribArray(...) GLTRACE_CALL(EnableVertexAttribArray, GLEW_GET_FUN(__glewEnableVertexAttribArray))(__VA_ARGS__)
+#define glFenceSync(...) GLTRACE_CALL(FenceSync, GLEW_GET_FUN(__glewFenceSync))(__VA_ARGS__)
+#define glGenBuffers(...) GLTRACE_CALL(GenBuffers, GLEW_GET_FUN(__glewGenBuffers))(__VA_ARGS__)
+#define glGenQueries(...) GLTRACE_CALL(GenQueries, GLEW_GET_FUN(__glewGenQueries))(__VA_ARGS__)
+#define glGenVertexArrays(...) GLTRACE_CALL(GenVertexArrays, GLEW_GET_FUN(__glewGenVertexArrays))(__VA_ARGS__)
+#define glGenerateMipmap(...) GLTRACE_CALL(GenerateMipmap, GLEW_GET_FUN(__glewGenerateMipmap))(__VA_ARGS__)
+#define glGetProgramInfoLog(...) GLTRACE_CALL(GetProgramInfoLog, GLEW_GET_FUN(__glewGetProgramInfoLog))(__VA_ARGS__)
+#define glGetProgramiv(...) GLTRACE_CALL(GetProgramiv, GLEW_GET_FUN(__glewGetProgramiv))(__VA_ARGS__)
+#define glGetQueryObjectiv(...) GLTRACE_CALL(GetQueryObjectiv, GLEW_GET_FUN(__glewGetQueryObjectiv))(__VA_ARGS__)
+#define glGetQueryObjectui64v(...) GLTRACE_CALL(GetQueryObjectui64v, GLEW_GET_FUN(__glewGetQueryObjectui64v))(__VA_ARGS__)
+#define glGetShaderInfoLog(...) GLTRACE_CALL(GetShaderInfoLog, GLEW_GET_FUN(__glewGetShaderInfoLog))(__VA_ARGS__)
+#define glGetShaderiv(...) GLTRACE_CALL(GetShaderiv, GLEW_GET_FUN(__glewGetShaderiv))(__VA_ARGS__)
+#define glGetUniformLocation(...) GLTRACE_CALL(GetUniformLocation, GLEW_GET_FUN(__glewGetUniformLocation))(__VA_ARGS__)
+#define glLinkProgram(...) GLTRACE_CALL(LinkProgram, GLEW_GET_FUN(__glewLinkProgram))(__VA_ARGS__)
+#define glMapBufferRange(...) GLTRACE_CALL(MapBufferRange, GLEW_GET_FUN(__glewMapBufferRange))(__VA_ARGS__)
+#define glObjectLabel(...) GLTRACE_CALL(ObjectLabel, GLEW_GET_FUN(__glewObjectLabel))(__VA_ARGS__)
+#define glQueryCounter(...) GLTRACE_CALL(QueryCounter, GLEW_GET_FUN(__glewQueryCounter))(__VA_ARGS__)
+#define glShaderSource(...) GLTRACE_CALL(ShaderSource, GLEW_GET_FUN(__glewShaderSource))(__VA_ARGS__)
+#define glTexImage3D(...) GLTRACE_CALL(TexImage3D, GLEW_GET_FUN(__glewTexImage3D))(__VA_ARGS__)
+#define glTexStorage3D(...) GLTRACE_CALL(TexStorage3D, GLEW_GET_FUN(__glewTexStorage3D))(__VA_ARGS__)
+#define glTextureParameteri(...) GLTRACE_CALL(TextureParameteri, GLEW_GET_FUN(__glewTextureParameteri))(__VA_ARGS__)
+#define glUniform1f(...) GLTRACE_CALL(Uniform1f, GLEW_GET_FUN(__glewUniform1f))(__VA_ARGS__)
+#define glUniform1i(...) GLTRACE_CALL(Uniform1i, GLEW_GET_FUN(__glewUniform1i))(__VA_ARGS__)
+#define glUniform2fv(...) GLTRACE_CALL(Uniform2fv, GLEW_GET_FUN(__glewUniform2fv))(__VA_ARGS__)
+#define glUniform3fv(...) GLTRACE_CALL(Uniform3fv, GLEW_GET_FUN(__glewUniform3fv))(__VA_ARGS__)
+#define glUniformMatrix3fv(...) GLTRACE_CALL(UniformMatrix3fv, GLEW_GET_FUN(__glewUniformMatrix3fv))(__VA_ARGS__)
+#define glUniformMatrix4fv(...) GLTRACE_CALL(UniformMatrix4fv, GLEW_GET_FUN(__glewUniformMatrix4fv))(__VA_ARGS__)
+#define glUnmapBuffer(...) GLTRACE_CALL(UnmapBuffer, GLEW_GET_FUN(__glewUnmapBuffer))(__VA_ARGS__)
+#define glUseProgram(...) GLTRACE_CALL(UseProgram, GLEW_GET_FUN(__glewUseProgram))(__VA_ARGS__)
+#define glVertexAttribPointer(...) GLTRACE_CALL(VertexAttribPointer, GLEW_GET_FUN(__glewVertexAttribPointer))(__VA_ARGS__)
+
+#endif
+
+#else
+
+#define GLTRACE_END_FRAME()
+#define GLTRACE_REQUEST_FRAME_LOG()
+
+#endif
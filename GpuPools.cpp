@@ -0,0 +1,275 @@
+#include "GpuPools.h"
+#include "GLTrace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+
+#include "GpuResources.h"
+
+namespace
+{
+	constexpr double BytesToMegabytes = 1.0 / (1024.0 * 1024.0);
+}
+
+BufferHeap::BufferHeap(const Settings& InSettings)
+	: HeapSettings(InSettings)
+{
+	//Buddies are found by flipping one bit of the offset, sizes must be powers of two
+	assert(HeapSettings.MinAllocationSize > 0 && (HeapSettings.MinAllocationSize & (HeapSettings.MinAllocationSize - 1)) == 0);
+	BlockOrder = GetOrder(HeapSettings.BlockSize);
+	bImmutableStorage = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+BufferHeap::~BufferHeap()
+{
+	PendingFrees.ReleaseAll([this](const Allocation& Range) { Release(Range); });
+
+	if (AllocatedBytes > 0)
+	{
+		std::cout << "Buffer heap: " << AllocatedBytes << " bytes still allocated" << std::endl;
+	}
+
+	for (const Block& Current : Blocks)
+	{
+		GpuResources::DeleteBuffer(Current.Buffer);
+	}
+}
+
+BufferHeap::Allocation BufferHeap::Allocate(GLsizeiptr Size)
+{
+	const uint32_t Order = GetOrder(std::max<GLsizeiptr>(Size, 1));
+
+	Allocation Range;
+	for (uint32_t Index = 0; Index < Blocks.size(); ++Index)
+	{
+		if (AllocateFromBlock(Index, Order, Range))
+		{
+			Range.Size = Size;
+			return Range;
+		}
+	}
+
+	CreateBlock(std::max(BlockOrder, Order));
+	AllocateFromBlock(static_cast<uint32_t>(Blocks.size() - 1), Order, Range);
+	Range.Size = Size;
+	return Range;
+}
+
+void BufferHeap::Free(const Allocation& Range)
+{
+	if (Range.IsValid())
+	{
+		PendingFrees.Push(Range);
+	}
+}
+
+void BufferHeap::Update()
+{
+	PendingFrees.Fence();
+	PendingFrees.Retire([this](const Allocation& Range) { Release(Range); });
+}
+
+GLsizeiptr BufferHeap::GetReservedBytes() const
+{
+	GLsizeiptr Reserved = 0;
+	for (const Block& Current : Blocks)
+	{
+		Reserved += GetOrderSize(Current.MaxOrder);
+	}
+	return Reserved;
+}
+
+void BufferHeap::FormatSummary(char* Text, size_t TextSize) const
+{
+	std::snprintf(Text, TextSize, "Buffer heap %.2f / %.1f MB in %zu blocks, %zu frees pending",
+		AllocatedBytes * BytesToMegabytes, GetReservedBytes() * BytesToMegabytes, Blocks.size(), PendingFrees.GetNumPending());
+}
+
+uint32_t BufferHeap::GetOrder(GLsizeiptr Size) const
+{
+	uint32_t Order = 0;
+	while (GetOrderSize(Order) < Size)
+	{
+		++Order;
+	}
+	return Order;
+}
+
+void BufferHeap::CreateBlock(uint32_t MaxOrder)
+{
+	Block NewBlock;
+	NewBlock.MaxOrder = MaxOrder;
+	NewBlock.FreeRanges.resize(MaxOrder + 1);
+	NewBlock.FreeRanges[MaxOrder].insert(0);
+
+	//Written by copies only, without client access
+	glGenBuffers(1, &NewBlock.Buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, NewBlock.Buffer);
+	if (bImmutableStorage)
+	{
+		glBufferStorage(GL_COPY_WRITE_BUFFER, GetOrderSize(MaxOrder), nullptr, 0);
+	}
+	else
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, GetOrderSize(MaxOrder), nullptr, GL_DYNAMIC_DRAW);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	GpuResources::RegisterBuffer(NewBlock.Buffer, GetOrderSize(MaxOrder), GpuResources::Category::Geometry, "Buffer heap block");
+
+	Blocks.push_back(std::move(NewBlock));
+}
+
+bool BufferHeap::AllocateFromBlock(uint32_t BlockIndex, uint32_t Order, Allocation& Range)
+{
+	Block& Current = Blocks[BlockIndex];
+	if (Order > Current.MaxOrder)
+	{
+		return false;
+	}
+
+	//Smallest free range that is large enough
+	uint32_t FoundOrder = Order;
+	while (FoundOrder <= Current.MaxOrder && Current.FreeRanges[FoundOrder].empty())
+	{
+		++FoundOrder;
+	}
+	if (FoundOrder > Current.MaxOrder)
+	{
+		return false;
+	}
+
+	const GLintptr Offset = *Current.FreeRanges[FoundOrder].begin();
+	Current.FreeRanges[FoundOrder].erase(Current.FreeRanges[FoundOrder].begin());
+
+	//Split it down, the upper halves stay free
+	while (FoundOrder > Order)
+	{
+		--FoundOrder;
+		Current.FreeRanges[FoundOrder].insert(Offset + GetOrderSize(FoundOrder));
+	}
+
+	Range.Buffer = Current.Buffer;
+	Range.Offset = Offset;
+	Range.Block = BlockIndex;
+	Range.Order = Order;
+	AllocatedBytes += GetOrderSize(Order);
+	return true;
+}
+
+void BufferHeap::Release(const Allocation& Range)
+{
+	Block& Current = Blocks[Range.Block];
+	AllocatedBytes -= GetOrderSize(Range.Order);
+
+	//Merge with the buddy as long as it is free too
+	GLintptr Offset = Range.Offset;
+	uint32_t Order = Range.Order;
+	while (Order < Current.MaxOrder)
+	{
+		const GLintptr Buddy = Offset ^ GetOrderSize(Order);
+		const auto Found = Current.FreeRanges[Order].find(Buddy);
+		if (Found == Current.FreeRanges[Order].end())
+		{
+			break;
+		}
+
+		Current.FreeRanges[Order].erase(Found);
+		Offset = std::min(Offset, Buddy);
+		++Order;
+	}
+
+	Current.FreeRanges[Order].insert(Offset);
+}
+
+TexturePool::TexturePool(const Settings& InSettings)
+	: PoolSettings(InSettings)
+{
+	if (PoolSettings.MipLevels <= 0)
+	{
+		PoolSettings.MipLevels = GpuResources::GetMipLevels(PoolSettings.TileSize, PoolSettings.TileSize);
+	}
+	bImmutableStorage = GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+}
+
+TexturePool::~TexturePool()
+{
+	PendingFrees.ReleaseAll([](const Tile&) {});
+
+	for (GLuint Array : Arrays)
+	{
+		GpuResources::DeleteTexture(Array);
+	}
+}
+
+TexturePool::Tile TexturePool::Allocate()
+{
+	if (FreeTiles.empty())
+	{
+		CreateArray();
+	}
+
+	const Tile Free = FreeTiles.back();
+	FreeTiles.pop_back();
+	++NumAllocated;
+	return Free;
+}
+
+void TexturePool::Free(const Tile& Used)
+{
+	if (Used.IsValid())
+	{
+		PendingFrees.Push(Used);
+		--NumAllocated;
+	}
+}
+
+void TexturePool::Update()
+{
+	PendingFrees.Fence();
+	PendingFrees.Retire([this](const Tile& Retired) { FreeTiles.push_back(Retired); });
+}
+
+void TexturePool::CreateArray()
+{
+	GLuint Array = 0;
+	glGenTextures(1, &Array);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, Array);
+	if (bImmutableStorage)
+	{
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, PoolSettings.MipLevels, PoolSettings.InternalFormat,
+			PoolSettings.TileSize, PoolSettings.TileSize, PoolSettings.LayersPerArray);
+	}
+	else
+	{
+		//The format and type only describe the missing source data, any color format accepts them
+		for (GLint Level = 0; Level < PoolSettings.MipLevels; ++Level)
+		{
+			const GLsizei LevelSize = std::max(PoolSettings.TileSize >> Level, 1);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, Level, static_cast<GLint>(PoolSettings.InternalFormat),
+				LevelSize, LevelSize, PoolSettings.LayersPerArray, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		}
+
+		//Mutable arrays are only complete up to the levels they were given
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, PoolSettings.MipLevels - 1);
+	}
+
+	//Tiles are sampled on their own, nothing to repeat across the edges
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, PoolSettings.MipLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	GpuResources::RegisterTextureArray(Array, PoolSettings.InternalFormat, PoolSettings.TileSize, PoolSettings.TileSize,
+		PoolSettings.LayersPerArray, PoolSettings.MipLevels, GpuResources::Category::Textures, "Tile pool array");
+
+	Arrays.push_back(Array);
+
+	//Layer 0 of the new array is handed out first
+	for (GLint Layer = PoolSettings.LayersPerArray - 1; Layer >= 0; --Layer)
+	{
+		FreeTiles.push_back(Tile{ Array, Layer });
+	}
+}
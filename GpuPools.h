@@ -0,0 +1,263 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GLTrace.h"
+
+// Pooled GL storage for data that comes and goes while the game runs:
+// geometry suballocated from a few large buffers and fixed size tiles in
+// texture arrays. Nothing is created or deleted per object, so streaming
+// does not churn the driver allocator.
+//
+// Freed ranges and tiles are not reused right away: the GPU may still read
+// them for the frames in flight. They wait behind a fence inserted by
+// Update() at the end of the frame they were freed in.
+
+// Items released once the GPU finished the commands issued before them
+template<typename Type>
+class DeferredFrees
+{
+public:
+
+	DeferredFrees() = default;
+
+	~DeferredFrees()
+	{
+		for (const Batch& Pending : Batches)
+		{
+			glDeleteSync(Pending.Fence);
+		}
+	}
+
+	DeferredFrees(const DeferredFrees&) = delete;
+	DeferredFrees& operator=(const DeferredFrees&) = delete;
+
+	void Push(const Type& Item)
+	{
+		Open.push_back(Item);
+	}
+
+	// Fence the items pushed since the last call
+	void Fence()
+	{
+		if (Open.empty())
+		{
+			return;
+		}
+
+		Batches.push_back(Batch{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(Open) });
+		Open.clear();
+	}
+
+	// Hand every item whose fence signaled to Release, oldest first
+	template<typename Function>
+	void Retire(Function&& Release)
+	{
+		while (!Batches.empty())
+		{
+			Batch& Oldest = Batches.front();
+			if (glClientWaitSync(Oldest.Fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				break;
+			}
+
+			//Signaled, or the wait failed. Failed fences are retired too so nothing leaks
+			for (const Type& Item : Oldest.Items)
+			{
+				Release(Item);
+			}
+			glDeleteSync(Oldest.Fence);
+			Batches.pop_front();
+		}
+	}
+
+	// Release everything without waiting, when the objects are deleted anyway
+	template<typename Function>
+	void ReleaseAll(Function&& Release)
+	{
+		Fence();
+		for (const Batch& Pending : Batches)
+		{
+			for (const Type& Item : Pending.Items)
+			{
+				Release(Item);
+			}
+			glDeleteSync(Pending.Fence);
+		}
+		Batches.clear();
+	}
+
+	size_t GetNumPending() const
+	{
+		size_t NumPending = Open.size();
+		for (const Batch& Pending : Batches)
+		{
+			NumPending += Pending.Items.size();
+		}
+		return NumPending;
+	}
+
+private:
+
+	struct Batch
+	{
+		GLsync Fence;
+		std::vector<Type> Items;
+	};
+
+	std::vector<Type> Open;
+	std::deque<Batch> Batches;
+};
+
+// Buddy allocator over immutable buffers created with glBufferStorage
+// (GL 4.4 or GL_ARB_buffer_storage), plain glBufferData buffers without it.
+// Sizes are rounded up to a power of two, at least MinAllocationSize, which
+// also aligns every offset for vertex attributes and index data. A request
+// larger than a block gets a block of its own. The blocks are only filled
+// by copies (glCopyBufferSubData, as the upload scheduler does), so they
+// are created without client access.
+class BufferHeap
+{
+public:
+
+	struct Settings
+	{
+		GLsizeiptr BlockSize = 16 << 20;
+		GLsizeiptr MinAllocationSize = 256;
+	};
+
+	struct Allocation
+	{
+		GLuint Buffer = 0;
+		GLintptr Offset = 0;
+		GLsizeiptr Size = 0;
+
+		uint32_t Block = 0;
+		uint32_t Order = 0;
+
+		bool IsValid() const { return Buffer != 0; }
+	};
+
+	// Requires a current GL context
+	explicit BufferHeap(const Settings& InSettings);
+	~BufferHeap();
+
+	BufferHeap(const BufferHeap&) = delete;
+	BufferHeap& operator=(const BufferHeap&) = delete;
+
+	bool HasImmutableStorage() const { return bImmutableStorage; }
+
+	// At least Size bytes, a new block is created when none has room
+	Allocation Allocate(GLsizeiptr Size);
+
+	// The range returns to the heap once the GPU finished the current frame
+	void Free(const Allocation& Range);
+
+	// Fence the frees of the frame and recycle the ranges the GPU is done with,
+	// once per frame after its commands were submitted
+	void Update();
+
+	GLsizeiptr GetAllocatedBytes() const { return AllocatedBytes; }
+	GLsizeiptr GetReservedBytes() const;
+
+	// One line with the use of the blocks, for reports
+	void FormatSummary(char* Text, size_t TextSize) const;
+
+private:
+
+	struct Block
+	{
+		GLuint Buffer = 0;
+		uint32_t MaxOrder = 0;
+
+		// Offsets of the free ranges of every order, a range of order N is MinAllocationSize << N bytes
+		std::vector<std::set<GLintptr>> FreeRanges;
+	};
+
+	uint32_t GetOrder(GLsizeiptr Size) const;
+	GLsizeiptr GetOrderSize(uint32_t Order) const { return HeapSettings.MinAllocationSize << Order; }
+
+	void CreateBlock(uint32_t MaxOrder);
+	bool AllocateFromBlock(uint32_t BlockIndex, uint32_t Order, Allocation& Range);
+	void Release(const Allocation& Range);
+
+	Settings HeapSettings;
+	uint32_t BlockOrder = 0;
+	bool bImmutableStorage = false;
+
+	std::vector<Block> Blocks;
+	DeferredFrees<Allocation> PendingFrees;
+
+	GLsizeiptr AllocatedBytes = 0;
+};
+
+// Fixed size tiles, each one a layer of a 2D texture array. Arrays are added
+// when every layer is taken, a tile is a texture name and a layer index
+// that shaders sample with a sampler2DArray. Arrays get immutable storage
+// with glTexStorage3D (GL 4.2 or GL_ARB_texture_storage), one glTexImage3D
+// per mip level without it
+class TexturePool
+{
+public:
+
+	struct Settings
+	{
+		GLsizei TileSize = 256;
+		GLenum InternalFormat = GL_RGBA8;
+
+		// Full chain down to 1x1 when 0
+		GLint MipLevels = 0;
+
+		GLsizei LayersPerArray = 64;
+	};
+
+	struct Tile
+	{
+		GLuint Texture = 0;
+		GLint Layer = -1;
+
+		bool IsValid() const { return Texture != 0; }
+	};
+
+	// Requires a current GL context
+	explicit TexturePool(const Settings& InSettings);
+	~TexturePool();
+
+	TexturePool(const TexturePool&) = delete;
+	TexturePool& operator=(const TexturePool&) = delete;
+
+	const Settings& GetSettings() const { return PoolSettings; }
+	bool HasImmutableStorage() const { return bImmutableStorage; }
+
+	// A free layer, its contents are undefined until written with glTexSubImage3D
+	Tile Allocate();
+
+	// The layer is reused once the GPU finished the current frame
+	void Free(const Tile& Used);
+
+	// Fence the frees of the frame and recycle the tiles the GPU is done with
+	void Update();
+
+	uint32_t GetNumArrays() const { return static_cast<uint32_t>(Arrays.size()); }
+	uint32_t GetNumAllocated() const { return NumAllocated; }
+
+private:
+
+	void CreateArray();
+
+	Settings PoolSettings;
+	bool bImmutableStorage = false;
+
+	std::vector<GLuint> Arrays;
+	std::vector<Tile> FreeTiles;
+	DeferredFrees<Tile> PendingFrees;
+
+	uint32_t NumAllocated = 0;
+};
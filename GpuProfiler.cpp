@@ -0,0 +1,223 @@
+#include "GpuProfiler.h"
+#include "GLTrace.h"
+
+#include <algorithm>
+#include <cstring>
+
+GpuProfiler::GpuProfiler()
+{
+	bSupported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+
+	if (!bSupported)
+	{
+		return;
+	}
+
+	//The whole pool is allocated once and reused every frame
+	for (FrameQueries& Frame : Frames)
+	{
+		glGenQueries(static_cast<GLsizei>(Frame.Queries.size()), Frame.Queries.data());
+	}
+
+	Passes.reserve(MaxScopesPerFrame);
+	FrameHistory.Name = "frame";
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	if (!bSupported)
+	{
+		return;
+	}
+
+	for (FrameQueries& Frame : Frames)
+	{
+		glDeleteQueries(static_cast<GLsizei>(Frame.Queries.size()), Frame.Queries.data());
+	}
+}
+
+void GpuProfiler::BeginFrame()
+{
+	if (!bSupported)
+	{
+		return;
+	}
+
+	CurrentFrame = (CurrentFrame + 1) % FrameLatency;
+	FrameQueries& Frame = Frames[CurrentFrame];
+
+	//These queries were issued FrameLatency frames ago, collect them before reuse
+	if (Frame.bPending)
+	{
+		CollectFrame(Frame);
+	}
+
+	Frame.NumScopes = 0;
+	Frame.bPending = false;
+	bRecording = true;
+
+	glQueryCounter(Frame.Queries[0], GL_TIMESTAMP);
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (!bSupported || !bRecording)
+	{
+		return;
+	}
+
+	FrameQueries& Frame = Frames[CurrentFrame];
+	glQueryCounter(Frame.Queries[1], GL_TIMESTAMP);
+
+	Frame.bPending = true;
+	bRecording = false;
+}
+
+int GpuProfiler::BeginScope(const char* Name)
+{
+	if (!bSupported || !bRecording)
+	{
+		return -1;
+	}
+
+	FrameQueries& Frame = Frames[CurrentFrame];
+	if (Frame.NumScopes >= MaxScopesPerFrame)
+	{
+		return -1;
+	}
+
+	const int ScopeIndex = Frame.NumScopes++;
+	Frame.PassIndices[ScopeIndex] = FindOrAddPass(Name);
+
+	glQueryCounter(Frame.Queries[2 + 2 * ScopeIndex], GL_TIMESTAMP);
+
+	return ScopeIndex;
+}
+
+void GpuProfiler::EndScope(int ScopeIndex)
+{
+	if (ScopeIndex < 0)
+	{
+		return;
+	}
+
+	glQueryCounter(Frames[CurrentFrame].Queries[3 + 2 * ScopeIndex], GL_TIMESTAMP);
+}
+
+void GpuProfiler::CollectFrame(FrameQueries& Frame)
+{
+	//The frame end timestamp is the last one issued, if it is ready all of them are
+	GLint bAvailable = GL_FALSE;
+	glGetQueryObjectiv(Frame.Queries[1], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+
+	if (bAvailable == GL_FALSE)
+	{
+		++DroppedFrames;
+		return;
+	}
+
+	const int NumQueries = 2 + 2 * Frame.NumScopes;
+
+	std::array<GLuint64, 2 * MaxScopesPerFrame + 2> Timestamps{};
+	for (int Index = 0; Index < NumQueries; ++Index)
+	{
+		glGetQueryObjectui64v(Frame.Queries[Index], GL_QUERY_RESULT, &Timestamps[Index]);
+	}
+
+	constexpr double NanosecondsToMilliseconds = 1e-6;
+
+	FrameHistory.Add(static_cast<float>((Timestamps[1] - Timestamps[0]) * NanosecondsToMilliseconds));
+
+	for (int ScopeIndex = 0; ScopeIndex < Frame.NumScopes; ++ScopeIndex)
+	{
+		const GLuint64 Begin = Timestamps[2 + 2 * ScopeIndex];
+		const GLuint64 End = Timestamps[3 + 2 * ScopeIndex];
+		Passes[Frame.PassIndices[ScopeIndex]].Add(static_cast<float>((End - Begin) * NanosecondsToMilliseconds));
+	}
+}
+
+int GpuProfiler::FindOrAddPass(const char* Name)
+{
+	for (size_t Index = 0; Index < Passes.size(); ++Index)
+	{
+		if (Passes[Index].Name == Name || std::strcmp(Passes[Index].Name, Name) == 0)
+		{
+			return static_cast<int>(Index);
+		}
+	}
+
+	PassHistory Pass;
+	Pass.Name = Name;
+	Passes.push_back(Pass);
+
+	return static_cast<int>(Passes.size()) - 1;
+}
+
+GpuProfiler::PassStatistics GpuProfiler::GetFrameStatistics() const
+{
+	return FrameHistory.Compute();
+}
+
+GpuProfiler::PassStatistics GpuProfiler::GetPassStatistics(int PassIndex) const
+{
+	return Passes[PassIndex].Compute();
+}
+
+void GpuProfiler::WriteJson(std::ostream& Out) const
+{
+	auto WritePass = [&Out](const PassStatistics& Pass)
+	{
+		Out << "{ \"name\": \"" << Pass.Name << "\""
+			<< ", \"samples\": " << Pass.NumSamples
+			<< ", \"min_ms\": " << Pass.MinMs
+			<< ", \"avg_ms\": " << Pass.AverageMs
+			<< ", \"max_ms\": " << Pass.MaxMs << " }";
+	};
+
+	Out << "{\n    \"supported\": " << (bSupported ? "true" : "false")
+		<< ",\n    \"dropped_frames\": " << DroppedFrames
+		<< ",\n    \"frame\": ";
+	WritePass(GetFrameStatistics());
+
+	Out << ",\n    \"passes\": [";
+	for (int PassIndex = 0; PassIndex < GetNumPasses(); ++PassIndex)
+	{
+		Out << (PassIndex == 0 ? "\n      " : ",\n      ");
+		WritePass(GetPassStatistics(PassIndex));
+	}
+	Out << "\n    ]\n  }";
+}
+
+void GpuProfiler::PassHistory::Add(float Milliseconds)
+{
+	Samples[Next] = Milliseconds;
+	Next = (Next + 1) % HistorySize;
+	NumSamples = std::min(NumSamples + 1, HistorySize);
+}
+
+GpuProfiler::PassStatistics GpuProfiler::PassHistory::Compute() const
+{
+	PassStatistics Statistics;
+	Statistics.Name = Name;
+	Statistics.NumSamples = NumSamples;
+
+	if (NumSamples == 0)
+	{
+		return Statistics;
+	}
+
+	Statistics.LastMs = Samples[(Next + HistorySize - 1) % HistorySize];
+	Statistics.MinMs = Samples[0];
+	Statistics.MaxMs = Samples[0];
+
+	double Sum = 0.0;
+	for (int Index = 0; Index < NumSamples; ++Index)
+	{
+		Statistics.MinMs = std::min<double>(Statistics.MinMs, Samples[Index]);
+		Statistics.MaxMs = std::max<double>(Statistics.MaxMs, Samples[Index]);
+		Sum += Samples[Index];
+	}
+	Statistics.AverageMs = Sum / NumSamples;
+
+	return Statistics;
+}
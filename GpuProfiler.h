@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <ostream>
+#include <vector>
+
+#include <GL/glew.h>
+
+// GPU timing with GL_TIMESTAMP queries.
+// Every scope records a timestamp at its start and end, so scopes may be
+// nested. Query objects are pooled per frame and read back FrameLatency
+// frames later; if a result is still not available the frame is dropped
+// instead of stalling the pipeline. Timings are aggregated per pass name
+// over the last HistorySize frames.
+class GpuProfiler
+{
+public:
+
+	static constexpr int FrameLatency = 4;
+	static constexpr int MaxScopesPerFrame = 16;
+	static constexpr int HistorySize = 120;
+
+	struct PassStatistics
+	{
+		const char* Name = nullptr;
+		int NumSamples = 0;
+		double LastMs = 0.0;
+		double MinMs = 0.0;
+		double AverageMs = 0.0;
+		double MaxMs = 0.0;
+	};
+
+	// RAII helper: GpuProfiler::Scope Zone(Profiler, "planet");
+	class Scope
+	{
+	public:
+		Scope(GpuProfiler& InProfiler, const char* Name)
+			: Profiler(InProfiler)
+			, Index(InProfiler.BeginScope(Name))
+		{
+		}
+
+		~Scope()
+		{
+			Profiler.EndScope(Index);
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		GpuProfiler& Profiler;
+		int Index;
+	};
+
+	// Requires a current GL context with GL_ARB_timer_query (GL 3.3)
+	GpuProfiler();
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	bool IsSupported() const { return bSupported; }
+
+	// Collect the results of an old frame and start recording a new one
+	void BeginFrame();
+	void EndFrame();
+
+	// Name must be a string with static storage (a literal), it identifies the pass
+	int BeginScope(const char* Name);
+	void EndScope(int ScopeIndex);
+
+	// Statistics of the whole frame and of each pass, in first seen order
+	PassStatistics GetFrameStatistics() const;
+	int GetNumPasses() const { return static_cast<int>(Passes.size()); }
+	PassStatistics GetPassStatistics(int PassIndex) const;
+
+	int GetDroppedFrames() const { return DroppedFrames; }
+
+	// JSON object with the frame and per pass statistics, for benchmark reports
+	void WriteJson(std::ostream& Out) const;
+
+private:
+
+	struct PassHistory
+	{
+		const char* Name = nullptr;
+		std::array<float, HistorySize> Samples{};
+		int NumSamples = 0;
+		int Next = 0;
+
+		void Add(float Milliseconds);
+		PassStatistics Compute() const;
+	};
+
+	struct FrameQueries
+	{
+		// Two timestamps per scope plus the frame begin and end
+		std::array<GLuint, 2 * MaxScopesPerFrame + 2> Queries{};
+		std::array<int, MaxScopesPerFrame> PassIndices{};
+		int NumScopes = 0;
+		bool bPending = false;
+	};
+
+	int FindOrAddPass(const char* Name);
+	void CollectFrame(FrameQueries& Frame);
+
+	bool bSupported = false;
+
+	std::array<FrameQueries, FrameLatency> Frames;
+	int CurrentFrame = 0;
+	bool bRecording = false;
+
+	PassHistory FrameHistory;
+	std::vector<PassHistory> Passes;
+
+	int DroppedFrames = 0;
+};
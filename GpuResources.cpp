@@ -0,0 +1,362 @@
+#include "GpuResources.h"
+#include "GLTrace.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	enum class ObjectType : uint8_t
+	{
+		Buffer,
+		Texture,
+		VertexArray,
+		Program
+	};
+
+	struct Resource
+	{
+		ObjectType Type = ObjectType::Buffer;
+		GpuResources::Category Group = GpuResources::Category::Geometry;
+		GLuint Name = 0;
+		uint64_t Bytes = 0;
+		GLenum Format = 0;
+		GLsizei Width = 0;
+		GLsizei Height = 0;
+		GLsizei Layers = 1;
+		GLint MipLevels = 0;
+		std::string Label;
+	};
+
+	constexpr int NumCategories = static_cast<int>(GpuResources::Category::NumCategories);
+
+	// Objects may be registered by any thread that shares the context
+	std::mutex Mutex;
+	std::unordered_map<uint64_t, Resource> Resources;
+	std::array<uint64_t, NumCategories> CategoryBytes{};
+
+	uint64_t MakeKey(ObjectType Type, GLuint Name)
+	{
+		return (static_cast<uint64_t>(Type) << 32) | Name;
+	}
+
+	// The other members keep their defaults until the caller fills them
+	Resource MakeResource(ObjectType Type, GpuResources::Category Group, GLuint Name, const char* Label)
+	{
+		Resource NewResource;
+		NewResource.Type = Type;
+		NewResource.Group = Group;
+		NewResource.Name = Name;
+		NewResource.Label = Label;
+		return NewResource;
+	}
+
+	const char* GetTypeName(ObjectType Type)
+	{
+		switch (Type)
+		{
+		case ObjectType::Buffer: return "buffer";
+		case ObjectType::Texture: return "texture";
+		case ObjectType::VertexArray: return "vertex array";
+		case ObjectType::Program: return "program";
+		default: return "unknown";
+		}
+	}
+
+	GLenum GetLabelIdentifier(ObjectType Type)
+	{
+		switch (Type)
+		{
+		case ObjectType::Buffer: return GL_BUFFER;
+		case ObjectType::Texture: return GL_TEXTURE;
+		case ObjectType::VertexArray: return GL_VERTEX_ARRAY;
+		default: return GL_PROGRAM;
+		}
+	}
+
+	// Drivers store 3 component formats padded to 4 bytes per texel
+	uint32_t GetBytesPerTexel(GLenum InternalFormat)
+	{
+		switch (InternalFormat)
+		{
+		case GL_R8: return 1;
+		case GL_RG8: return 2;
+		case GL_RGB:
+		case GL_RGB8:
+		case GL_RGBA:
+		case GL_RGBA8:
+		case GL_R32F: return 4;
+		case GL_RGBA16F: return 8;
+		case GL_RGBA32F: return 16;
+		default: return 4;
+		}
+	}
+
+	const char* GetFormatName(GLenum InternalFormat)
+	{
+		switch (InternalFormat)
+		{
+		case GL_R8: return "R8";
+		case GL_RG8: return "RG8";
+		case GL_RGB:
+		case GL_RGB8: return "RGB8";
+		case GL_RGBA:
+		case GL_RGBA8: return "RGBA8";
+		case GL_R32F: return "R32F";
+		case GL_RGBA16F: return "RGBA16F";
+		case GL_RGBA32F: return "RGBA32F";
+		default: return "other";
+		}
+	}
+
+	void Register(const Resource& NewResource)
+	{
+		if (NewResource.Name == 0)
+		{
+			return;
+		}
+
+		if ((GLEW_VERSION_4_3 || GLEW_KHR_debug) && !NewResource.Label.empty())
+		{
+			glObjectLabel(GetLabelIdentifier(NewResource.Type), NewResource.Name, -1, NewResource.Label.c_str());
+		}
+
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		//Registering again replaces the previous storage, as glBufferData does
+		Resource& Entry = Resources[MakeKey(NewResource.Type, NewResource.Name)];
+		CategoryBytes[static_cast<int>(Entry.Group)] -= Entry.Bytes;
+		Entry = NewResource;
+		CategoryBytes[static_cast<int>(Entry.Group)] += Entry.Bytes;
+	}
+
+	void Unregister(ObjectType Type, GLuint Name)
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		auto It = Resources.find(MakeKey(Type, Name));
+		if (It == Resources.end())
+		{
+			if (Name != 0)
+			{
+				std::cout << "Deleting unregistered " << GetTypeName(Type) << " " << Name << std::endl;
+			}
+			return;
+		}
+
+		CategoryBytes[static_cast<int>(It->second.Group)] -= It->second.Bytes;
+		Resources.erase(It);
+	}
+
+	void PrintResource(const Resource& Entry)
+	{
+		std::cout << "    " << std::left << std::setw(13) << GetTypeName(Entry.Type) << std::right
+			<< std::setw(5) << Entry.Name << " " << std::setw(10) << std::fixed << std::setprecision(1)
+			<< Entry.Bytes / 1024.0 << " KB  " << Entry.Label;
+
+		if (Entry.Type == ObjectType::Texture)
+		{
+			std::cout << " (" << Entry.Width << "x" << Entry.Height;
+			if (Entry.Layers > 1)
+			{
+				std::cout << "x" << Entry.Layers;
+			}
+			std::cout << " " << GetFormatName(Entry.Format)
+				<< ", " << Entry.MipLevels << " mips)";
+		}
+
+		std::cout << std::endl;
+	}
+
+	// Registered objects ordered by category, then by size
+	std::vector<Resource> GetSortedResources()
+	{
+		std::vector<Resource> Sorted;
+		Sorted.reserve(Resources.size());
+		for (const auto& Entry : Resources)
+		{
+			Sorted.push_back(Entry.second);
+		}
+
+		std::sort(Sorted.begin(), Sorted.end(), [](const Resource& A, const Resource& B)
+		{
+			return A.Group != B.Group ? A.Group < B.Group : A.Bytes > B.Bytes;
+		});
+
+		return Sorted;
+	}
+}
+
+namespace GpuResources
+{
+	const char* GetCategoryName(Category Group)
+	{
+		switch (Group)
+		{
+		case Category::Geometry: return "geometry";
+		case Category::Textures: return "textures";
+		case Category::Shaders: return "shaders";
+		case Category::Debug: return "debug";
+		default: return "unknown";
+		}
+	}
+
+	GLint GetMipLevels(GLsizei Width, GLsizei Height)
+	{
+		GLint Levels = 1;
+		for (GLsizei Size = std::max(Width, Height); Size > 1; Size /= 2)
+		{
+			++Levels;
+		}
+		return Levels;
+	}
+
+	void RegisterBuffer(GLuint Buffer, GLsizeiptr Size, Category Group, const char* Label)
+	{
+		Resource NewResource = MakeResource(ObjectType::Buffer, Group, Buffer, Label);
+		NewResource.Bytes = static_cast<uint64_t>(Size);
+		Register(NewResource);
+	}
+
+	void RegisterTexture(GLuint Texture, GLenum InternalFormat, GLsizei Width, GLsizei Height, GLint MipLevels, Category Group, const char* Label)
+	{
+		RegisterTextureArray(Texture, InternalFormat, Width, Height, 1, MipLevels, Group, Label);
+	}
+
+	void RegisterTextureArray(GLuint Texture, GLenum InternalFormat, GLsizei Width, GLsizei Height, GLsizei Layers, GLint MipLevels, Category Group, const char* Label)
+	{
+		Resource NewResource = MakeResource(ObjectType::Texture, Group, Texture, Label);
+		NewResource.Format = InternalFormat;
+		NewResource.Width = Width;
+		NewResource.Height = Height;
+		NewResource.Layers = Layers;
+		NewResource.MipLevels = MipLevels;
+
+		const uint32_t BytesPerTexel = GetBytesPerTexel(InternalFormat);
+		for (GLint Level = 0; Level < MipLevels; ++Level)
+		{
+			const uint64_t LevelWidth = std::max(Width >> Level, 1);
+			const uint64_t LevelHeight = std::max(Height >> Level, 1);
+			NewResource.Bytes += LevelWidth * LevelHeight * BytesPerTexel * static_cast<uint64_t>(Layers);
+		}
+
+		Register(NewResource);
+	}
+
+	void RegisterVertexArray(GLuint VertexArray, Category Group, const char* Label)
+	{
+		Register(MakeResource(ObjectType::VertexArray, Group, VertexArray, Label));
+	}
+
+	void RegisterProgram(GLuint Program, const char* Label)
+	{
+		Register(MakeResource(ObjectType::Program, Category::Shaders, Program, Label));
+	}
+
+	void DeleteBuffer(GLuint Buffer)
+	{
+		Unregister(ObjectType::Buffer, Buffer);
+		glDeleteBuffers(1, &Buffer);
+	}
+
+	void DeleteTexture(GLuint Texture)
+	{
+		Unregister(ObjectType::Texture, Texture);
+		glDeleteTextures(1, &Texture);
+	}
+
+	void DeleteVertexArray(GLuint VertexArray)
+	{
+		Unregister(ObjectType::VertexArray, VertexArray);
+		glDeleteVertexArrays(1, &VertexArray);
+	}
+
+	void DeleteProgram(GLuint Program)
+	{
+		Unregister(ObjectType::Program, Program);
+		glDeleteProgram(Program);
+	}
+
+	uint64_t GetTotalBytes()
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		uint64_t Total = 0;
+		for (uint64_t Bytes : CategoryBytes)
+		{
+			Total += Bytes;
+		}
+		return Total;
+	}
+
+	uint64_t GetCategoryBytes(Category Group)
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		return CategoryBytes[static_cast<int>(Group)];
+	}
+
+	void FormatSummary(char* Text, size_t TextSize)
+	{
+		constexpr double BytesToMegabytes = 1.0 / (1024.0 * 1024.0);
+
+		int Length = std::snprintf(Text, TextSize, "VRAM %.1f MB (", GetTotalBytes() * BytesToMegabytes);
+
+		for (int Index = 0; Index < NumCategories && Length > 0 && Length < static_cast<int>(TextSize); ++Index)
+		{
+			const Category Group = static_cast<Category>(Index);
+			Length += std::snprintf(Text + Length, TextSize - Length, "%s%s %.1f", Index > 0 ? ", " : "",
+				GetCategoryName(Group), GetCategoryBytes(Group) * BytesToMegabytes);
+		}
+
+		if (Length > 0 && Length < static_cast<int>(TextSize))
+		{
+			std::snprintf(Text + Length, TextSize - Length, ")");
+		}
+	}
+
+	void PrintReport()
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		const std::vector<Resource> Sorted = GetSortedResources();
+
+		for (int Index = 0; Index < NumCategories; ++Index)
+		{
+			std::cout << "GPU " << GetCategoryName(static_cast<Category>(Index)) << ": "
+				<< std::fixed << std::setprecision(2) << CategoryBytes[Index] / (1024.0 * 1024.0) << " MB" << std::endl;
+
+			for (const Resource& Entry : Sorted)
+			{
+				if (static_cast<int>(Entry.Group) == Index)
+				{
+					PrintResource(Entry);
+				}
+			}
+		}
+	}
+
+	int ReportLeaks()
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		if (Resources.empty())
+		{
+			return 0;
+		}
+
+		std::cout << "Leaked " << Resources.size() << " GL objects:" << std::endl;
+		for (const Resource& Entry : GetSortedResources())
+		{
+			PrintResource(Entry);
+		}
+
+		return static_cast<int>(Resources.size());
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <GL/glew.h>
+
+// Registry of the GL buffers, textures, vertex arrays and programs owned by
+// the application, with their estimated size in video memory. Objects are
+// registered right after their storage is allocated and released through the
+// Delete* functions, which also delete the GL object. Objects still
+// registered at shutdown are reported as leaks.
+//
+// Registered objects are labelled with glObjectLabel when KHR_debug is
+// available, so graphics debuggers show the same names.
+namespace GpuResources
+{
+	enum class Category : uint8_t
+	{
+		Geometry,
+		Textures,
+		Shaders,
+		Debug,
+		NumCategories
+	};
+
+	const char* GetCategoryName(Category Group);
+
+	// Size of a mip chain down to 1x1
+	GLint GetMipLevels(GLsizei Width, GLsizei Height);
+
+	// Register or update a buffer after glBufferData
+	void RegisterBuffer(GLuint Buffer, GLsizeiptr Size, Category Group, const char* Label);
+
+	// Register a 2D texture after its storage is allocated. The size assumes
+	// every level of MipLevels is allocated
+	void RegisterTexture(GLuint Texture, GLenum InternalFormat, GLsizei Width, GLsizei Height, GLint MipLevels, Category Group, const char* Label);
+
+	// Same for a 2D texture array, every layer has the same levels
+	void RegisterTextureArray(GLuint Texture, GLenum InternalFormat, GLsizei Width, GLsizei Height, GLsizei Layers, GLint MipLevels, Category Group, const char* Label);
+
+	void RegisterVertexArray(GLuint VertexArray, Category Group, const char* Label);
+	void RegisterProgram(GLuint Program, const char* Label);
+
+	void DeleteBuffer(GLuint Buffer);
+	void DeleteTexture(GLuint Texture);
+	void DeleteVertexArray(GLuint VertexArray);
+	void DeleteProgram(GLuint Program);
+
+	uint64_t GetTotalBytes();
+	uint64_t GetCategoryBytes(Category Group);
+
+	// One line with the total and the size of every category, for the overlay
+	void FormatSummary(char* Text, size_t TextSize);
+
+	// Print every registered object grouped by category
+	void PrintReport();
+
+	// Print the objects that were never deleted, return how many there are
+	int ReportLeaks();
+}
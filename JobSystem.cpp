@@ -0,0 +1,524 @@
+#include "JobSystem.h"
+
+#include <array>
+#include <cassert>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "CpuProfiler.h"
+#include "MemoryTracker.h"
+
+using JobSystem::Job;
+
+namespace
+{
+	// Chase-Lev deque of fixed capacity, with the memory orders of
+	// "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al.).
+	// Only the owner calls Push() and Pop(), any thread may Steal()
+	class WorkDeque
+	{
+	public:
+
+		bool Push(Job* NewJob)
+		{
+			const int64_t B = Bottom.load(std::memory_order_relaxed);
+			const int64_t T = Top.load(std::memory_order_acquire);
+			if (B - T >= static_cast<int64_t>(JobSystem::JobsPerThread))
+			{
+				return false;
+			}
+
+			Jobs[B & Mask].store(NewJob, std::memory_order_relaxed);
+			Bottom.store(B + 1, std::memory_order_release);
+			return true;
+		}
+
+		Job* Pop()
+		{
+			const int64_t B = Bottom.load(std::memory_order_relaxed) - 1;
+			Bottom.store(B, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t T = Top.load(std::memory_order_relaxed);
+
+			if (T > B)
+			{
+				Bottom.store(B + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			Job* Result = Jobs[B & Mask].load(std::memory_order_relaxed);
+			if (T == B)
+			{
+				//Last job: race the thieves for it
+				if (!Top.compare_exchange_strong(T, T + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					Result = nullptr;
+				}
+				Bottom.store(B + 1, std::memory_order_relaxed);
+			}
+			return Result;
+		}
+
+		Job* Steal()
+		{
+			int64_t T = Top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t B = Bottom.load(std::memory_order_acquire);
+
+			if (T >= B)
+			{
+				return nullptr;
+			}
+
+			Job* Result = Jobs[T & Mask].load(std::memory_order_relaxed);
+			if (!Top.compare_exchange_strong(T, T + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				return nullptr;
+			}
+			return Result;
+		}
+
+		bool IsEmpty() const
+		{
+			return Top.load(std::memory_order_relaxed) >= Bottom.load(std::memory_order_relaxed);
+		}
+
+	private:
+
+		static constexpr int64_t Mask = JobSystem::JobsPerThread - 1;
+
+		alignas(64) std::atomic<int64_t> Top{ 0 };
+		alignas(64) std::atomic<int64_t> Bottom{ 0 };
+		alignas(64) std::array<std::atomic<Job*>, JobSystem::JobsPerThread> Jobs;
+	};
+
+	static_assert((JobSystem::JobsPerThread & (JobSystem::JobsPerThread - 1)) == 0, "JobsPerThread must be a power of two");
+
+	// Jobs submitted by threads that have no deque, taken before stealing
+	struct SharedQueue
+	{
+		std::mutex Lock;
+		std::array<Job*, JobSystem::JobsPerThread> Jobs;
+		uint32_t Head = 0;
+		uint32_t Tail = 0;
+		std::atomic<uint32_t> Size{ 0 };
+	};
+
+	SharedQueue Submitted;
+
+	int NumThreads = 1;
+	std::unique_ptr<WorkDeque[]> Deques;
+	std::vector<std::thread> Workers;
+	std::atomic<bool> bRunning{ false };
+
+	// Idle workers sleep here, woken when a job is pushed
+	std::mutex SleepMutex;
+	std::condition_variable WakeCondition;
+	std::atomic<int> NumSleeping{ 0 };
+
+	// Spins looking for work before a worker goes to sleep
+	constexpr int IdleSpins = 256;
+
+	// "Worker " and any int fit, the profiler keeps the pointer for the whole run
+	char WorkerNames[JobSystem::MaxThreads][24];
+
+	// Deque of the calling thread, -1 for threads that are not part of the pool
+	thread_local int WorkerIndex = -1;
+
+	// Ring the calling thread's jobs are allocated from. The queues point into
+	// it, a thread exiting (an I/O thread scheduling decodes) waits until the
+	// other threads ran its jobs
+	struct JobRing
+	{
+		~JobRing()
+		{
+			for (uint32_t Index = 0; Jobs && Index < JobSystem::JobsPerThread; ++Index)
+			{
+				while (Jobs[Index].bInUse.load(std::memory_order_acquire))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		std::unique_ptr<Job[]> Jobs;
+	};
+
+	thread_local JobRing JobPool;
+	thread_local uint32_t NextJob = 0;
+
+	// Victim selection for stealing
+	thread_local uint32_t RandomState = 0x9E3779B9u;
+
+	uint32_t NextRandom()
+	{
+		RandomState ^= RandomState << 13;
+		RandomState ^= RandomState >> 17;
+		RandomState ^= RandomState << 5;
+		return RandomState;
+	}
+
+	void Pause()
+	{
+#if defined(__SSE2__) || defined(_M_X64)
+		_mm_pause();
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+	void Execute(Job& Current)
+	{
+#if defined(BLUEPLANET_TRACK_ALLOCATIONS) && BLUEPLANET_TRACK_ALLOCATIONS
+		//Allocations are attributed to the subsystem that scheduled the job
+		MemoryTracker::TagScope Tag(static_cast<MemoryTracker::Tag>(Current.MemoryTag));
+#endif
+		JobSystem::Counter* Signal = Current.Signal;
+		Current.Function(Current);
+		Current.bInUse.store(false, std::memory_order_release);
+		if (Signal != nullptr)
+		{
+			JobSystem::Finish(*Signal);
+		}
+	}
+
+	Job* TakeSubmitted()
+	{
+		if (Submitted.Size.load(std::memory_order_relaxed) == 0)
+		{
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> Lock(Submitted.Lock);
+		if (Submitted.Head == Submitted.Tail)
+		{
+			return nullptr;
+		}
+
+		Job* Result = Submitted.Jobs[Submitted.Head++ & (JobSystem::JobsPerThread - 1)];
+		Submitted.Size.fetch_sub(1, std::memory_order_relaxed);
+		return Result;
+	}
+
+	// Own deque first, then the shared queue, then the other workers
+	Job* FindJob()
+	{
+		if (NumThreads == 1)
+		{
+			return nullptr;
+		}
+
+		if (WorkerIndex >= 0)
+		{
+			if (Job* Own = Deques[WorkerIndex].Pop())
+			{
+				return Own;
+			}
+		}
+
+		if (Job* Shared = TakeSubmitted())
+		{
+			return Shared;
+		}
+
+		const int Start = static_cast<int>(NextRandom() % NumThreads);
+		for (int Offset = 0; Offset < NumThreads; ++Offset)
+		{
+			const int Victim = (Start + Offset) % NumThreads;
+			if (Victim == WorkerIndex)
+			{
+				continue;
+			}
+
+			if (Job* Stolen = Deques[Victim].Steal())
+			{
+				return Stolen;
+			}
+		}
+
+		return nullptr;
+	}
+
+	bool HasWork()
+	{
+		if (Submitted.Size.load(std::memory_order_relaxed) != 0)
+		{
+			return true;
+		}
+
+		for (int Index = 0; Index < NumThreads; ++Index)
+		{
+			if (!Deques[Index].IsEmpty())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WakeWorker()
+	{
+		//Pairs with the fence of a worker going to sleep: either it sees the
+		//new job or this sees it sleeping
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (NumSleeping.load(std::memory_order_relaxed) > 0)
+		{
+			std::lock_guard<std::mutex> Lock(SleepMutex);
+			WakeCondition.notify_one();
+		}
+	}
+
+	void Push(Job& Runnable)
+	{
+		if (NumThreads == 1)
+		{
+			Execute(Runnable);
+			return;
+		}
+
+		bool bQueued = false;
+		if (WorkerIndex >= 0)
+		{
+			bQueued = Deques[WorkerIndex].Push(&Runnable);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> Lock(Submitted.Lock);
+			if (Submitted.Tail - Submitted.Head < JobSystem::JobsPerThread)
+			{
+				Submitted.Jobs[Submitted.Tail++ & (JobSystem::JobsPerThread - 1)] = &Runnable;
+				Submitted.Size.fetch_add(1, std::memory_order_relaxed);
+				bQueued = true;
+			}
+		}
+
+		//Queue full, the caller has produced far more than the pool can take
+		if (!bQueued)
+		{
+			Execute(Runnable);
+			return;
+		}
+
+		WakeWorker();
+	}
+
+	void WorkerMain(int Index)
+	{
+		WorkerIndex = Index;
+		RandomState += static_cast<uint32_t>(Index) * 0x85EBCA6Bu;
+		PROFILE_THREAD_NAME(WorkerNames[Index]);
+
+		while (bRunning.load(std::memory_order_relaxed))
+		{
+			Job* Next = nullptr;
+			for (int Spin = 0; Spin < IdleSpins && Next == nullptr; ++Spin)
+			{
+				Next = FindJob();
+				if (Next == nullptr)
+				{
+					Pause();
+				}
+			}
+
+			if (Next != nullptr)
+			{
+				Execute(*Next);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> Lock(SleepMutex);
+			NumSleeping.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!HasWork() && bRunning.load(std::memory_order_relaxed))
+			{
+				WakeCondition.wait(Lock);
+			}
+			NumSleeping.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+namespace JobSystem
+{
+	void Initialize(int RequestedThreads)
+	{
+		assert(!bRunning && "JobSystem already initialized");
+
+		if (RequestedThreads <= 0)
+		{
+			RequestedThreads = static_cast<int>(std::thread::hardware_concurrency());
+		}
+		NumThreads = RequestedThreads < 1 ? 1 : (RequestedThreads > MaxThreads ? MaxThreads : RequestedThreads);
+
+		if (NumThreads == 1)
+		{
+			return;
+		}
+
+		Deques.reset(new WorkDeque[NumThreads]);
+		WorkerIndex = 0;
+		bRunning = true;
+
+		Workers.reserve(NumThreads - 1);
+		for (int Index = 1; Index < NumThreads; ++Index)
+		{
+			std::snprintf(WorkerNames[Index], sizeof(WorkerNames[Index]), "Worker %d", Index);
+			Workers.emplace_back(WorkerMain, Index);
+		}
+	}
+
+	void Shutdown()
+	{
+		if (!bRunning)
+		{
+			NumThreads = 1;
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> Lock(SleepMutex);
+			bRunning = false;
+			WakeCondition.notify_all();
+		}
+
+		for (std::thread& Worker : Workers)
+		{
+			Worker.join();
+		}
+		Workers.clear();
+
+		//Whatever was still queued runs here, jobs may be waited on
+		while (Job* Next = FindJob())
+		{
+			Execute(*Next);
+		}
+
+		Deques.reset();
+		WorkerIndex = -1;
+		NumThreads = 1;
+	}
+
+	int GetNumThreads()
+	{
+		return NumThreads;
+	}
+
+	Job& AllocateJob()
+	{
+		if (!JobPool.Jobs)
+		{
+			JobPool.Jobs.reset(new Job[JobsPerThread]);
+		}
+
+		//Jobs can sit in a deque or behind a counter for long, skip the slots still in flight
+		for (uint32_t Attempt = 1; JobPool.Jobs[NextJob & (JobsPerThread - 1)].bInUse.load(std::memory_order_acquire); ++Attempt)
+		{
+			++NextJob;
+			if (Attempt % JobsPerThread == 0)
+			{
+				if (Job* Next = FindJob())
+				{
+					Execute(*Next);
+				}
+				else
+				{
+					Pause();
+				}
+			}
+		}
+
+		Job& NewJob = JobPool.Jobs[NextJob++ & (JobsPerThread - 1)];
+		NewJob.bInUse.store(true, std::memory_order_relaxed);
+		NewJob.Signal = nullptr;
+		NewJob.NextWaiting = nullptr;
+#if defined(BLUEPLANET_TRACK_ALLOCATIONS) && BLUEPLANET_TRACK_ALLOCATIONS
+		NewJob.MemoryTag = static_cast<uint8_t>(MemoryTracker::GetCurrentTag());
+#endif
+		return NewJob;
+	}
+
+	void Schedule(Job& NewJob, Counter* Signal, Counter* After)
+	{
+		NewJob.Signal = Signal;
+		if (Signal != nullptr)
+		{
+			Signal->Pending.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		if (After != nullptr)
+		{
+			//Under the lock Finish() either sees this job in the list or it
+			//already dropped the counter to zero before
+			std::lock_guard<std::mutex> Lock(After->WaitingLock);
+			if (After->Pending.load(std::memory_order_acquire) != 0)
+			{
+				NewJob.NextWaiting = After->Waiting;
+				After->Waiting = &NewJob;
+				return;
+			}
+		}
+
+		Push(NewJob);
+	}
+
+	void Finish(Counter& Done)
+	{
+		//Finishing keeps Wait() from returning, and the counter from being
+		//destroyed, until the waiting jobs have been taken out of it
+		Done.Finishing.fetch_add(1, std::memory_order_seq_cst);
+
+		Job* Released = nullptr;
+		if (Done.Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::lock_guard<std::mutex> Lock(Done.WaitingLock);
+			Released = Done.Waiting;
+			Done.Waiting = nullptr;
+		}
+
+		Done.Finishing.fetch_sub(1, std::memory_order_release);
+
+		while (Released != nullptr)
+		{
+			Job* Next = Released->NextWaiting;
+			Push(*Released);
+			Released = Next;
+		}
+	}
+
+	void Wait(Counter& Done)
+	{
+		PROFILE_SCOPE("JobSystem::Wait");
+
+		//Without workers every job already ran inline, unless it waits on a counter that never finishes
+		assert((NumThreads > 1 || Done.IsDone()) && "Waiting on a counter no job will finish");
+
+		while (!Done.IsDone() || Done.Finishing.load(std::memory_order_acquire) != 0)
+		{
+			if (Job* Next = FindJob())
+			{
+				Execute(*Next);
+			}
+			else
+			{
+				Pause();
+			}
+		}
+	}
+
+	bool RunOneJob()
+	{
+		if (Job* Next = FindJob())
+		{
+			Execute(*Next);
+			return true;
+		}
+		return false;
+	}
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+// Work-stealing job system.
+// Every worker owns a Chase-Lev deque: it pushes and pops its own jobs at
+// the bottom (LIFO, cache warm) while idle workers steal from the top of
+// the others (FIFO, the oldest and usually largest pieces of work). Threads
+// that are not workers, like the render thread, submit to a shared queue.
+//
+// Jobs are a function pointer plus a few bytes of captured state copied
+// into a free slot of a per-thread ring, scheduling never touches the heap.
+// A Counter tracks unfinished jobs: Wait() runs other jobs until it drops
+// to zero instead of blocking, and a job scheduled After a counter only
+// becomes runnable once that counter is done.
+//
+// Until Initialize() is called, or with a single thread, jobs run inline
+// so every caller works the same without a pool.
+namespace JobSystem
+{
+	// Worker threads plus the thread calling Initialize()
+	constexpr int MaxThreads = 128;
+
+	// Job slots of each thread and capacity of each deque, a power of two
+	constexpr uint32_t JobsPerThread = 4096;
+
+	// Bytes of captured state a job can carry
+	constexpr size_t JobDataSize = 40;
+
+	struct Job;
+
+	// Number of unfinished jobs. A counter must outlive its jobs, destroy it
+	// only once Wait() returned
+	class Counter
+	{
+	public:
+
+		Counter() = default;
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+		bool IsDone() const { return Pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+
+		friend void Schedule(Job& NewJob, Counter* Signal, Counter* After);
+		friend void Finish(Counter& Done);
+		friend void Wait(Counter& Done);
+
+		std::atomic<int> Pending{ 0 };
+
+		// Finish() calls still touching the counter
+		std::atomic<int> Finishing{ 0 };
+
+		// Jobs scheduled After this counter, released when it reaches zero
+		std::mutex WaitingLock;
+		Job* Waiting = nullptr;
+	};
+
+	struct Job
+	{
+		void (*Function)(Job& Self) = nullptr;
+		Counter* Signal = nullptr;
+		Job* NextWaiting = nullptr;
+
+		// Set from allocation until the job has run
+		std::atomic<bool> bInUse{ false };
+		uint8_t MemoryTag = 0;
+		alignas(16) unsigned char Data[JobDataSize];
+	};
+
+	// Start NumThreads - 1 workers, 0 uses every hardware thread.
+	// The calling thread counts as one of them and helps while waiting
+	void Initialize(int NumThreads = 0);
+
+	// Run the remaining jobs and join the workers
+	void Shutdown();
+
+	// Workers plus the main thread, 1 when not initialized
+	int GetNumThreads();
+
+	// Take a free job slot of the calling thread's ring. When every slot is
+	// in flight the caller runs other jobs until one is released
+	Job& AllocateJob();
+
+	// Make the job runnable, or queue it until After is done.
+	// Signal, if any, counts the job until it has run
+	void Schedule(Job& NewJob, Counter* Signal, Counter* After = nullptr);
+
+	// Called once a job ran, decrements the counter and releases its waiters
+	void Finish(Counter& Done);
+
+	// Run other jobs until Done reaches zero
+	void Wait(Counter& Done);
+
+	// Run one queued job on the calling thread, false if there was none
+	bool RunOneJob();
+
+	// Run Function(), a callable of at most JobDataSize bytes
+	template <typename Function>
+	void Run(Function&& Body, Counter* Signal, Counter* After = nullptr)
+	{
+		using Callable = typename std::decay<Function>::type;
+		static_assert(sizeof(Callable) <= JobDataSize, "Job captures too much state, capture a pointer instead");
+		static_assert(alignof(Callable) <= 16, "Job state is over-aligned");
+
+		Job& NewJob = AllocateJob();
+		new (NewJob.Data) Callable(std::forward<Function>(Body));
+		NewJob.Function = [](Job& Self)
+		{
+			Callable& Stored = *reinterpret_cast<Callable*>(Self.Data);
+			Stored();
+			Stored.~Callable();
+		};
+		Schedule(NewJob, Signal, After);
+	}
+
+	// Call Body(Begin, End) over sub-ranges of [Begin, End) of at least Grain
+	// elements, 0 picks a grain giving a few ranges per thread. Ranges are
+	// split in halves so thieves take the largest pieces. Returns once every
+	// range is done, the calling thread takes part
+	template <typename Function>
+	void ParallelFor(int64_t Begin, int64_t End, int64_t Grain, const Function& Body)
+	{
+		if (End <= Begin)
+		{
+			return;
+		}
+
+		if (Grain <= 0)
+		{
+			Grain = (End - Begin + GetNumThreads() * 4 - 1) / (GetNumThreads() * 4);
+		}
+
+		if (GetNumThreads() == 1 || End - Begin <= Grain)
+		{
+			Body(Begin, End);
+			return;
+		}
+
+		struct Range
+		{
+			static void Split(const Function& Body, int64_t Begin, int64_t End, int64_t Grain, Counter& Done)
+			{
+				while (End - Begin > Grain)
+				{
+					const int64_t Middle = Begin + (End - Begin) / 2;
+					const Function* BodyPointer = &Body;
+					Counter* DonePointer = &Done;
+					Run([BodyPointer, Middle, End, Grain, DonePointer]()
+					{
+						Split(*BodyPointer, Middle, End, Grain, *DonePointer);
+					}, &Done);
+					End = Middle;
+				}
+				Body(Begin, End);
+			}
+		};
+
+		Counter Done;
+		Range::Split(Body, Begin, End, Grain, Done);
+		Wait(Done);
+	}
+}
@@ -0,0 +1,437 @@
+#include "Log.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define STB_SPRINTF_IMPLEMENTATION
+#include <stb_sprintf.h>
+
+#include "CpuProfiler.h"
+
+namespace Log
+{
+	enum class ArgumentType : uint8_t
+	{
+		Signed,
+		Unsigned,
+		Double,
+		String,
+		Pointer
+	};
+
+	// One message. Sequence tells whose turn the slot is (Vyukov bounded queue):
+	// equal to the enqueue position when free, position + 1 once written.
+	// Arguments are stored as 64 bit values, strings as an offset into Strings
+	struct alignas(64) Message
+	{
+		std::atomic<uint64_t> Sequence;
+		uint64_t Timestamp;
+		const char* Format;
+		Level Severity;
+		uint8_t NumArguments;
+		uint8_t StringBytes;
+		ArgumentType Types[MaxArguments];
+		uint64_t Values[MaxArguments];
+		char Strings[MaxStringBytes];
+	};
+}
+
+namespace
+{
+	static_assert((Log::RingSize & (Log::RingSize - 1)) == 0, "RingSize must be a power of two");
+	static_assert(Log::MaxStringBytes <= 255, "String offsets are stored in a byte");
+
+	// Longest line written, longer messages are cut
+	constexpr int MaxLineLength = 512;
+
+	struct Ring
+	{
+		Ring()
+		{
+			for (uint32_t Index = 0; Index < Log::RingSize; ++Index)
+			{
+				Slots[Index].Sequence.store(Index, std::memory_order_relaxed);
+			}
+		}
+
+		std::array<Log::Message, Log::RingSize> Slots;
+
+		alignas(64) std::atomic<uint64_t> EnqueuePosition{ 0 };
+
+		// Only used by the writer thread
+		alignas(64) uint64_t DequeuePosition = 0;
+
+		// DequeuePosition after the last batch written, for Flush()
+		std::atomic<uint64_t> WrittenPosition{ 0 };
+	};
+
+	Ring Messages;
+
+	std::atomic<uint64_t> NumDropped{ 0 };
+
+	std::atomic<bool> bRunning{ false };
+	std::thread Writer;
+	std::FILE* Output = nullptr;
+
+	const uint64_t StartTime = CpuProfiler::Now();
+
+	const char* GetLevelName(Log::Level Severity)
+	{
+		switch (Severity)
+		{
+		case Log::Level::Trace: return "TRACE";
+		case Log::Level::Debug: return "DEBUG";
+		case Log::Level::Info: return "INFO";
+		case Log::Level::Warning: return "WARN";
+		case Log::Level::Error: return "ERROR";
+		default: return "?";
+		}
+	}
+
+	int64_t GetSigned(const Log::Message& Current, int Index)
+	{
+		switch (Current.Types[Index])
+		{
+		case Log::ArgumentType::Signed: return static_cast<int64_t>(Current.Values[Index]);
+		case Log::ArgumentType::Unsigned: return static_cast<int64_t>(Current.Values[Index]);
+		case Log::ArgumentType::Double:
+		{
+			double Value;
+			std::memcpy(&Value, &Current.Values[Index], sizeof(Value));
+			return static_cast<int64_t>(Value);
+		}
+		default: return 0;
+		}
+	}
+
+	double GetDouble(const Log::Message& Current, int Index)
+	{
+		switch (Current.Types[Index])
+		{
+		case Log::ArgumentType::Signed: return static_cast<double>(static_cast<int64_t>(Current.Values[Index]));
+		case Log::ArgumentType::Unsigned: return static_cast<double>(Current.Values[Index]);
+		case Log::ArgumentType::Double:
+		{
+			double Value;
+			std::memcpy(&Value, &Current.Values[Index], sizeof(Value));
+			return Value;
+		}
+		default: return 0.0;
+		}
+	}
+
+	// printf the stored arguments one conversion at a time. Flags, width and
+	// precision are kept, length modifiers are replaced since every argument
+	// was widened to 64 bits. Returns the length written
+	int FormatMessage(const Log::Message& Current, char* Buffer, int Size)
+	{
+		int Length = 0;
+		int Index = 0;
+		const char* Cursor = Current.Format;
+
+		while (*Cursor != '\0' && Length < Size - 1)
+		{
+			if (Cursor[0] != '%' || Cursor[1] == '%')
+			{
+				Buffer[Length++] = *Cursor;
+				Cursor += Cursor[0] == '%' ? 2 : 1;
+				continue;
+			}
+
+			char Specifier[32] = "%";
+			int SpecifierLength = 1;
+			for (++Cursor; *Cursor != '\0' && std::strchr("-+ #0123456789.", *Cursor) != nullptr; ++Cursor)
+			{
+				if (SpecifierLength < 24)
+				{
+					Specifier[SpecifierLength++] = *Cursor;
+				}
+			}
+			while (*Cursor != '\0' && std::strchr("hljztL", *Cursor) != nullptr)
+			{
+				++Cursor;
+			}
+
+			const char Conversion = *Cursor;
+			if (Conversion == '\0')
+			{
+				break;
+			}
+			++Cursor;
+
+			if (Index >= Current.NumArguments)
+			{
+				Length += stbsp_snprintf(Buffer + Length, Size - Length, "<missing>");
+				Length = std::min(Length, Size - 1);
+				continue;
+			}
+
+			int Written = 0;
+			switch (Conversion)
+			{
+			case 'd':
+			case 'i':
+				std::strcpy(Specifier + SpecifierLength, "lld");
+				Written = stbsp_snprintf(Buffer + Length, Size - Length, Specifier, static_cast<long long>(GetSigned(Current, Index)));
+				break;
+			case 'u':
+			case 'o':
+			case 'x':
+			case 'X':
+				Specifier[SpecifierLength++] = 'l';
+				Specifier[SpecifierLength++] = 'l';
+				Specifier[SpecifierLength++] = Conversion;
+				Specifier[SpecifierLength] = '\0';
+				Written = stbsp_snprintf(Buffer + Length, Size - Length, Specifier, static_cast<unsigned long long>(GetSigned(Current, Index)));
+				break;
+			case 'c':
+				std::strcpy(Specifier + SpecifierLength, "c");
+				Written = stbsp_snprintf(Buffer + Length, Size - Length, Specifier, static_cast<int>(GetSigned(Current, Index)));
+				break;
+			case 'f':
+			case 'F':
+			case 'e':
+			case 'E':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+				Specifier[SpecifierLength++] = Conversion;
+				Specifier[SpecifierLength] = '\0';
+				Written = stbsp_snprintf(Buffer + Length, Size - Length, Specifier, GetDouble(Current, Index));
+				break;
+			case 's':
+				std::strcpy(Specifier + SpecifierLength, "s");
+				Written = stbsp_snprintf(Buffer + Length, Size - Length, Specifier,
+					Current.Types[Index] == Log::ArgumentType::String ? Current.Strings + Current.Values[Index] : "<not a string>");
+				break;
+			case 'p':
+				Written = stbsp_snprintf(Buffer + Length, Size - Length, "%p", reinterpret_cast<const void*>(Current.Values[Index]));
+				break;
+			default:
+				Written = stbsp_snprintf(Buffer + Length, Size - Length, "<%%%c?>", Conversion);
+				break;
+			}
+
+			++Index;
+			Length = std::min(Length + std::max(Written, 0), Size - 1);
+		}
+
+		Buffer[Length] = '\0';
+		return Length;
+	}
+
+	// Write every message published so far, only called by the writer thread
+	// (or by Shutdown once it has stopped). Returns how many were written
+	int Drain()
+	{
+		int NumWritten = 0;
+		char Line[MaxLineLength + 1];
+
+		for (;;)
+		{
+			Log::Message& Current = Messages.Slots[Messages.DequeuePosition & (Log::RingSize - 1)];
+			if (Current.Sequence.load(std::memory_order_acquire) != Messages.DequeuePosition + 1)
+			{
+				break;
+			}
+
+			const uint64_t Nanoseconds = Current.Timestamp - StartTime;
+			int Length = stbsp_snprintf(Line, MaxLineLength, "[%5llu.%06llu] %-5s ",
+				static_cast<unsigned long long>(Nanoseconds / 1000000000),
+				static_cast<unsigned long long>(Nanoseconds / 1000 % 1000000),
+				GetLevelName(Current.Severity));
+			Length += FormatMessage(Current, Line + Length, MaxLineLength - Length);
+			Line[Length++] = '\n';
+			std::fwrite(Line, 1, Length, Output);
+
+			//Hand the slot back to the producers for the next lap of the ring
+			Current.Sequence.store(Messages.DequeuePosition + Log::RingSize, std::memory_order_release);
+			++Messages.DequeuePosition;
+			++NumWritten;
+		}
+
+		if (NumWritten > 0)
+		{
+			std::fflush(Output);
+			Messages.WrittenPosition.store(Messages.DequeuePosition, std::memory_order_release);
+		}
+
+		return NumWritten;
+	}
+
+	void WriterMain()
+	{
+		PROFILE_THREAD_NAME("Log");
+
+		while (bRunning.load(std::memory_order_acquire))
+		{
+			if (Drain() == 0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+		}
+	}
+}
+
+namespace Log
+{
+	void Initialize(const char* FilePath)
+	{
+		if (bRunning)
+		{
+			return;
+		}
+
+		Output = stderr;
+		if (FilePath != nullptr && FilePath[0] != '\0')
+		{
+			if (std::FILE* File = std::fopen(FilePath, "w"))
+			{
+				Output = File;
+			}
+			else
+			{
+				std::fprintf(stderr, "Could not open log file %s, logging to stderr\n", FilePath);
+			}
+		}
+
+		bRunning = true;
+		Writer = std::thread(WriterMain);
+	}
+
+	void Shutdown()
+	{
+		if (!bRunning)
+		{
+			return;
+		}
+
+		bRunning = false;
+		Writer.join();
+
+		Drain();
+
+		if (NumDropped > 0)
+		{
+			std::fprintf(Output, "%llu log messages dropped, the ring was full\n",
+				static_cast<unsigned long long>(NumDropped.load()));
+		}
+
+		if (Output != stderr)
+		{
+			std::fclose(Output);
+		}
+		Output = nullptr;
+	}
+
+	void Flush()
+	{
+		//Dropped messages advance nothing, only wait for the slots claimed so far
+		const uint64_t Target = Messages.EnqueuePosition.load(std::memory_order_acquire);
+		while (bRunning && Messages.WrittenPosition.load(std::memory_order_acquire) < Target)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+	}
+
+	uint64_t GetNumDropped()
+	{
+		return NumDropped.load(std::memory_order_relaxed);
+	}
+
+	Message* BeginMessage(Level Severity, const char* Format)
+	{
+		//Claim a slot: the one at the enqueue position is free when its sequence matches
+		uint64_t Position = Messages.EnqueuePosition.load(std::memory_order_relaxed);
+
+		for (;;)
+		{
+			Message& Candidate = Messages.Slots[Position & (RingSize - 1)];
+			const int64_t Difference = static_cast<int64_t>(Candidate.Sequence.load(std::memory_order_acquire) - Position);
+
+			if (Difference == 0)
+			{
+				if (Messages.EnqueuePosition.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+				{
+					Candidate.Timestamp = CpuProfiler::Now();
+					Candidate.Format = Format;
+					Candidate.Severity = Severity;
+					Candidate.NumArguments = 0;
+					Candidate.StringBytes = 0;
+					return &Candidate;
+				}
+			}
+			else if (Difference < 0)
+			{
+				//The writer has not consumed this slot from the previous lap: full
+				NumDropped.fetch_add(1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			else
+			{
+				Position = Messages.EnqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void AddArgument(Message& Slot, int64_t Value)
+	{
+		Slot.Types[Slot.NumArguments] = ArgumentType::Signed;
+		Slot.Values[Slot.NumArguments++] = static_cast<uint64_t>(Value);
+	}
+
+	void AddArgument(Message& Slot, uint64_t Value)
+	{
+		Slot.Types[Slot.NumArguments] = ArgumentType::Unsigned;
+		Slot.Values[Slot.NumArguments++] = Value;
+	}
+
+	void AddArgument(Message& Slot, double Value)
+	{
+		Slot.Types[Slot.NumArguments] = ArgumentType::Double;
+		std::memcpy(&Slot.Values[Slot.NumArguments++], &Value, sizeof(Value));
+	}
+
+	void AddArgument(Message& Slot, const char* Value)
+	{
+		//Copied, the caller's string may be gone by the time the line is written.
+		//Cut to what is left of the message storage, the last byte is always a terminator
+		if (Value == nullptr)
+		{
+			Value = "(null)";
+		}
+
+		const int Offset = Slot.StringBytes;
+		const int Available = MaxStringBytes - 1 - Offset;
+		int Length = 0;
+		while (Length < Available && Value[Length] != '\0')
+		{
+			++Length;
+		}
+
+		std::memcpy(Slot.Strings + Offset, Value, Length);
+		Slot.Strings[Offset + Length] = '\0';
+		Slot.StringBytes = static_cast<uint8_t>(std::min(Offset + Length + 1, MaxStringBytes - 1));
+
+		Slot.Types[Slot.NumArguments] = ArgumentType::String;
+		Slot.Values[Slot.NumArguments++] = static_cast<uint64_t>(Offset);
+	}
+
+	void AddArgument(Message& Slot, const void* Value)
+	{
+		Slot.Types[Slot.NumArguments] = ArgumentType::Pointer;
+		Slot.Values[Slot.NumArguments++] = reinterpret_cast<uintptr_t>(Value);
+	}
+
+	void EndMessage(Message& Slot)
+	{
+		//Still the claimed position, nobody else touches the sequence until it is published
+		Slot.Sequence.store(Slot.Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+
+// Asynchronous logging.
+// LOG_* claims a slot of a bounded lock-free ring shared by every thread,
+// copies the timestamp, the format and the arguments into it, and returns.
+// A background thread drains the ring, formats the lines with stb_sprintf
+// and writes them to a file or to stderr, so logging neither formats nor
+// blocks on I/O on the calling thread. When the ring is full the message is
+// dropped and counted instead of waiting for the writer.
+//
+// The format must be a string literal, it is read later by the writer.
+// String arguments are copied. Each conversion reads its argument as the
+// type it expects, so %d of a float or %f of an int still print a number.
+//
+// Levels below BLUEPLANET_LOG_LEVEL are removed at compile time, their
+// arguments are not even evaluated.
+namespace Log
+{
+	enum class Level : uint8_t
+	{
+		Trace,
+		Debug,
+		Info,
+		Warning,
+		Error
+	};
+
+	// Arguments of one message, and bytes kept for its string arguments
+	constexpr int MaxArguments = 8;
+	constexpr int MaxStringBytes = 128;
+
+	// Messages that can wait for the writer thread, a power of two
+	constexpr uint32_t RingSize = 1024;
+
+	// Start the writer thread. Lines go to FilePath, or to stderr when it is empty
+	void Initialize(const char* FilePath);
+
+	// Write the pending messages and stop the writer thread
+	void Shutdown();
+
+	// Wait until the writer thread has written every message logged so far
+	void Flush();
+
+	// Messages lost because the ring was full
+	uint64_t GetNumDropped();
+
+	struct Message;
+
+	// Claim a slot, nullptr if the ring is full
+	Message* BeginMessage(Level Severity, const char* Format);
+
+	void AddArgument(Message& Slot, int64_t Value);
+	void AddArgument(Message& Slot, uint64_t Value);
+	void AddArgument(Message& Slot, double Value);
+	void AddArgument(Message& Slot, const char* Value);
+	void AddArgument(Message& Slot, const void* Value);
+
+	// Publish the message to the writer thread
+	void EndMessage(Message& Slot);
+
+	template <typename Type>
+	typename std::enable_if<std::is_integral<Type>::value || std::is_enum<Type>::value>::type
+	Capture(Message& Slot, Type Value)
+	{
+		if (std::is_signed<Type>::value)
+		{
+			AddArgument(Slot, static_cast<int64_t>(Value));
+		}
+		else
+		{
+			AddArgument(Slot, static_cast<uint64_t>(Value));
+		}
+	}
+
+	template <typename Type>
+	typename std::enable_if<std::is_floating_point<Type>::value>::type
+	Capture(Message& Slot, Type Value)
+	{
+		AddArgument(Slot, static_cast<double>(Value));
+	}
+
+	inline void Capture(Message& Slot, const char* Value)
+	{
+		AddArgument(Slot, Value);
+	}
+
+	template <typename Type>
+	typename std::enable_if<!std::is_same<typename std::remove_cv<Type>::type, char>::value>::type
+	Capture(Message& Slot, Type* Value)
+	{
+		AddArgument(Slot, static_cast<const void*>(Value));
+	}
+
+	template <typename... Arguments>
+	void Write(Level Severity, const char* Format, const Arguments&... Values)
+	{
+		static_assert(sizeof...(Arguments) <= MaxArguments, "Too many log arguments");
+
+		if (Message* Slot = BeginMessage(Severity, Format))
+		{
+			(void)std::initializer_list<int>{ (Capture(*Slot, Values), 0)... };
+			EndMessage(*Slot);
+		}
+	}
+}
+
+#ifndef BLUEPLANET_LOG_LEVEL
+#define BLUEPLANET_LOG_LEVEL 1
+#endif
+
+#if BLUEPLANET_LOG_LEVEL <= 0
+#define LOG_TRACE(...) Log::Write(Log::Level::Trace, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) ((void)0)
+#endif
+
+#if BLUEPLANET_LOG_LEVEL <= 1
+#define LOG_DEBUG(...) Log::Write(Log::Level::Debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if BLUEPLANET_LOG_LEVEL <= 2
+#define LOG_INFO(...) Log::Write(Log::Level::Info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if BLUEPLANET_LOG_LEVEL <= 3
+#define LOG_WARNING(...) Log::Write(Log::Level::Warning, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) ((void)0)
+#endif
+
+#define LOG_ERROR(...) Log::Write(Log::Level::Error, __VA_ARGS__)
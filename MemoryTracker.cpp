@@ -0,0 +1,302 @@
+#include "MemoryTracker.h"
+
+#if defined(BLUEPLANET_TRACK_ALLOCATIONS) && BLUEPLANET_TRACK_ALLOCATIONS
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+namespace
+{
+	constexpr int NumTags = static_cast<int>(MemoryTracker::Tag::NumTags);
+
+	// Seconds between two frame churn reports
+	constexpr double ReportInterval = 2.0;
+
+	// Stored in front of every block, keeps the alignment malloc guarantees
+	struct alignas(alignof(std::max_align_t)) BlockHeader
+	{
+		uint64_t Size;
+		MemoryTracker::Tag Owner;
+	};
+
+	// Atomic so allocations from every thread can be counted without a lock.
+	// Plain zero initialized storage, operator new may run before main
+	struct TagCounters
+	{
+		std::atomic<uint64_t> Allocations;
+		std::atomic<uint64_t> Frees;
+		std::atomic<uint64_t> LiveBytes;
+		std::atomic<uint64_t> PeakBytes;
+		std::atomic<uint64_t> TotalBytes;
+	};
+
+	TagCounters Counters[NumTags];
+
+	thread_local MemoryTracker::Tag CurrentTag = MemoryTracker::Tag::Untagged;
+
+	// Main loop state, only touched by the thread calling EndFrame
+	std::array<uint64_t, NumTags> WindowAllocations{};
+	std::array<uint64_t, NumTags> WindowBytes{};
+	uint64_t PreviousFrameAllocations = 0;
+	uint32_t WindowFrames = 0;
+	uint32_t FramesWithAllocations = 0;
+	double LastReport = -1.0;
+
+	void RecordAllocation(MemoryTracker::Tag Owner, uint64_t Size)
+	{
+		TagCounters& Tag = Counters[static_cast<int>(Owner)];
+		Tag.Allocations.fetch_add(1, std::memory_order_relaxed);
+		Tag.TotalBytes.fetch_add(Size, std::memory_order_relaxed);
+
+		const uint64_t Live = Tag.LiveBytes.fetch_add(Size, std::memory_order_relaxed) + Size;
+		uint64_t Peak = Tag.PeakBytes.load(std::memory_order_relaxed);
+		while (Live > Peak && !Tag.PeakBytes.compare_exchange_weak(Peak, Live, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void RecordFree(MemoryTracker::Tag Owner, uint64_t Size)
+	{
+		TagCounters& Tag = Counters[static_cast<int>(Owner)];
+		Tag.Frees.fetch_add(1, std::memory_order_relaxed);
+		Tag.LiveBytes.fetch_sub(Size, std::memory_order_relaxed);
+	}
+
+	uint64_t SumAllocations()
+	{
+		uint64_t Sum = 0;
+		for (const TagCounters& Tag : Counters)
+		{
+			Sum += Tag.Allocations.load(std::memory_order_relaxed);
+		}
+		return Sum;
+	}
+
+	void StartWindow()
+	{
+		for (int Index = 0; Index < NumTags; ++Index)
+		{
+			WindowAllocations[Index] = Counters[Index].Allocations.load(std::memory_order_relaxed);
+			WindowBytes[Index] = Counters[Index].TotalBytes.load(std::memory_order_relaxed);
+		}
+		WindowFrames = 0;
+		FramesWithAllocations = 0;
+	}
+}
+
+namespace MemoryTracker
+{
+	const char* GetTagName(Tag Which)
+	{
+		switch (Which)
+		{
+		case Tag::Untagged: return "untagged";
+		case Tag::Mesh: return "mesh";
+		case Tag::Texture: return "texture";
+		case Tag::Shader: return "shader";
+		case Tag::Frame: return "frame";
+		default: return "unknown";
+		}
+	}
+
+	Tag GetCurrentTag()
+	{
+		return CurrentTag;
+	}
+
+	Tag SetCurrentTag(Tag Which)
+	{
+		const Tag Previous = CurrentTag;
+		CurrentTag = Which;
+		return Previous;
+	}
+
+	void* Allocate(size_t Size)
+	{
+		BlockHeader* Header = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + Size));
+		if (Header == nullptr)
+		{
+			return nullptr;
+		}
+
+		Header->Size = Size;
+		Header->Owner = CurrentTag;
+		RecordAllocation(Header->Owner, Size);
+
+		return Header + 1;
+	}
+
+	void* Reallocate(void* Pointer, size_t Size)
+	{
+		if (Pointer == nullptr)
+		{
+			return Allocate(Size);
+		}
+
+		BlockHeader* Header = static_cast<BlockHeader*>(Pointer) - 1;
+		const BlockHeader Previous = *Header;
+
+		BlockHeader* NewHeader = static_cast<BlockHeader*>(std::realloc(Header, sizeof(BlockHeader) + Size));
+		if (NewHeader == nullptr)
+		{
+			return nullptr;
+		}
+
+		//Counted as a free of the old block and an allocation of the new one
+		RecordFree(Previous.Owner, Previous.Size);
+		NewHeader->Size = Size;
+		NewHeader->Owner = CurrentTag;
+		RecordAllocation(NewHeader->Owner, Size);
+
+		return NewHeader + 1;
+	}
+
+	void Free(void* Pointer)
+	{
+		if (Pointer == nullptr)
+		{
+			return;
+		}
+
+		BlockHeader* Header = static_cast<BlockHeader*>(Pointer) - 1;
+		RecordFree(Header->Owner, Header->Size);
+		std::free(Header);
+	}
+
+	TagStatistics GetStatistics(Tag Which)
+	{
+		const TagCounters& Tag = Counters[static_cast<int>(Which)];
+
+		TagStatistics Statistics;
+		Statistics.Allocations = Tag.Allocations.load(std::memory_order_relaxed);
+		Statistics.Frees = Tag.Frees.load(std::memory_order_relaxed);
+		Statistics.LiveBytes = Tag.LiveBytes.load(std::memory_order_relaxed);
+		Statistics.PeakBytes = Tag.PeakBytes.load(std::memory_order_relaxed);
+		Statistics.TotalBytes = Tag.TotalBytes.load(std::memory_order_relaxed);
+		return Statistics;
+	}
+
+	void EndFrame(double Now)
+	{
+		const uint64_t FrameAllocations = SumAllocations();
+
+		if (LastReport < 0.0)
+		{
+			LastReport = Now;
+			PreviousFrameAllocations = FrameAllocations;
+			StartWindow();
+			return;
+		}
+
+		++WindowFrames;
+		FramesWithAllocations += FrameAllocations != PreviousFrameAllocations ? 1 : 0;
+		PreviousFrameAllocations = FrameAllocations;
+
+		if (Now - LastReport < ReportInterval)
+		{
+			return;
+		}
+
+		std::cout << "Heap: " << FramesWithAllocations << " of " << WindowFrames << " frames allocated";
+
+		//Only the tags that allocated during the window
+		for (int Index = 0; Index < NumTags; ++Index)
+		{
+			const uint64_t Allocations = Counters[Index].Allocations.load(std::memory_order_relaxed) - WindowAllocations[Index];
+			const uint64_t Bytes = Counters[Index].TotalBytes.load(std::memory_order_relaxed) - WindowBytes[Index];
+			if (Allocations > 0)
+			{
+				std::cout << ", " << GetTagName(static_cast<Tag>(Index)) << " " << std::fixed << std::setprecision(2)
+					<< static_cast<double>(Allocations) / WindowFrames << " allocs/frame " << std::setprecision(1)
+					<< static_cast<double>(Bytes) / WindowFrames << " bytes/frame";
+			}
+		}
+		std::cout << std::endl;
+
+		LastReport = Now;
+		StartWindow();
+	}
+
+	void PrintReport()
+	{
+		std::cout << "Heap allocations by tag:" << std::endl;
+
+		for (int Index = 0; Index < NumTags; ++Index)
+		{
+			const TagStatistics Statistics = GetStatistics(static_cast<Tag>(Index));
+			if (Statistics.Allocations == 0)
+			{
+				continue;
+			}
+
+			std::cout << "    " << std::left << std::setw(10) << GetTagName(static_cast<Tag>(Index)) << std::right
+				<< " allocations " << std::setw(8) << Statistics.Allocations
+				<< " live " << std::setw(10) << std::fixed << std::setprecision(1) << Statistics.LiveBytes / 1024.0 << " KB"
+				<< " peak " << std::setw(10) << Statistics.PeakBytes / 1024.0 << " KB"
+				<< " total " << std::setw(10) << Statistics.TotalBytes / 1024.0 << " KB" << std::endl;
+		}
+	}
+}
+
+// Replacements of the global allocation functions. The aligned overloads
+// are left to the standard library, they pair with their own deletes
+void* operator new(std::size_t Size)
+{
+	void* Pointer = MemoryTracker::Allocate(Size);
+	if (Pointer == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return Pointer;
+}
+
+void* operator new[](std::size_t Size)
+{
+	return operator new(Size);
+}
+
+void* operator new(std::size_t Size, const std::nothrow_t&) noexcept
+{
+	return MemoryTracker::Allocate(Size);
+}
+
+void* operator new[](std::size_t Size, const std::nothrow_t&) noexcept
+{
+	return MemoryTracker::Allocate(Size);
+}
+
+void operator delete(void* Pointer) noexcept
+{
+	MemoryTracker::Free(Pointer);
+}
+
+void operator delete[](void* Pointer) noexcept
+{
+	MemoryTracker::Free(Pointer);
+}
+
+void operator delete(void* Pointer, std::size_t) noexcept
+{
+	MemoryTracker::Free(Pointer);
+}
+
+void operator delete[](void* Pointer, std::size_t) noexcept
+{
+	MemoryTracker::Free(Pointer);
+}
+
+void operator delete(void* Pointer, const std::nothrow_t&) noexcept
+{
+	MemoryTracker::Free(Pointer);
+}
+
+void operator delete[](void* Pointer, const std::nothrow_t&) noexcept
+{
+	MemoryTracker::Free(Pointer);
+}
+
+#endif
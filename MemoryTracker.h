@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Heap allocation tracking per subsystem.
+// Every allocation made through operator new, or through stb_image, is
+// attributed to the tag of the innermost MEMORY_TAG scope of the calling
+// thread. Counts, live bytes, peak and total bytes are kept per tag, and
+// MEMORY_END_FRAME() measures how much the frame loop allocates so the steady
+// state can be shown to allocate nothing.
+//
+// Unless BLUEPLANET_TRACK_ALLOCATIONS is defined the global operator new is
+// not replaced and the MEMORY_* macros expand to nothing.
+namespace MemoryTracker
+{
+	enum class Tag : uint8_t
+	{
+		Untagged,
+		Mesh,
+		Texture,
+		Shader,
+		Frame,
+		NumTags
+	};
+
+	const char* GetTagName(Tag Which);
+
+	// Tag of the innermost scope of the calling thread
+	Tag GetCurrentTag();
+	Tag SetCurrentTag(Tag Which);
+
+	class TagScope
+	{
+	public:
+		explicit TagScope(Tag Which)
+			: Previous(SetCurrentTag(Which))
+		{
+		}
+
+		~TagScope()
+		{
+			SetCurrentTag(Previous);
+		}
+
+		TagScope(const TagScope&) = delete;
+		TagScope& operator=(const TagScope&) = delete;
+
+	private:
+		Tag Previous;
+	};
+
+	// Tracked malloc, used by operator new and the stb_image hooks
+	void* Allocate(size_t Size);
+	void* Reallocate(void* Pointer, size_t Size);
+	void Free(void* Pointer);
+
+	struct TagStatistics
+	{
+		uint64_t Allocations = 0;
+		uint64_t Frees = 0;
+		uint64_t LiveBytes = 0;
+		uint64_t PeakBytes = 0;
+		uint64_t TotalBytes = 0;
+	};
+
+	TagStatistics GetStatistics(Tag Which);
+
+	// Close a frame of the main loop and print the per frame churn once
+	// every ReportInterval seconds, Now as returned by glfwGetTime()
+	void EndFrame(double Now);
+
+	// Print the statistics of every tag
+	void PrintReport();
+}
+
+#if defined(BLUEPLANET_TRACK_ALLOCATIONS) && BLUEPLANET_TRACK_ALLOCATIONS
+#define MEMORY_CONCAT_INNER(A, B) A##B
+#define MEMORY_CONCAT(A, B) MEMORY_CONCAT_INNER(A, B)
+#define MEMORY_TAG(Which) MemoryTracker::TagScope MEMORY_CONCAT(MemoryTag, __LINE__)(MemoryTracker::Tag::Which)
+#define MEMORY_END_FRAME(Now) MemoryTracker::EndFrame(Now)
+#define MEMORY_REPORT() MemoryTracker::PrintReport()
+#else
+#define MEMORY_TAG(Which)
+#define MEMORY_END_FRAME(Now)
+#define MEMORY_REPORT()
+#endif
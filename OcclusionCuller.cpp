@@ -0,0 +1,338 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <glm/gtc/constants.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_CULLER_SSE 1
+#include <emmintrin.h>
+#else
+#define OCCLUSION_CULLER_SSE 0
+#endif
+
+namespace
+{
+	// Above this many texels per test we stop refining and accept the object
+	constexpr int MaxTexelsPerTest = 64;
+
+	struct DepthRange
+	{
+		float Min = FLT_MAX;
+		float Max = 0.0f;
+	};
+}
+
+OcclusionCuller::OcclusionCuller()
+{
+	int LevelWidth = BufferWidth;
+	int LevelHeight = BufferHeight;
+
+	while (true)
+	{
+		DepthLevel Level;
+		Level.Width = LevelWidth;
+		Level.Height = LevelHeight;
+		Level.MaxDepth.resize(LevelWidth * LevelHeight, FLT_MAX);
+
+		//Level 0 is a plain depth buffer, min and max are the same value
+		if (!Levels.empty())
+		{
+			Level.MinDepth.resize(LevelWidth * LevelHeight, FLT_MAX);
+		}
+
+		Levels.push_back(std::move(Level));
+
+		if (LevelWidth == 1 || LevelHeight == 1)
+		{
+			break;
+		}
+
+		LevelWidth /= 2;
+		LevelHeight /= 2;
+	}
+
+	Occluders.reserve(64);
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& View, const glm::mat4& Projection, float Near)
+{
+	ViewMatrix = View;
+	ProjectionMatrix = Projection;
+	NearPlane = Near;
+
+	Occluders.clear();
+	Stats = Statistics{};
+
+	std::fill(Levels[0].MaxDepth.begin(), Levels[0].MaxDepth.end(), FLT_MAX);
+}
+
+void OcclusionCuller::AddSphereOccluder(const glm::vec3& Center, float Radius)
+{
+	++Stats.OccluderCandidates;
+
+	const glm::vec4 ViewCenter = ViewMatrix * glm::vec4{ Center, 1.0f };
+	const float Depth = -ViewCenter.z;
+
+	//Camera inside or too close to the occluder, nothing conservative to rasterize
+	if (Depth - Radius <= NearPlane)
+	{
+		return;
+	}
+
+	const glm::vec4 ClipCenter = ProjectionMatrix * ViewCenter;
+	const glm::vec2 NDCCenter = glm::vec2{ ClipCenter } / ClipCenter.w;
+
+	// A sphere projects to an ellipse that always contains the disc of
+	// radius R / Depth, and every visible point of the sphere is closer than
+	// its center, so writing the center depth inside that disc is conservative
+	const glm::vec2 NDCRadius = glm::vec2{ ProjectionMatrix[0][0], ProjectionMatrix[1][1] } * (Radius / Depth);
+
+	const glm::vec2 BufferSize{ BufferWidth, BufferHeight };
+
+	Occluder Disc;
+	Disc.ScreenCenter = (NDCCenter * 0.5f + 0.5f) * BufferSize;
+	Disc.ScreenRadius = NDCRadius * 0.5f * BufferSize;
+	Disc.Depth = Depth;
+	Disc.Area = glm::pi<float>() * Disc.ScreenRadius.x * Disc.ScreenRadius.y;
+
+	//Fully outside of the buffer
+	if (Disc.ScreenCenter.x + Disc.ScreenRadius.x < 0.0f || Disc.ScreenCenter.x - Disc.ScreenRadius.x > BufferSize.x ||
+		Disc.ScreenCenter.y + Disc.ScreenRadius.y < 0.0f || Disc.ScreenCenter.y - Disc.ScreenRadius.y > BufferSize.y)
+	{
+		return;
+	}
+
+	Occluders.push_back(Disc);
+}
+
+void OcclusionCuller::BuildHierarchy()
+{
+	//Keep only the largest occluders, small ones hide almost nothing
+	const size_t NumOccluders = std::min<size_t>(Occluders.size(), MaxOccluders);
+	std::partial_sort(Occluders.begin(), Occluders.begin() + NumOccluders, Occluders.end(),
+		[](const Occluder& A, const Occluder& B) { return A.Area > B.Area; });
+
+	for (size_t Index = 0; Index < NumOccluders; ++Index)
+	{
+		RasterizeOccluder(Occluders[Index]);
+	}
+
+	Stats.OccludersRasterized = static_cast<int>(NumOccluders);
+
+	for (size_t Level = 1; Level < Levels.size(); ++Level)
+	{
+		DownsampleLevel(Levels[Level - 1], Levels[Level]);
+	}
+}
+
+void OcclusionCuller::RasterizeOccluder(const Occluder& Disc)
+{
+	const glm::vec2 InvRadius = 1.0f / Disc.ScreenRadius;
+
+	const int MinY = std::max(0, static_cast<int>(std::floor(Disc.ScreenCenter.y - Disc.ScreenRadius.y)));
+	const int MaxY = std::min(BufferHeight - 1, static_cast<int>(std::ceil(Disc.ScreenCenter.y + Disc.ScreenRadius.y)));
+
+	//Align the span start to the SIMD width. BufferWidth is a multiple of 4 so the span never runs past the row
+	const int MinX = std::max(0, static_cast<int>(std::floor(Disc.ScreenCenter.x - Disc.ScreenRadius.x))) & ~3;
+	const int MaxX = std::min(BufferWidth - 1, static_cast<int>(std::ceil(Disc.ScreenCenter.x + Disc.ScreenRadius.x)));
+
+	float* DepthBuffer = Levels[0].MaxDepth.data();
+
+	for (int Y = MinY; Y <= MaxY; ++Y)
+	{
+		const float DY = (Y + 0.5f - Disc.ScreenCenter.y) * InvRadius.y;
+		const float DY2 = DY * DY;
+
+		if (DY2 > 1.0f)
+		{
+			continue;
+		}
+
+		float* Row = DepthBuffer + Y * BufferWidth;
+
+#if OCCLUSION_CULLER_SSE
+		const __m128 CenterX = _mm_set1_ps(Disc.ScreenCenter.x);
+		const __m128 InvRadiusX = _mm_set1_ps(InvRadius.x);
+		const __m128 Threshold = _mm_set1_ps(1.0f - DY2);
+		const __m128 Depth = _mm_set1_ps(Disc.Depth);
+		const __m128 LaneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+		for (int X = MinX; X <= MaxX; X += 4)
+		{
+			const __m128 PixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(X)), LaneOffsets);
+			const __m128 DX = _mm_mul_ps(_mm_sub_ps(PixelX, CenterX), InvRadiusX);
+			const __m128 Inside = _mm_cmple_ps(_mm_mul_ps(DX, DX), Threshold);
+
+			const __m128 OldDepth = _mm_loadu_ps(Row + X);
+			const __m128 NewDepth = _mm_min_ps(OldDepth, Depth);
+
+			_mm_storeu_ps(Row + X, _mm_or_ps(_mm_and_ps(Inside, NewDepth), _mm_andnot_ps(Inside, OldDepth)));
+		}
+#else
+		for (int X = MinX; X <= MaxX; ++X)
+		{
+			const float DX = (X + 0.5f - Disc.ScreenCenter.x) * InvRadius.x;
+			if (DX * DX + DY2 <= 1.0f)
+			{
+				Row[X] = std::min(Row[X], Disc.Depth);
+			}
+		}
+#endif
+	}
+}
+
+void OcclusionCuller::DownsampleLevel(const DepthLevel& Source, DepthLevel& Target)
+{
+	//Level 0 only stores a single depth per pixel
+	const float* SourceMin = Source.MinDepth.empty() ? Source.MaxDepth.data() : Source.MinDepth.data();
+	const float* SourceMax = Source.MaxDepth.data();
+
+	for (int Y = 0; Y < Target.Height; ++Y)
+	{
+		const int Row0 = (2 * Y) * Source.Width;
+		const int Row1 = (2 * Y + 1) * Source.Width;
+
+		float* TargetMin = Target.MinDepth.data() + Y * Target.Width;
+		float* TargetMax = Target.MaxDepth.data() + Y * Target.Width;
+
+		int X = 0;
+
+#if OCCLUSION_CULLER_SSE
+		//Four target texels (eight source columns) per iteration
+		for (; X + 4 <= Target.Width; X += 4)
+		{
+			const int SourceX = 2 * X;
+
+			__m128 MinA = _mm_min_ps(_mm_loadu_ps(SourceMin + Row0 + SourceX), _mm_loadu_ps(SourceMin + Row1 + SourceX));
+			__m128 MinB = _mm_min_ps(_mm_loadu_ps(SourceMin + Row0 + SourceX + 4), _mm_loadu_ps(SourceMin + Row1 + SourceX + 4));
+			__m128 MaxA = _mm_max_ps(_mm_loadu_ps(SourceMax + Row0 + SourceX), _mm_loadu_ps(SourceMax + Row1 + SourceX));
+			__m128 MaxB = _mm_max_ps(_mm_loadu_ps(SourceMax + Row0 + SourceX + 4), _mm_loadu_ps(SourceMax + Row1 + SourceX + 4));
+
+			const __m128 Min = _mm_min_ps(
+				_mm_shuffle_ps(MinA, MinB, _MM_SHUFFLE(2, 0, 2, 0)),
+				_mm_shuffle_ps(MinA, MinB, _MM_SHUFFLE(3, 1, 3, 1)));
+			const __m128 Max = _mm_max_ps(
+				_mm_shuffle_ps(MaxA, MaxB, _MM_SHUFFLE(2, 0, 2, 0)),
+				_mm_shuffle_ps(MaxA, MaxB, _MM_SHUFFLE(3, 1, 3, 1)));
+
+			_mm_storeu_ps(TargetMin + X, Min);
+			_mm_storeu_ps(TargetMax + X, Max);
+		}
+#endif
+
+		for (; X < Target.Width; ++X)
+		{
+			const int SourceX = 2 * X;
+
+			TargetMin[X] = std::min(
+				std::min(SourceMin[Row0 + SourceX], SourceMin[Row0 + SourceX + 1]),
+				std::min(SourceMin[Row1 + SourceX], SourceMin[Row1 + SourceX + 1]));
+			TargetMax[X] = std::max(
+				std::max(SourceMax[Row0 + SourceX], SourceMax[Row0 + SourceX + 1]),
+				std::max(SourceMax[Row1 + SourceX], SourceMax[Row1 + SourceX + 1]));
+		}
+	}
+}
+
+bool OcclusionCuller::IsSphereVisible(const glm::vec3& Center, float Radius)
+{
+	++Stats.Tested;
+
+	if (Stats.OccludersRasterized == 0)
+	{
+		return true;
+	}
+
+	const glm::vec4 ViewCenter = ViewMatrix * glm::vec4{ Center, 1.0f };
+	const float Depth = -ViewCenter.z;
+	const float NearestDepth = Depth - Radius;
+
+	//Crossing the near plane, always visible
+	if (NearestDepth <= NearPlane)
+	{
+		return true;
+	}
+
+	// Conservative screen bounds from the view space bounding box of the
+	// sphere. x / z is monotonic over the box so its corners give the extremes
+	const float NearZ = NearestDepth;
+	const float FarZ = Depth + Radius;
+
+	const float CandidatesX[4] = {
+		(ViewCenter.x - Radius) / NearZ, (ViewCenter.x - Radius) / FarZ,
+		(ViewCenter.x + Radius) / NearZ, (ViewCenter.x + Radius) / FarZ };
+	const float CandidatesY[4] = {
+		(ViewCenter.y - Radius) / NearZ, (ViewCenter.y - Radius) / FarZ,
+		(ViewCenter.y + Radius) / NearZ, (ViewCenter.y + Radius) / FarZ };
+
+	const glm::vec2 NDCMin{
+		ProjectionMatrix[0][0] * *std::min_element(CandidatesX, CandidatesX + 4),
+		ProjectionMatrix[1][1] * *std::min_element(CandidatesY, CandidatesY + 4) };
+	const glm::vec2 NDCMax{
+		ProjectionMatrix[0][0] * *std::max_element(CandidatesX, CandidatesX + 4),
+		ProjectionMatrix[1][1] * *std::max_element(CandidatesY, CandidatesY + 4) };
+
+	//Outside of the view frustum sides
+	if (NDCMax.x < -1.0f || NDCMin.x > 1.0f || NDCMax.y < -1.0f || NDCMin.y > 1.0f)
+	{
+		++Stats.Culled;
+		return false;
+	}
+
+	const int MinX = std::max(0, static_cast<int>((NDCMin.x * 0.5f + 0.5f) * BufferWidth));
+	const int MaxX = std::min(BufferWidth - 1, static_cast<int>((NDCMax.x * 0.5f + 0.5f) * BufferWidth));
+	const int MinY = std::max(0, static_cast<int>((NDCMin.y * 0.5f + 0.5f) * BufferHeight));
+	const int MaxY = std::min(BufferHeight - 1, static_cast<int>((NDCMax.y * 0.5f + 0.5f) * BufferHeight));
+
+	//Start from the finest level where the bounds cover at most 2x2 texels
+	int Level = 0;
+	while (Level + 1 < static_cast<int>(Levels.size()) &&
+		((MaxX >> Level) - (MinX >> Level) > 1 || (MaxY >> Level) - (MinY >> Level) > 1))
+	{
+		++Level;
+	}
+
+	while (true)
+	{
+		const DepthLevel& Current = Levels[Level];
+		const float* MinDepth = Current.MinDepth.empty() ? Current.MaxDepth.data() : Current.MinDepth.data();
+
+		DepthRange Range;
+		for (int Y = MinY >> Level; Y <= (MaxY >> Level); ++Y)
+		{
+			for (int X = MinX >> Level; X <= (MaxX >> Level); ++X)
+			{
+				Range.Min = std::min(Range.Min, MinDepth[Y * Current.Width + X]);
+				Range.Max = std::max(Range.Max, Current.MaxDepth[Y * Current.Width + X]);
+			}
+		}
+
+		//Behind every occluder covering the bounds
+		if (NearestDepth > Range.Max)
+		{
+			++Stats.Culled;
+			return false;
+		}
+
+		//In front of everything rasterized there
+		if (NearestDepth <= Range.Min || Level == 0)
+		{
+			return true;
+		}
+
+		//Refine one level down while the texel count stays small
+		const int FinerTexels =
+			((MaxX >> (Level - 1)) - (MinX >> (Level - 1)) + 1) *
+			((MaxY >> (Level - 1)) - (MinY >> (Level - 1)) + 1);
+
+		if (FinerTexels > MaxTexelsPerTest)
+		{
+			return true;
+		}
+
+		--Level;
+	}
+}
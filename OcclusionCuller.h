@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// CPU occlusion culler.
+// The largest occluders are rasterized as conservative discs into a small
+// linear depth buffer, a min/max depth hierarchy is built from it and the
+// remaining objects are tested against that hierarchy before being drawn.
+// Everything runs on the CPU, no GPU readback is involved.
+class OcclusionCuller
+{
+public:
+
+	// Depth buffer resolution. Width must be a multiple of 4 (SIMD lanes)
+	// and both dimensions powers of two so the hierarchy halves cleanly
+	static constexpr int BufferWidth = 256;
+	static constexpr int BufferHeight = 128;
+
+	// Only the largest occluders (by projected area) are rasterized
+	static constexpr int MaxOccluders = 16;
+
+	struct Statistics
+	{
+		int OccluderCandidates = 0;
+		int OccludersRasterized = 0;
+		int Tested = 0;
+		int Culled = 0;
+	};
+
+	OcclusionCuller();
+
+	// Start a new frame. Clears the depth buffer and the occluder list
+	void BeginFrame(const glm::mat4& View, const glm::mat4& Projection, float Near);
+
+	// Register a sphere in world space as occluder candidate
+	void AddSphereOccluder(const glm::vec3& Center, float Radius);
+
+	// Rasterize the selected occluders and build the min/max depth hierarchy
+	void BuildHierarchy();
+
+	// Returns false only if the sphere is guaranteed to be hidden
+	bool IsSphereVisible(const glm::vec3& Center, float Radius);
+
+	const Statistics& GetStatistics() const { return Stats; }
+
+private:
+
+	struct Occluder
+	{
+		glm::vec2 ScreenCenter; // In buffer pixels
+		glm::vec2 ScreenRadius; // In buffer pixels
+		float Depth;            // Linear view depth
+		float Area;
+	};
+
+	struct DepthLevel
+	{
+		int Width = 0;
+		int Height = 0;
+		std::vector<float> MinDepth;
+		std::vector<float> MaxDepth;
+	};
+
+	void RasterizeOccluder(const Occluder& Disc);
+	void DownsampleLevel(const DepthLevel& Source, DepthLevel& Target);
+
+	glm::mat4 ViewMatrix{ 1.0f };
+	glm::mat4 ProjectionMatrix{ 1.0f };
+	float NearPlane = 0.01f;
+
+	std::vector<Occluder> Occluders;
+
+	// Level 0 is the full resolution depth buffer (MinDepth == MaxDepth)
+	std::vector<DepthLevel> Levels;
+
+	Statistics Stats;
+};
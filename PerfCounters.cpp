@@ -0,0 +1,145 @@
+#include "PerfCounters.h"
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#if defined(__linux__)
+	struct CounterConfig
+	{
+		uint32_t Type;
+		uint64_t Config;
+	};
+
+	constexpr uint64_t CacheMissConfig(uint64_t Cache)
+	{
+		return Cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	}
+
+	const CounterConfig Configs[PerfCounters::NumCounters] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, CacheMissConfig(PERF_COUNT_HW_CACHE_L1D) },
+		{ PERF_TYPE_HW_CACHE, CacheMissConfig(PERF_COUNT_HW_CACHE_LL) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+
+	int OpenCounter(const CounterConfig& Config)
+	{
+		perf_event_attr Attributes;
+		std::memset(&Attributes, 0, sizeof(Attributes));
+		Attributes.size = sizeof(Attributes);
+		Attributes.type = Config.Type;
+		Attributes.config = Config.Config;
+		Attributes.disabled = 1;
+		Attributes.exclude_kernel = 1;
+		Attributes.exclude_hv = 1;
+		Attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		//This thread, any CPU, no group
+		return static_cast<int>(syscall(SYS_perf_event_open, &Attributes, 0, -1, -1, 0));
+	}
+#endif
+}
+
+PerfCounters::PerfCounters()
+{
+	Descriptors.fill(-1);
+
+#if defined(__linux__)
+	for (int Index = 0; Index < NumCounters; ++Index)
+	{
+		Descriptors[Index] = OpenCounter(Configs[Index]);
+	}
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+	for (int Descriptor : Descriptors)
+	{
+		if (Descriptor >= 0)
+		{
+			close(Descriptor);
+		}
+	}
+#endif
+}
+
+bool PerfCounters::IsAvailable() const
+{
+	for (int Descriptor : Descriptors)
+	{
+		if (Descriptor >= 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* PerfCounters::GetName(Counter Which)
+{
+	switch (Which)
+	{
+	case Cycles: return "cycles";
+	case Instructions: return "instructions";
+	case L1DataMisses: return "l1d_misses";
+	case LastLevelCacheMisses: return "llc_misses";
+	case BranchMisses: return "branch_misses";
+	default: return "unknown";
+	}
+}
+
+void PerfCounters::Start()
+{
+#if defined(__linux__)
+	for (int Descriptor : Descriptors)
+	{
+		if (Descriptor >= 0)
+		{
+			ioctl(Descriptor, PERF_EVENT_IOC_RESET, 0);
+			ioctl(Descriptor, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+}
+
+PerfCounters::Sample PerfCounters::Stop()
+{
+	Sample Result;
+
+#if defined(__linux__)
+	for (int Index = 0; Index < NumCounters; ++Index)
+	{
+		if (Descriptors[Index] >= 0)
+		{
+			ioctl(Descriptors[Index], PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+
+	for (int Index = 0; Index < NumCounters; ++Index)
+	{
+		//Value, time enabled, time running
+		uint64_t Values[3] = {};
+		if (Descriptors[Index] < 0 || read(Descriptors[Index], Values, sizeof(Values)) != sizeof(Values) || Values[2] == 0)
+		{
+			continue;
+		}
+
+		//The kernel multiplexes when there are more events than hardware counters
+		const double Scale = static_cast<double>(Values[1]) / static_cast<double>(Values[2]);
+		Result.Values[Index] = static_cast<uint64_t>(Values[0] * Scale);
+		Result.bValid[Index] = true;
+	}
+#endif
+
+	return Result;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Hardware performance counters of the calling thread through Linux
+// perf_event_open: cycles, instructions, L1 data and last level cache
+// misses, branch misses. Counters the kernel refuses (containers, VMs,
+// perf_event_paranoid, other platforms) are simply reported as unavailable,
+// so callers can always fall back to wall time.
+class PerfCounters
+{
+public:
+
+	enum Counter
+	{
+		Cycles,
+		Instructions,
+		L1DataMisses,
+		LastLevelCacheMisses,
+		BranchMisses,
+		NumCounters
+	};
+
+	struct Sample
+	{
+		std::array<uint64_t, NumCounters> Values{};
+		std::array<bool, NumCounters> bValid{};
+
+		bool Has(Counter Which) const { return bValid[Which]; }
+		uint64_t Get(Counter Which) const { return Values[Which]; }
+	};
+
+	PerfCounters();
+	~PerfCounters();
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	// True if at least one counter could be opened
+	bool IsAvailable() const;
+
+	static const char* GetName(Counter Which);
+
+	void Start();
+
+	// Stop counting and return the values since Start(), scaled when the
+	// kernel had to multiplex the counters
+	Sample Stop();
+
+private:
+
+	std::array<int, NumCounters> Descriptors;
+};
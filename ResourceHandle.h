@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// Index of a slot in a table and the generation the slot had when the
+// handle was made. The table bumps the generation when the slot is freed, so
+// every copy of the handle goes stale at once instead of reaching whatever
+// reuses the slot. Checking a handle is one comparison. Tag only keeps the
+// handles of different tables apart, it is never defined.
+template<typename Tag>
+struct ResourceHandle
+{
+	uint32_t Index = 0;
+
+	// 0 is never given out, a default handle is invalid
+	uint32_t Generation = 0;
+
+	bool IsNull() const { return Generation == 0; }
+
+	bool operator==(const ResourceHandle& Other) const { return Index == Other.Index && Generation == Other.Generation; }
+	bool operator!=(const ResourceHandle& Other) const { return !(*this == Other); }
+};
+
+// Generation of a slot once it is freed. Wrapping skips 0, which would make
+// null handles valid
+inline uint32_t NextGeneration(uint32_t Generation)
+{
+	return Generation + 1 != 0 ? Generation + 1 : 1;
+}
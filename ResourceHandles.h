@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "GpuPools.h"
+#include "ResourceHandle.h"
+
+// Tables of GL objects referenced by ResourceHandle, in place of bare names.
+// The object behind a live handle can be replaced, when a shader is
+// recompiled or a texture streamed in again, and every holder of the handle
+// sees the new one on its next Resolve() without being told.
+//
+// Replaced and destroyed objects are deleted once the GPU finished the frame
+// they were released in, like the pooled ranges of GpuPools.h.
+struct ProgramTag;
+struct TextureTag;
+struct VertexArrayTag;
+
+using ProgramHandle = ResourceHandle<ProgramTag>;
+using TextureHandle = ResourceHandle<TextureTag>;
+using VertexArrayHandle = ResourceHandle<VertexArrayTag>;
+
+// Slots stored as parallel arrays: resolving reads one generation and one
+// name, the tables of a frame fit in a few cache lines. Only used by the
+// thread that owns the GL context
+template<typename Tag>
+class HandleTable
+{
+public:
+
+	using Handle = ResourceHandle<Tag>;
+	using Deleter = std::function<void(GLuint)>;
+
+	// Delete is called for every object released, once the GPU is done with it
+	explicit HandleTable(Deleter InDelete)
+		: Delete(std::move(InDelete))
+	{
+	}
+
+	~HandleTable()
+	{
+		PendingDeletes.ReleaseAll(Delete);
+
+		//Objects never destroyed stay to GpuResources, which reports them as leaks
+	}
+
+	HandleTable(const HandleTable&) = delete;
+	HandleTable& operator=(const HandleTable&) = delete;
+
+	// Take ownership of Name
+	Handle Create(GLuint Name)
+	{
+		uint32_t Index = 0;
+		if (!FreeIndexes.empty())
+		{
+			Index = FreeIndexes.back();
+			FreeIndexes.pop_back();
+		}
+		else
+		{
+			Index = static_cast<uint32_t>(Names.size());
+			Names.push_back(0);
+			Generations.push_back(1);
+		}
+
+		Names[Index] = Name;
+		++NumLive;
+		return Handle{ Index, Generations[Index] };
+	}
+
+	bool IsValid(Handle Resource) const
+	{
+		return Resource.Index < Generations.size() && Generations[Resource.Index] == Resource.Generation;
+	}
+
+	// The current object, 0 for a stale or null handle
+	GLuint Resolve(Handle Resource) const
+	{
+		return IsValid(Resource) ? Names[Resource.Index] : 0;
+	}
+
+	// Swap the object behind a live handle, the previous one is deleted later.
+	// False if the handle is stale, Name is not taken then
+	bool Replace(Handle Resource, GLuint Name)
+	{
+		if (!IsValid(Resource))
+		{
+			return false;
+		}
+
+		ReleaseName(Names[Resource.Index]);
+		Names[Resource.Index] = Name;
+		return true;
+	}
+
+	// Invalidate every copy of the handle and delete the object later.
+	// Stale and null handles are ignored
+	void Destroy(Handle Resource)
+	{
+		if (!IsValid(Resource))
+		{
+			return;
+		}
+
+		ReleaseName(Names[Resource.Index]);
+		Names[Resource.Index] = 0;
+
+		Generations[Resource.Index] = NextGeneration(Generations[Resource.Index]);
+
+		FreeIndexes.push_back(Resource.Index);
+		--NumLive;
+	}
+
+	// Fence the releases of the frame and delete the objects the GPU is done
+	// with, once per frame after its commands were submitted
+	void Update()
+	{
+		PendingDeletes.Fence();
+		PendingDeletes.Retire(Delete);
+	}
+
+	uint32_t GetNumLive() const { return NumLive; }
+	size_t GetNumPendingDeletes() const { return PendingDeletes.GetNumPending(); }
+
+private:
+
+	void ReleaseName(GLuint Name)
+	{
+		if (Name != 0)
+		{
+			PendingDeletes.Push(Name);
+		}
+	}
+
+	std::vector<GLuint> Names;
+	std::vector<uint32_t> Generations;
+	std::vector<uint32_t> FreeIndexes;
+	uint32_t NumLive = 0;
+
+	Deleter Delete;
+	DeferredFrees<GLuint> PendingDeletes;
+};
@@ -0,0 +1,51 @@
+#include "SimulationClock.h"
+
+#include <algorithm>
+#include <cassert>
+
+SimulationClock::SimulationClock(double FixedStep, int MaxStepsPerFrame, double MaxFrameTime)
+	: FixedStep(FixedStep)
+	, MaxStepsPerFrame(MaxStepsPerFrame)
+	, MaxFrameTime(MaxFrameTime)
+{
+	assert(FixedStep > 0.0);
+	assert(MaxStepsPerFrame > 0);
+}
+
+int SimulationClock::Advance(double RealDeltaTime)
+{
+	//A stall (breakpoint, window drag, loading) must not be replayed in full
+	const double ClampedDelta = std::min(std::max(RealDeltaTime, 0.0), MaxFrameTime);
+	DroppedTime += std::max(RealDeltaTime, 0.0) - ClampedDelta;
+
+	Accumulator += ClampedDelta;
+
+	int NumSteps = static_cast<int>(Accumulator / FixedStep);
+
+	//Catch-up limit: if we are too far behind, drop the excess instead of
+	//simulating even more steps next frame (spiral of death)
+	if (NumSteps > MaxStepsPerFrame)
+	{
+		DroppedTime += (NumSteps - MaxStepsPerFrame) * FixedStep;
+		NumSteps = MaxStepsPerFrame;
+	}
+
+	Accumulator -= static_cast<int>(Accumulator / FixedStep) * FixedStep;
+
+	return NumSteps;
+}
+
+void SimulationClock::Step()
+{
+	WorldTime += FixedStep * TimeWarp;
+}
+
+void SimulationClock::AdvanceIdle(double RealDeltaTime)
+{
+	WorldTime += std::max(RealDeltaTime, 0.0) * TimeWarp;
+}
+
+void SimulationClock::SetTimeWarp(double NewTimeWarp)
+{
+	TimeWarp = std::max(NewTimeWarp, 0.0);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Fixed timestep simulation clock.
+// Real frame time is accumulated and consumed in constant steps, so the
+// simulation cost and behaviour do not depend on the frame rate. The
+// leftover fraction of a step is exposed as an interpolation factor for
+// rendering. World time is kept in double precision and advances by the
+// time warp factor on every step, which is how orbital playback is sped up
+// without running more steps.
+class SimulationClock
+{
+public:
+
+	explicit SimulationClock(double FixedStep = 1.0 / 120.0, int MaxStepsPerFrame = 8, double MaxFrameTime = 0.25);
+
+	// Feed the real elapsed time of the frame. Returns how many fixed steps
+	// must be simulated, never more than MaxStepsPerFrame
+	int Advance(double RealDeltaTime);
+
+	// Mark one fixed step as simulated, advances the world time
+	void Step();
+
+	// Advance the world time directly while nothing else is simulated (idle,
+	// render on demand). Long waits are not subject to the catch-up limits
+	void AdvanceIdle(double RealDeltaTime);
+
+	// Fraction of a step left in the accumulator, in [0, 1)
+	double GetAlpha() const { return Accumulator / FixedStep; }
+
+	double GetFixedStep() const { return FixedStep; }
+
+	// Simulated world time, scaled by the time warp
+	double GetWorldTime() const { return WorldTime; }
+
+	// World time advanced by one step, used to interpolate towards the current state
+	double GetWorldStep() const { return FixedStep * TimeWarp; }
+
+	double GetTimeWarp() const { return TimeWarp; }
+	void SetTimeWarp(double NewTimeWarp);
+
+	// Real time thrown away because a frame needed more than MaxStepsPerFrame
+	double GetDroppedTime() const { return DroppedTime; }
+
+private:
+
+	double FixedStep;
+	int MaxStepsPerFrame;
+	double MaxFrameTime;
+
+	double Accumulator = 0.0;
+	double WorldTime = 0.0;
+	double TimeWarp = 1.0;
+	double DroppedTime = 0.0;
+};
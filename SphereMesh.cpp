@@ -0,0 +1,103 @@
+#include "SphereMesh.h"
+
+#include <glm/ext.hpp>
+
+#include "CpuProfiler.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// Rows of the sphere generated by one job
+	constexpr int64_t RowsPerJob = 16;
+}
+
+void GenerateSphereMesh(
+	GLuint Resolution, 
+	std::vector<Vertex>& Vertexes,
+	std::vector<glm::ivec3>& Indexes)
+{
+	PROFILE_FUNCTION();
+
+	constexpr float Pi = glm::pi<float>();
+	constexpr float TwoPi = glm::two_pi<float>();
+	float InvResolution = 1.0f / static_cast<float>(Resolution - 1);
+
+	//for (GLuint UIndex = 0; UIndex < Resolution; ++UIndex)
+	//{
+	//	const float U = UIndex * InvResolution;
+	//	const float Theta = glm::mix(0.0f, Pi, U);
+
+	//	for (GLuint VIndex = 0; VIndex < Resolution; ++VIndex)
+	//	{
+	//		const float V = VIndex * InvResolution;
+	//		const float Phi = glm::mix(0.0f, TwoPi, V);
+
+	//		glm::vec3 VertexPosition = {
+	//			glm::sin(Theta) * glm::cos(Phi),
+	//			glm::sin(Theta) * glm::sin(Phi),
+	//			glm::cos(Theta)
+	//		};
+
+	//		Vertex Vertex{
+	//			VertexPosition,
+	//			glm::normalize(VertexPosition),
+	//			glm::vec3(1.0f, 1.0f, 1.0f),
+	//			glm::vec2( 1.0f - U, V)
+	//		};
+
+	//		Vertexes.push_back(Vertex);
+	//	}
+
+	//}
+
+	//Rows are independent, each one writes its own slice of the arrays
+	Vertexes.resize(static_cast<size_t>(Resolution) * Resolution);
+	Indexes.resize(static_cast<size_t>(Resolution - 1) * (Resolution - 1) * 2);
+
+	JobSystem::ParallelFor(0, Resolution, RowsPerJob, [&](int64_t FirstRow, int64_t EndRow)
+	{
+		for (GLuint UIndex = static_cast<GLuint>(FirstRow); UIndex < EndRow; ++UIndex)
+		{
+			const float U = UIndex * InvResolution;
+			const float Theta = glm::mix(0.0f, TwoPi, static_cast<float>(U));
+
+			for (GLuint VIndex = 0; VIndex < Resolution; ++VIndex)
+			{
+				const float V = VIndex * InvResolution;
+				const float Phi = glm::mix(0.0f, Pi, static_cast<float>(V));
+
+				glm::vec3 VertexPosition =
+				{
+					glm::cos(Theta) * glm::sin(Phi),
+					glm::sin(Theta) * glm::sin(Phi),
+					glm::cos(Phi)
+				};
+
+				Vertexes[UIndex * Resolution + VIndex] = Vertex{
+					VertexPosition,
+					glm::normalize(VertexPosition),
+					glm::vec3{ 1.0f, 1.0f, 1.0f },
+					glm::vec2{ 1.0f - U, V }
+				};
+			}
+		}
+	});
+
+	JobSystem::ParallelFor(0, Resolution - 1, RowsPerJob, [&](int64_t FirstRow, int64_t EndRow)
+	{
+		for (GLuint U = static_cast<GLuint>(FirstRow); U < EndRow; ++U)
+		{
+			for (GLuint V = 0; V < Resolution - 1; ++V)
+			{
+				GLuint P0 = U + V * Resolution;
+				GLuint P1 = (U + 1) + V * Resolution;
+				GLuint P2 = (U + 1) + (V + 1) * Resolution;
+				GLuint P3 = U + (V + 1) * Resolution;
+
+				const size_t Triangle = (static_cast<size_t>(U) * (Resolution - 1) + V) * 2;
+				Indexes[Triangle] = glm::ivec3{ P0, P1, P3 };
+				Indexes[Triangle + 1] = glm::ivec3{ P3, P1, P2 };
+			}
+		}
+	});
+}
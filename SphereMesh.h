@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+struct Vertex
+{
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::vec3 Color;
+	glm::vec2 UV;
+};
+
+// Unit sphere with Resolution x Resolution vertexes, as indexed triangles
+void GenerateSphereMesh(
+	GLuint Resolution, 
+	std::vector<Vertex>& Vertexes,
+	std::vector<glm::ivec3>& Indexes);
@@ -0,0 +1,94 @@
+#include "TextOverlay.h"
+#include "GLTrace.h"
+#include "GpuResources.h"
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include <stb_easy_font.h>
+
+TextOverlay::TextOverlay(GLuint ProgramId)
+	: ProgramId(ProgramId)
+{
+	Vertexes.resize(MaxQuads * 4);
+
+	//stb_easy_font emits quads, draw them as two indexed triangles each
+	std::vector<GLuint> Indexes;
+	Indexes.reserve(MaxQuads * 6);
+	for (GLuint Quad = 0; Quad < MaxQuads; ++Quad)
+	{
+		const GLuint First = Quad * 4;
+		Indexes.insert(Indexes.end(), { First, First + 1, First + 2, First, First + 2, First + 3 });
+	}
+
+	glGenBuffers(1, &VertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, Vertexes.size() * sizeof(OverlayVertex), nullptr, GL_STREAM_DRAW);
+	GpuResources::RegisterBuffer(VertexBuffer, Vertexes.size() * sizeof(OverlayVertex), GpuResources::Category::Debug, "Overlay vertexes");
+
+	glGenBuffers(1, &ElementBuffer);
+
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+	GpuResources::RegisterVertexArray(VAO, GpuResources::Category::Debug, "Overlay");
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ElementBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indexes.size() * sizeof(GLuint), Indexes.data(), GL_STATIC_DRAW);
+	GpuResources::RegisterBuffer(ElementBuffer, Indexes.size() * sizeof(GLuint), GpuResources::Category::Debug, "Overlay indexes");
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), nullptr);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(OverlayVertex),
+		reinterpret_cast<void*>(offsetof(OverlayVertex, Color)));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+TextOverlay::~TextOverlay()
+{
+	GpuResources::DeleteVertexArray(VAO);
+	GpuResources::DeleteBuffer(VertexBuffer);
+	GpuResources::DeleteBuffer(ElementBuffer);
+}
+
+void TextOverlay::Draw(const char* Text, float X, float Y, float Scale, int ViewportWidth, int ViewportHeight)
+{
+	//stb_easy_font takes a non const string but never writes to it
+	const int NumQuads = stb_easy_font_print(X / Scale, Y / Scale, const_cast<char*>(Text), nullptr,
+		Vertexes.data(), static_cast<int>(Vertexes.size() * sizeof(OverlayVertex)));
+
+	if (NumQuads == 0)
+	{
+		return;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, NumQuads * 4 * sizeof(OverlayVertex), Vertexes.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//Pixel coordinates, y pointing down as stb_easy_font expects
+	const glm::mat4 Projection = glm::ortho(0.0f, static_cast<float>(ViewportWidth), static_cast<float>(ViewportHeight), 0.0f);
+	const glm::mat4 ScreenTransform = glm::scale(Projection, glm::vec3{ Scale, Scale, 1.0f });
+
+	glUseProgram(ProgramId);
+
+	GLint ScreenTransformLoc = glGetUniformLocation(ProgramId, "ScreenTransform");
+	glUniformMatrix4fv(ScreenTransformLoc, 1, GL_FALSE, glm::value_ptr(ScreenTransform));
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+
+	glBindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, NumQuads * 6, GL_UNSIGNED_INT, nullptr);
+	glBindVertexArray(0);
+
+	glEnable(GL_CULL_FACE);
+	glEnable(GL_DEPTH_TEST);
+
+	glUseProgram(0);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+// Screen space debug text drawn with the quads generated by stb_easy_font.
+// Coordinates are in pixels from the top left corner of the viewport.
+class TextOverlay
+{
+public:
+
+	// Upper bound of quads drawn per call, longer text is truncated
+	static constexpr int MaxQuads = 8192;
+
+	// ProgramId must be built from overlay_vert.glsl and overlay_frag.glsl
+	explicit TextOverlay(GLuint ProgramId);
+	~TextOverlay();
+
+	TextOverlay(const TextOverlay&) = delete;
+	TextOverlay& operator=(const TextOverlay&) = delete;
+
+	void Draw(const char* Text, float X, float Y, float Scale, int ViewportWidth, int ViewportHeight);
+
+private:
+
+	// Layout produced by stb_easy_font_print
+	struct OverlayVertex
+	{
+		float X;
+		float Y;
+		float Z;
+		unsigned char Color[4];
+	};
+
+	GLuint ProgramId = 0;
+	GLuint VAO = 0;
+	GLuint VertexBuffer = 0;
+	GLuint ElementBuffer = 0;
+
+	std::vector<OverlayVertex> Vertexes;
+};
@@ -0,0 +1,466 @@
+#include "TextureResidency.h"
+#include "GLTrace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+#include "CpuProfiler.h"
+#include "GpuResources.h"
+
+namespace
+{
+	constexpr double BytesToMegabytes = 1.0 / (1024.0 * 1024.0);
+
+	GLenum GetInternalFormat(int NumComponents)
+	{
+		switch (NumComponents)
+		{
+		case 1: return GL_R8;
+		case 4: return GL_RGBA8;
+		default: return GL_RGB8;
+		}
+	}
+
+	GLenum GetFormat(int NumComponents)
+	{
+		switch (NumComponents)
+		{
+		case 1: return GL_RED;
+		case 4: return GL_RGBA;
+		default: return GL_RGB;
+		}
+	}
+
+	// Same estimate as GpuResources: drivers pad RGB texels to four bytes
+	size_t GetLevelBytes(const MipChain& Mips, int Level)
+	{
+		const size_t BytesPerTexel = Mips.NumComponents == 1 ? 1 : 4;
+		return static_cast<size_t>(Mips.GetLevelWidth(Level)) * static_cast<size_t>(Mips.GetLevelHeight(Level)) * BytesPerTexel;
+	}
+}
+
+MipChain BuildMipChain(const unsigned char* Pixels, int Width, int Height, int NumComponents)
+{
+	PROFILE_FUNCTION();
+
+	MipChain Chain;
+	Chain.Width = Width;
+	Chain.Height = Height;
+	Chain.NumComponents = NumComponents;
+
+	const int NumLevels = GpuResources::GetMipLevels(Width, Height);
+	size_t TotalSize = 0;
+	for (int Level = 0; Level < NumLevels; ++Level)
+	{
+		Chain.Offsets.push_back(TotalSize);
+		TotalSize += static_cast<size_t>(Chain.GetLevelWidth(Level)) * Chain.GetLevelHeight(Level) * NumComponents;
+	}
+
+	Chain.Texels.resize(TotalSize);
+	std::memcpy(Chain.Texels.data(), Pixels, static_cast<size_t>(Width) * Height * NumComponents);
+
+	for (int Level = 1; Level < NumLevels; ++Level)
+	{
+		const int SourceWidth = Chain.GetLevelWidth(Level - 1);
+		const int SourceHeight = Chain.GetLevelHeight(Level - 1);
+		const int LevelWidth = Chain.GetLevelWidth(Level);
+		const int LevelHeight = Chain.GetLevelHeight(Level);
+		const unsigned char* Source = Chain.Texels.data() + Chain.Offsets[Level - 1];
+		unsigned char* Destination = Chain.Texels.data() + Chain.Offsets[Level];
+
+		//Average of the 2x2 texels above, the last row or column is repeated on odd sizes
+		for (int Y = 0; Y < LevelHeight; ++Y)
+		{
+			const unsigned char* Row0 = Source + static_cast<size_t>(std::min(2 * Y, SourceHeight - 1)) * SourceWidth * NumComponents;
+			const unsigned char* Row1 = Source + static_cast<size_t>(std::min(2 * Y + 1, SourceHeight - 1)) * SourceWidth * NumComponents;
+
+			for (int X = 0; X < LevelWidth; ++X)
+			{
+				const int X0 = std::min(2 * X, SourceWidth - 1) * NumComponents;
+				const int X1 = std::min(2 * X + 1, SourceWidth - 1) * NumComponents;
+
+				for (int Component = 0; Component < NumComponents; ++Component)
+				{
+					const int Sum = Row0[X0 + Component] + Row0[X1 + Component] + Row1[X0 + Component] + Row1[X1 + Component];
+					*Destination++ = static_cast<unsigned char>((Sum + 2) >> 2);
+				}
+			}
+		}
+	}
+
+	return Chain;
+}
+
+TextureResidency::TextureResidency(UploadScheduler& InUploads, const Settings& InSettings)
+	: Uploads(InUploads)
+	, ResidencySettings(InSettings)
+{
+}
+
+TextureResidency::~TextureResidency()
+{
+	//The owners normally remove their textures first
+	for (const Entry& Texture : Entries)
+	{
+		Uploads.Cancel(Texture.PendingUpload);
+		GpuResources::DeleteTexture(Texture.Texture);
+	}
+}
+
+GLuint TextureResidency::AddTexture(MipChain&& Mips, const char* Label)
+{
+	PROFILE_FUNCTION();
+	assert(Mips.GetNumLevels() > 0);
+
+	Entry Texture;
+	Texture.Label = Label != nullptr ? Label : "";
+	Texture.Mips = std::move(Mips);
+	Texture.InternalFormat = GetInternalFormat(Texture.Mips.NumComponents);
+	Texture.Format = GetFormat(Texture.Mips.NumComponents);
+
+	const int NumLevels = Texture.Mips.GetNumLevels();
+	Texture.TailLevel = NumLevels - 1;
+	while (Texture.TailLevel > 0 && std::max(Texture.Mips.GetLevelWidth(Texture.TailLevel - 1), Texture.Mips.GetLevelHeight(Texture.TailLevel - 1))
+		<= ResidencySettings.MinResidentSize)
+	{
+		--Texture.TailLevel;
+	}
+	Texture.BaseLevel = Texture.TailLevel;
+
+	//Wants the whole chain until the first Update() says otherwise
+	Texture.TargetLevel = 0;
+
+	glGenTextures(1, &Texture.Texture);
+	glBindTexture(GL_TEXTURE_2D, Texture.Texture);
+
+	//Levels under the base are left unspecified until streamed in
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, Texture.BaseLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, NumLevels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	//The small levels are copied right away, the texture is complete from the first draw
+	GLint PreviousAlignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &PreviousAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int Level = Texture.TailLevel; Level < NumLevels; ++Level)
+	{
+		glTexImage2D(GL_TEXTURE_2D, Level, Texture.InternalFormat, Texture.Mips.GetLevelWidth(Level), Texture.Mips.GetLevelHeight(Level), 0,
+			Texture.Format, GL_UNSIGNED_BYTE, Texture.Mips.GetLevelData(Level));
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, PreviousAlignment);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	RegisterResidentLevels(Texture);
+
+	const GLuint Name = Texture.Texture;
+	Entries.push_back(std::move(Texture));
+	return Name;
+}
+
+void TextureResidency::RemoveTexture(GLuint Texture)
+{
+	const auto Found = std::find_if(Entries.begin(), Entries.end(), [Texture](const Entry& Current) { return Current.Texture == Texture; });
+	if (Found == Entries.end())
+	{
+		return;
+	}
+
+	Uploads.Cancel(Found->PendingUpload);
+	GpuResources::DeleteTexture(Found->Texture);
+	Entries.erase(Found);
+}
+
+void TextureResidency::SetCoverage(GLuint Texture, float ScreenPixels)
+{
+	if (Entry* Found = Find(Texture))
+	{
+		Found->Coverage = ScreenPixels;
+		Found->LastUsedFrame = FrameIndex;
+	}
+}
+
+void TextureResidency::Update()
+{
+	PROFILE_FUNCTION();
+
+	for (Entry& Texture : Entries)
+	{
+		PickTargetLevel(Texture);
+	}
+
+	EvictOverBudget();
+
+	for (Entry& Texture : Entries)
+	{
+		DropLevels(Texture);
+		StreamNextLevel(Texture);
+	}
+
+	++FrameIndex;
+}
+
+bool TextureResidency::IsStreaming() const
+{
+	return std::any_of(Entries.begin(), Entries.end(),
+		[](const Entry& Texture) { return Texture.TargetLevel < Texture.BaseLevel || Texture.PendingLevel >= 0; });
+}
+
+size_t TextureResidency::GetResidentBytes() const
+{
+	return std::accumulate(Entries.begin(), Entries.end(), size_t{ 0 },
+		[this](size_t Sum, const Entry& Texture) { return Sum + GetChainBytes(Texture, GetAllocatedLevel(Texture)); });
+}
+
+TextureResidency::Entry* TextureResidency::Find(GLuint Texture)
+{
+	const auto Found = std::find_if(Entries.begin(), Entries.end(), [Texture](const Entry& Current) { return Current.Texture == Texture; });
+	return Found != Entries.end() ? &*Found : nullptr;
+}
+
+const TextureResidency::Entry* TextureResidency::Find(GLuint Texture) const
+{
+	const auto Found = std::find_if(Entries.begin(), Entries.end(), [Texture](const Entry& Current) { return Current.Texture == Texture; });
+	return Found != Entries.end() ? &*Found : nullptr;
+}
+
+size_t TextureResidency::GetChainBytes(const Entry& Texture, int FirstLevel) const
+{
+	size_t Bytes = 0;
+	for (int Level = FirstLevel; Level < Texture.Mips.GetNumLevels(); ++Level)
+	{
+		Bytes += GetLevelBytes(Texture.Mips, Level);
+	}
+	return Bytes;
+}
+
+int TextureResidency::GetAllocatedLevel(const Entry& Texture) const
+{
+	return Texture.PendingLevel >= 0 ? Texture.PendingLevel : Texture.BaseLevel;
+}
+
+void TextureResidency::PickTargetLevel(Entry& Texture) const
+{
+	//Not drawn yet, the whole chain is wanted
+	if (Texture.Coverage < 0.0f)
+	{
+		Texture.TargetLevel = 0;
+		return;
+	}
+
+	//Level whose width matches the pixels it covers, one texel per pixel
+	const float IdealLevel = std::log2(static_cast<float>(Texture.Mips.Width) / std::max(Texture.Coverage, 1.0f));
+	const int FinerLevel = std::min(std::max(static_cast<int>(std::floor(IdealLevel)), 0), Texture.TailLevel);
+	const int CoarserLevel = std::min(std::max(static_cast<int>(std::floor(IdealLevel - ResidencySettings.DropHysteresis)), 0), Texture.TailLevel);
+
+	const int CurrentLevel = GetAllocatedLevel(Texture);
+	if (FinerLevel < CurrentLevel)
+	{
+		Texture.TargetLevel = FinerLevel;
+	}
+	else if (CoarserLevel > CurrentLevel)
+	{
+		Texture.TargetLevel = CoarserLevel;
+	}
+	else
+	{
+		Texture.TargetLevel = CurrentLevel;
+	}
+}
+
+void TextureResidency::EvictOverBudget()
+{
+	size_t WantedBytes = 0;
+	for (const Entry& Texture : Entries)
+	{
+		WantedBytes += GetChainBytes(Texture, Texture.TargetLevel);
+	}
+
+	if (WantedBytes <= ResidencySettings.BudgetBytes)
+	{
+		return;
+	}
+
+	//Least recently drawn first, ties keep their order so the choice is stable from frame to frame
+	std::vector<Entry*> Order;
+	Order.reserve(Entries.size());
+	for (Entry& Texture : Entries)
+	{
+		Order.push_back(&Texture);
+	}
+	std::stable_sort(Order.begin(), Order.end(), [](const Entry* Left, const Entry* Right) { return Left->LastUsedFrame < Right->LastUsedFrame; });
+
+	for (Entry* Texture : Order)
+	{
+		while (WantedBytes > ResidencySettings.BudgetBytes && Texture->TargetLevel < Texture->TailLevel)
+		{
+			WantedBytes -= GetLevelBytes(Texture->Mips, Texture->TargetLevel);
+			++Texture->TargetLevel;
+		}
+
+		if (WantedBytes <= ResidencySettings.BudgetBytes)
+		{
+			break;
+		}
+	}
+}
+
+void TextureResidency::DropLevels(Entry& Texture)
+{
+	bool bChanged = false;
+
+	//The level on its way is not wanted anymore
+	if (Texture.PendingLevel >= 0 && Texture.PendingLevel < Texture.TargetLevel)
+	{
+		Uploads.Cancel(Texture.PendingUpload);
+
+		glBindTexture(GL_TEXTURE_2D, Texture.Texture);
+		glTexImage2D(GL_TEXTURE_2D, Texture.PendingLevel, Texture.InternalFormat, 0, 0, 0, Texture.Format, GL_UNSIGNED_BYTE, nullptr);
+
+		Texture.PendingLevel = -1;
+		Texture.PendingUpload = 0;
+		bChanged = true;
+	}
+
+	if (Texture.TargetLevel > Texture.BaseLevel)
+	{
+		glBindTexture(GL_TEXTURE_2D, Texture.Texture);
+
+		//Stop sampling the levels before releasing them
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, Texture.TargetLevel);
+		for (int Level = Texture.BaseLevel; Level < Texture.TargetLevel; ++Level)
+		{
+			glTexImage2D(GL_TEXTURE_2D, Level, Texture.InternalFormat, 0, 0, 0, Texture.Format, GL_UNSIGNED_BYTE, nullptr);
+
+			++NumEvictedLevels;
+			++TotalEvictedLevels;
+			BytesEvicted += GetLevelBytes(Texture.Mips, Level);
+		}
+
+		Texture.BaseLevel = Texture.TargetLevel;
+		bChanged = true;
+	}
+
+	if (bChanged)
+	{
+		glBindTexture(GL_TEXTURE_2D, 0);
+		RegisterResidentLevels(Texture);
+	}
+}
+
+void TextureResidency::StreamNextLevel(Entry& Texture)
+{
+	if (Texture.PendingLevel >= 0 || Texture.TargetLevel >= Texture.BaseLevel)
+	{
+		return;
+	}
+
+	//One level at a time, coarse to fine, each one sharpens the texture as soon as it lands
+	const int Level = Texture.BaseLevel - 1;
+	const GLsizei LevelWidth = Texture.Mips.GetLevelWidth(Level);
+	const GLsizei LevelHeight = Texture.Mips.GetLevelHeight(Level);
+
+	glBindTexture(GL_TEXTURE_2D, Texture.Texture);
+	glTexImage2D(GL_TEXTURE_2D, Level, Texture.InternalFormat, LevelWidth, LevelHeight, 0, Texture.Format, GL_UNSIGNED_BYTE, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Texture.PendingLevel = Level;
+	RegisterResidentLevels(Texture);
+
+	//Looked up again on completion, the entries move when textures are added
+	const GLuint Name = Texture.Texture;
+	Texture.PendingUpload = Uploads.QueueTexture(Name, Level, 0, 0, LevelWidth, LevelHeight, Texture.Format, GL_UNSIGNED_BYTE,
+		Texture.Mips.GetLevelData(Level), UploadScheduler::Priority::Normal,
+		[this, Name, Level]()
+		{
+			OnLevelUploaded(Name, Level);
+		});
+}
+
+void TextureResidency::OnLevelUploaded(GLuint Texture, int Level)
+{
+	Entry* Found = Find(Texture);
+	if (Found == nullptr || Found->PendingLevel != Level)
+	{
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, Texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, Level);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Found->BaseLevel = Level;
+	Found->PendingLevel = -1;
+	Found->PendingUpload = 0;
+
+	++NumStreamedLevels;
+	BytesStreamed += GetLevelBytes(Found->Mips, Level);
+}
+
+void TextureResidency::RegisterResidentLevels(const Entry& Texture) const
+{
+	const int FirstLevel = GetAllocatedLevel(Texture);
+	GpuResources::RegisterTexture(Texture.Texture, Texture.InternalFormat, Texture.Mips.GetLevelWidth(FirstLevel), Texture.Mips.GetLevelHeight(FirstLevel),
+		Texture.Mips.GetNumLevels() - FirstLevel, GpuResources::Category::Textures, Texture.Label.c_str());
+}
+
+void TextureResidency::FormatSummary(char* Text, size_t TextSize) const
+{
+	std::snprintf(Text, TextSize, "Textures %.1f / %.1f MB, %u levels evicted%s",
+		GetResidentBytes() * BytesToMegabytes, ResidencySettings.BudgetBytes * BytesToMegabytes, TotalEvictedLevels,
+		IsStreaming() ? ", streaming" : "");
+}
+
+void TextureResidency::ReportIfDue(double Now)
+{
+	if (LastReport < 0.0)
+	{
+		LastReport = Now;
+		return;
+	}
+
+	if (Now - LastReport < 1.0)
+	{
+		return;
+	}
+
+	if (NumStreamedLevels > 0 || NumEvictedLevels > 0)
+	{
+		std::cout << std::fixed << std::setprecision(2)
+			<< "Textures: " << GetResidentBytes() * BytesToMegabytes << " of " << ResidencySettings.BudgetBytes * BytesToMegabytes << " MB"
+			<< " | Streamed: " << NumStreamedLevels << " levels, " << BytesStreamed * BytesToMegabytes << " MB"
+			<< " | Evicted: " << NumEvictedLevels << " levels, " << BytesEvicted * BytesToMegabytes << " MB"
+			<< std::endl;
+	}
+
+	NumStreamedLevels = 0;
+	NumEvictedLevels = 0;
+	BytesStreamed = 0;
+	BytesEvicted = 0;
+	LastReport = Now;
+}
+
+void TextureResidency::PrintReport() const
+{
+	std::cout << "Texture residency: " << std::fixed << std::setprecision(2) << GetResidentBytes() * BytesToMegabytes
+		<< " of " << ResidencySettings.BudgetBytes * BytesToMegabytes << " MB" << std::endl;
+
+	for (const Entry& Texture : Entries)
+	{
+		const int FirstLevel = GetAllocatedLevel(Texture);
+		std::cout << "    " << std::left << std::setw(32) << Texture.Label << std::right
+			<< " levels " << FirstLevel << "-" << Texture.Mips.GetNumLevels() - 1
+			<< " (" << Texture.Mips.GetLevelWidth(FirstLevel) << "x" << Texture.Mips.GetLevelHeight(FirstLevel) << ")"
+			<< " " << std::setw(8) << GetChainBytes(Texture, FirstLevel) * BytesToMegabytes << " MB"
+			<< ", wants level " << Texture.TargetLevel << std::endl;
+	}
+}
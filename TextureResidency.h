@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "UploadScheduler.h"
+
+// Every level of an 8 bit image down to 1x1, kept in system memory so any
+// level can be streamed back to the GPU after it was evicted
+struct MipChain
+{
+	GLsizei Width = 0;
+	GLsizei Height = 0;
+
+	// 1 (red), 3 (RGB) or 4 (RGBA)
+	int NumComponents = 0;
+
+	// Start of every level in Texels, level 0 first
+	std::vector<size_t> Offsets;
+	std::vector<unsigned char> Texels;
+
+	int GetNumLevels() const { return static_cast<int>(Offsets.size()); }
+	GLsizei GetLevelWidth(int Level) const { return Width >> Level > 0 ? Width >> Level : 1; }
+	GLsizei GetLevelHeight(int Level) const { return Height >> Level > 0 ? Height >> Level : 1; }
+	const unsigned char* GetLevelData(int Level) const { return Texels.data() + Offsets[Level]; }
+};
+
+// Box filtered chain of tightly packed Width x Height pixels, for the workers
+MipChain BuildMipChain(const unsigned char* Pixels, int Width, int Height, int NumComponents);
+
+// Keeps the managed textures inside a video memory budget.
+// A texture has a resident range of levels, from its GL_TEXTURE_BASE_LEVEL
+// to 1x1, and its whole chain in system memory. Every frame the renderer
+// reports how many screen pixels the width of each visible texture covers;
+// Update() picks the finest level worth having, streams missing levels in
+// one at a time, coarse to fine, through the upload scheduler, and drops
+// the levels no longer needed. When the wanted levels do not fit in the
+// budget the finest levels of the least recently drawn textures go first.
+//
+// Evicted levels are re-specified empty below the base level, so a texture
+// keeps its name and draws bind the same id whatever is resident. The
+// levels up to MinResidentSize are uploaded when the texture is added and
+// never evicted, it can be sampled right away.
+class TextureResidency
+{
+public:
+
+	struct Settings
+	{
+		size_t BudgetBytes = 64 << 20;
+
+		// Largest side of the levels that always stay resident
+		GLsizei MinResidentSize = 128;
+
+		// Levels the coverage must fall past the current one before resolution
+		// drops, so a texture on the boundary does not stream in and out
+		float DropHysteresis = 0.5f;
+	};
+
+	TextureResidency(UploadScheduler& InUploads, const Settings& InSettings);
+	~TextureResidency();
+
+	TextureResidency(const TextureResidency&) = delete;
+	TextureResidency& operator=(const TextureResidency&) = delete;
+
+	const Settings& GetSettings() const { return ResidencySettings; }
+
+	// Create a repeating, trilinear filtered texture for the chain. Until its
+	// coverage is reported the whole chain is wanted
+	GLuint AddTexture(MipChain&& Mips, const char* Label);
+
+	// Delete the texture and its system memory copy
+	void RemoveTexture(GLuint Texture);
+
+	// Screen pixels the full width of the texture covers this frame, which
+	// also marks it as used
+	void SetCoverage(GLuint Texture, float ScreenPixels);
+
+	// Pick the wanted levels, evict over budget and stream, once per frame
+	void Update();
+
+	// True while a texture has fewer levels resident than wanted
+	bool IsStreaming() const;
+
+	size_t GetResidentBytes() const;
+
+	// One line with the resident bytes against the budget, for the overlay
+	void FormatSummary(char* Text, size_t TextSize) const;
+
+	// Print the levels streamed and evicted once per second
+	void ReportIfDue(double Now);
+
+	// Print the resident levels of every texture
+	void PrintReport() const;
+
+private:
+
+	struct Entry
+	{
+		GLuint Texture = 0;
+		std::string Label;
+		MipChain Mips;
+		GLenum InternalFormat = GL_NONE;
+		GLenum Format = GL_NONE;
+
+		// Coarsest level that may be evicted, the ones after stay resident
+		int TailLevel = 0;
+
+		// Levels [BaseLevel, last] are resident and sampled
+		int BaseLevel = 0;
+
+		// Base level wanted after the budget, then streamed toward
+		int TargetLevel = 0;
+
+		// Level being uploaded, BaseLevel - 1, or -1
+		int PendingLevel = -1;
+		UploadScheduler::UploadId PendingUpload = 0;
+
+		// Negative until the renderer reports it
+		float Coverage = -1.0f;
+		uint64_t LastUsedFrame = 0;
+	};
+
+	Entry* Find(GLuint Texture);
+	const Entry* Find(GLuint Texture) const;
+
+	// Video memory of the levels from FirstLevel to 1x1
+	size_t GetChainBytes(const Entry& Texture, int FirstLevel) const;
+
+	// Lowest level allocated: resident or being uploaded
+	int GetAllocatedLevel(const Entry& Texture) const;
+
+	void PickTargetLevel(Entry& Texture) const;
+	void EvictOverBudget();
+	void DropLevels(Entry& Texture);
+	void StreamNextLevel(Entry& Texture);
+	void OnLevelUploaded(GLuint Texture, int Level);
+
+	// Update the size known to GpuResources
+	void RegisterResidentLevels(const Entry& Texture) const;
+
+	UploadScheduler& Uploads;
+	Settings ResidencySettings;
+
+	std::vector<Entry> Entries;
+	uint64_t FrameIndex = 0;
+
+	// Statistics since the last report
+	double LastReport = -1.0;
+	uint32_t NumStreamedLevels = 0;
+	uint32_t NumEvictedLevels = 0;
+	size_t BytesStreamed = 0;
+	size_t BytesEvicted = 0;
+
+	// Since startup, shown by the overlay
+	uint32_t TotalEvictedLevels = 0;
+};
@@ -0,0 +1,133 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	bool IsUniform(const glm::vec3& Scale)
+	{
+		return Scale.x == Scale.y && Scale.y == Scale.z;
+	}
+
+	glm::mat4 ComposeLocal(const glm::vec3& Translation, const glm::quat& Rotation, const glm::vec3& Scale)
+	{
+		//T * R * S without building and multiplying three matrices
+		const glm::mat3 Rotate = glm::mat3_cast(Rotation);
+
+		glm::mat4 Local;
+		Local[0] = glm::vec4{ Rotate[0] * Scale.x, 0.0f };
+		Local[1] = glm::vec4{ Rotate[1] * Scale.y, 0.0f };
+		Local[2] = glm::vec4{ Rotate[2] * Scale.z, 0.0f };
+		Local[3] = glm::vec4{ Translation, 1.0f };
+		return Local;
+	}
+}
+
+TransformHierarchy::NodeId TransformHierarchy::AddNode(NodeId Parent, const glm::vec3& Translation, const glm::quat& Rotation, const glm::vec3& Scale)
+{
+	assert(Parent == InvalidNode || Parent < Parents.size());
+
+	const NodeId Node = static_cast<NodeId>(Parents.size());
+	Parents.push_back(Parent);
+	Translations.push_back(Translation);
+	Rotations.push_back(Rotation);
+	Scales.push_back(Scale);
+	Worlds.push_back(glm::mat4{ 1.0f });
+	UniformScales.push_back(1);
+	Dirty.push_back(1);
+	bAnyDirty = true;
+	return Node;
+}
+
+void TransformHierarchy::SetTranslation(NodeId Node, const glm::vec3& Translation)
+{
+	Translations[Node] = Translation;
+	MarkDirty(Node);
+}
+
+void TransformHierarchy::SetRotation(NodeId Node, const glm::quat& Rotation)
+{
+	Rotations[Node] = Rotation;
+	MarkDirty(Node);
+}
+
+void TransformHierarchy::SetScale(NodeId Node, const glm::vec3& Scale)
+{
+	Scales[Node] = Scale;
+	MarkDirty(Node);
+}
+
+void TransformHierarchy::MarkDirty(NodeId Node)
+{
+	Dirty[Node] = 1;
+	bAnyDirty = true;
+}
+
+int TransformHierarchy::Update()
+{
+	if (!bAnyDirty)
+	{
+		return 0;
+	}
+
+	int NumEvaluated = 0;
+	const NodeId NumNodes = GetNumNodes();
+
+	//Parents come first, a dirty parent has already passed its flag on when its children are reached
+	for (NodeId Node = 0; Node < NumNodes; ++Node)
+	{
+		const NodeId Parent = Parents[Node];
+		if (Parent != InvalidNode && Dirty[Parent])
+		{
+			Dirty[Node] = 1;
+		}
+
+		if (!Dirty[Node])
+		{
+			continue;
+		}
+
+		const glm::mat4 Local = ComposeLocal(Translations[Node], Rotations[Node], Scales[Node]);
+		if (Parent == InvalidNode)
+		{
+			Worlds[Node] = Local;
+			UniformScales[Node] = IsUniform(Scales[Node]);
+		}
+		else
+		{
+			Worlds[Node] = Worlds[Parent] * Local;
+
+			//A non uniform scale above a rotation shears, uniform only holds when it does all the way up
+			UniformScales[Node] = UniformScales[Parent] && IsUniform(Scales[Node]);
+		}
+		++NumEvaluated;
+	}
+
+	std::fill(Dirty.begin(), Dirty.end(), 0);
+	bAnyDirty = false;
+	return NumEvaluated;
+}
+
+glm::mat3 TransformHierarchy::GetNormalMatrix(NodeId Node, const glm::mat4& View) const
+{
+	return ::GetNormalMatrix(glm::mat3{ View } * glm::mat3{ Worlds[Node] }, UniformScales[Node] != 0);
+}
+
+glm::mat3 GetNormalMatrix(const glm::mat3& Linear, bool bUniformScale)
+{
+	if (bUniformScale)
+	{
+		//s * R, whose inverse transpose is R / s
+		const float ScaleSquared = glm::dot(Linear[0], Linear[0]);
+		return Linear * (1.0f / ScaleSquared);
+	}
+
+	//Columns of the cofactor matrix, the determinant comes out of the same cross product
+	const glm::vec3 Cofactor0 = glm::cross(Linear[1], Linear[2]);
+	const glm::vec3 Cofactor1 = glm::cross(Linear[2], Linear[0]);
+	const glm::vec3 Cofactor2 = glm::cross(Linear[0], Linear[1]);
+	const float InverseDeterminant = 1.0f / glm::dot(Linear[0], Cofactor0);
+
+	return glm::mat3{ Cofactor0 * InverseDeterminant, Cofactor1 * InverseDeterminant, Cofactor2 * InverseDeterminant };
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Parent/child transforms, such as an orbit chain planet -> moon -> satellite.
+// Nodes are stored as parallel arrays in the order they were added, and a
+// parent must be added before its children, so one pass from the front
+// always sees a parent's world transform before its children need it.
+//
+// Setting a local transform marks the node dirty. Update() evaluates the
+// dirty nodes and everything below them, and returns at once when nothing
+// moved. Each node also tracks whether its world transform only scales
+// uniformly. Normal matrices can then skip the general inverse.
+class TransformHierarchy
+{
+public:
+
+	using NodeId = uint32_t;
+	static constexpr NodeId InvalidNode = UINT32_MAX;
+
+	// Parent is InvalidNode for a root
+	NodeId AddNode(NodeId Parent, const glm::vec3& Translation, const glm::quat& Rotation, const glm::vec3& Scale);
+
+	void SetTranslation(NodeId Node, const glm::vec3& Translation);
+	void SetRotation(NodeId Node, const glm::quat& Rotation);
+	void SetScale(NodeId Node, const glm::vec3& Scale);
+
+	const glm::vec3& GetTranslation(NodeId Node) const { return Translations[Node]; }
+	const glm::quat& GetRotation(NodeId Node) const { return Rotations[Node]; }
+	const glm::vec3& GetScale(NodeId Node) const { return Scales[Node]; }
+
+	// Evaluate the world transforms of the dirty subtrees, returns how many nodes were
+	int Update();
+
+	// Valid after Update()
+	const glm::mat4& GetWorld(NodeId Node) const { return Worlds[Node]; }
+	glm::vec3 GetWorldPosition(NodeId Node) const { return glm::vec3{ Worlds[Node][3] }; }
+
+	// Inverse transpose of the upper 3x3 of View * World, for transforming
+	// normals to view space. View must be rigid, as a camera view is
+	glm::mat3 GetNormalMatrix(NodeId Node, const glm::mat4& View) const;
+
+	uint32_t GetNumNodes() const { return static_cast<uint32_t>(Parents.size()); }
+
+private:
+
+	void MarkDirty(NodeId Node);
+
+	// Local transforms
+	std::vector<NodeId> Parents;
+	std::vector<glm::vec3> Translations;
+	std::vector<glm::quat> Rotations;
+	std::vector<glm::vec3> Scales;
+
+	// World transforms
+	std::vector<glm::mat4> Worlds;
+	std::vector<uint8_t> UniformScales;
+
+	// Set when the local transform changed, or during Update() when the parent was evaluated
+	std::vector<uint8_t> Dirty;
+	bool bAnyDirty = false;
+};
+
+// Inverse transpose of an affine 3x3 matrix. Only the rotation is kept when
+// the scale is known to be uniform, otherwise it is the cofactor matrix over
+// the determinant
+glm::mat3 GetNormalMatrix(const glm::mat3& Linear, bool bUniformScale);
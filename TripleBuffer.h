@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer / single consumer triple buffer.
+// The producer always writes into its own back slot and publishes it by
+// swapping it with the middle slot. The consumer takes the middle slot only
+// when something new was published, so both sides never block each other
+// and the consumer always sees the most recent complete value.
+template <typename T>
+class TripleBuffer
+{
+public:
+
+	// Slot the producer is allowed to write to
+	T& GetWriteSlot()
+	{
+		return Slots[BackIndex];
+	}
+
+	// Make the write slot visible to the consumer
+	void Publish()
+	{
+		const uint8_t Previous = Middle.exchange(static_cast<uint8_t>(BackIndex | FreshBit), std::memory_order_acq_rel);
+		BackIndex = Previous & IndexMask;
+	}
+
+	// True if a value was published that the consumer has not taken yet
+	bool HasPending() const
+	{
+		return (Middle.load(std::memory_order_relaxed) & FreshBit) != 0;
+	}
+
+	// Take the latest published value. Returns false if nothing new arrived
+	// since the previous call, in which case GetReadSlot() is unchanged
+	bool Acquire()
+	{
+		if (!HasPending())
+		{
+			return false;
+		}
+
+		const uint8_t Previous = Middle.exchange(FrontIndex, std::memory_order_acq_rel);
+		FrontIndex = Previous & IndexMask;
+		return true;
+	}
+
+	// Slot the consumer is reading from
+	const T& GetReadSlot() const
+	{
+		return Slots[FrontIndex];
+	}
+
+private:
+
+	static constexpr uint8_t IndexMask = 0x3;
+	static constexpr uint8_t FreshBit = 0x4;
+
+	T Slots[3];
+
+	// Owned by the producer
+	uint8_t BackIndex = 0;
+
+	// Owned by the consumer
+	uint8_t FrontIndex = 1;
+
+	// Shared slot index plus a flag telling if it holds unread data
+	std::atomic<uint8_t> Middle{ 2 };
+};
@@ -0,0 +1,494 @@
+#include "UploadScheduler.h"
+#include "GLTrace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "CpuProfiler.h"
+#include "GpuResources.h"
+#include "Log.h"
+
+namespace
+{
+	// One second, glClientWaitSync takes nanoseconds
+	constexpr GLuint64 BlockingTimeout = 1000000000ull;
+
+	// Offsets of the copies in the ring, enough for any texel type
+	constexpr size_t StagingAlignment = 16;
+
+	// Smallest budgets, the lower priorities still stream a little every frame
+	constexpr size_t MinBytesPerFrame = 64 * 1024;
+	constexpr double MinMillisecondsPerFrame = 0.1;
+
+	constexpr double BytesToMegabytes = 1.0 / (1024.0 * 1024.0);
+
+	size_t AlignUp(size_t Value, size_t Alignment)
+	{
+		return (Value + Alignment - 1) / Alignment * Alignment;
+	}
+
+	// Size of one texel of the client data, 0 for formats the scheduler does not split
+	size_t GetTexelSize(GLenum Format, GLenum Type)
+	{
+		size_t NumComponents = 0;
+		switch (Format)
+		{
+		case GL_RED:
+		case GL_DEPTH_COMPONENT:
+			NumComponents = 1;
+			break;
+		case GL_RG:
+			NumComponents = 2;
+			break;
+		case GL_RGB:
+		case GL_BGR:
+			NumComponents = 3;
+			break;
+		case GL_RGBA:
+		case GL_BGRA:
+			NumComponents = 4;
+			break;
+		}
+
+		switch (Type)
+		{
+		case GL_UNSIGNED_BYTE:
+		case GL_BYTE:
+			return NumComponents;
+		case GL_UNSIGNED_SHORT:
+		case GL_SHORT:
+		case GL_HALF_FLOAT:
+			return NumComponents * 2;
+		case GL_UNSIGNED_INT:
+		case GL_INT:
+		case GL_FLOAT:
+			return NumComponents * 4;
+		}
+		return 0;
+	}
+}
+
+UploadScheduler::UploadScheduler(const Settings& InSettings)
+	: SchedulerSettings(InSettings)
+{
+	SchedulerSettings.StagingSize = std::max(SchedulerSettings.StagingSize, StagingAlignment);
+	SchedulerSettings.ChunkSize = std::min(std::max(SchedulerSettings.ChunkSize, StagingAlignment), SchedulerSettings.StagingSize);
+	SchedulerSettings.BytesPerFrame = std::max(SchedulerSettings.BytesPerFrame, MinBytesPerFrame);
+	SchedulerSettings.MillisecondsPerFrame = std::max(SchedulerSettings.MillisecondsPerFrame, MinMillisecondsPerFrame);
+
+	//Written through unsynchronized mappings, the fences say which parts are free
+	glGenBuffers(1, &StagingBuffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, StagingBuffer);
+	glBufferData(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(SchedulerSettings.StagingSize), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	GpuResources::RegisterBuffer(StagingBuffer, static_cast<GLsizeiptr>(SchedulerSettings.StagingSize),
+		GpuResources::Category::Textures, "Upload staging ring");
+}
+
+UploadScheduler::~UploadScheduler()
+{
+	for (const StagedRegion& Region : Regions)
+	{
+		glDeleteSync(Region.Fence);
+	}
+	GpuResources::DeleteBuffer(StagingBuffer);
+}
+
+UploadScheduler::UploadId UploadScheduler::QueueTexture(GLuint Texture, GLint Level, GLint X, GLint Y, GLsizei Width, GLsizei Height,
+	GLenum Format, GLenum Type, const void* Pixels, Priority Class, Callback OnUploaded)
+{
+	Request Upload;
+	Upload.Object = Texture;
+	Upload.bTexture = true;
+	Upload.Level = Level;
+	Upload.X = X;
+	Upload.Y = Y;
+	Upload.Width = Width;
+	Upload.Format = Format;
+	Upload.Type = Type;
+	Upload.RowSize = static_cast<size_t>(Width) * GetTexelSize(Format, Type);
+	Upload.Source = static_cast<const unsigned char*>(Pixels);
+	Upload.Size = Upload.RowSize * static_cast<size_t>(Height);
+	Upload.OnUploaded = std::move(OnUploaded);
+
+	//Bands are whole rows, one must fit in a chunk
+	assert(Width == 0 || (Upload.RowSize > 0 && Upload.RowSize <= SchedulerSettings.ChunkSize));
+
+	return Push(std::move(Upload), Class);
+}
+
+UploadScheduler::UploadId UploadScheduler::QueueBuffer(GLuint Buffer, GLintptr Offset, GLsizeiptr Size, const void* Data,
+	Priority Class, Callback OnUploaded)
+{
+	Request Upload;
+	Upload.Object = Buffer;
+	Upload.Offset = Offset;
+	Upload.Source = static_cast<const unsigned char*>(Data);
+	Upload.Size = static_cast<size_t>(Size);
+	Upload.OnUploaded = std::move(OnUploaded);
+
+	return Push(std::move(Upload), Class);
+}
+
+UploadScheduler::UploadId UploadScheduler::Push(Request&& Upload, Priority Class)
+{
+	//Nothing to copy, done right away
+	if (Upload.Size == 0)
+	{
+		if (Upload.OnUploaded)
+		{
+			Upload.OnUploaded();
+		}
+		return 0;
+	}
+
+	Upload.Id = NextId++;
+	PendingBytes += Upload.Size;
+
+	const UploadId Id = Upload.Id;
+	Queues[static_cast<size_t>(Class)].push_back(std::move(Upload));
+	return Id;
+}
+
+bool UploadScheduler::Cancel(UploadId Id)
+{
+	for (std::deque<Request>& Queue : Queues)
+	{
+		const auto Found = std::find_if(Queue.begin(), Queue.end(), [Id](const Request& Upload) { return Upload.Id == Id; });
+		if (Found != Queue.end())
+		{
+			PendingBytes -= Found->Size - Found->Uploaded;
+			Queue.erase(Found);
+			return true;
+		}
+	}
+	return false;
+}
+
+void UploadScheduler::Update()
+{
+	PROFILE_FUNCTION();
+
+	const uint64_t Begin = CpuProfiler::Now();
+	RetireRegions(false);
+
+	if (GetNumPending() == 0)
+	{
+		return;
+	}
+
+	const size_t FrameBytes = Process(true, Begin);
+
+	const uint64_t End = CpuProfiler::Now();
+	const uint64_t TimeBudget = static_cast<uint64_t>(SchedulerSettings.MillisecondsPerFrame * 1e6);
+
+	++NumFrames;
+	MaxFrameMs = std::max(MaxFrameMs, (End - Begin) * 1e-6);
+
+	//Urgent uploads ignore the budget, and a chunk can take longer than the time left
+	if (FrameBytes > SchedulerSettings.BytesPerFrame || End - Begin > TimeBudget)
+	{
+		++NumOverruns;
+		++TotalOverruns;
+
+#if defined(BLUEPLANET_PROFILE) && BLUEPLANET_PROFILE
+		//Nested in the Update zone, from the point the time budget ran out
+		const uint64_t OverrunBegin = End - Begin > TimeBudget ? Begin + TimeBudget : Begin;
+		const uint32_t Depth = CpuProfiler::EnterZone();
+		CpuProfiler::RecordZone("UploadBudgetOverrun", OverrunBegin, End, Depth);
+		CpuProfiler::LeaveZone();
+#endif
+	}
+}
+
+void UploadScheduler::Flush()
+{
+	PROFILE_FUNCTION();
+
+	RetireRegions(false);
+	Process(false, CpuProfiler::Now());
+}
+
+size_t UploadScheduler::Process(bool bBudgeted, uint64_t Begin)
+{
+	const uint64_t TimeBudget = static_cast<uint64_t>(SchedulerSettings.MillisecondsPerFrame * 1e6);
+	size_t FrameBytes = 0;
+
+	//Rows of the ring are tightly packed
+	GLint PreviousAlignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &PreviousAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, StagingBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, StagingBuffer);
+
+	//Callbacks run once the unpack buffer is unbound, they may upload from client memory
+	std::vector<Callback> Completed;
+
+	bool bOutOfBudget = false;
+	for (size_t Index = 0; Index < Queues.size() && !bOutOfBudget; ++Index)
+	{
+		std::deque<Request>& Queue = Queues[Index];
+		const bool bUrgent = !bBudgeted || Index == static_cast<size_t>(Priority::Urgent);
+
+		while (!Queue.empty())
+		{
+			size_t Limit = SchedulerSettings.ChunkSize;
+			if (!bUrgent)
+			{
+				//Lower priorities wait for the next frame too, once the frame copied something so they always progress
+				if (FrameBytes > 0 && (FrameBytes >= SchedulerSettings.BytesPerFrame || CpuProfiler::Now() - Begin >= TimeBudget))
+				{
+					bOutOfBudget = true;
+					break;
+				}
+				Limit = std::min(Limit, SchedulerSettings.BytesPerFrame - FrameBytes);
+			}
+
+			Request& Current = Queue.front();
+
+			//A row that does not fit in what is left waits, unless the frame copied nothing yet
+			if (!bUrgent && Current.bTexture && Limit < Current.RowSize && FrameBytes > 0)
+			{
+				bOutOfBudget = true;
+				break;
+			}
+
+			const size_t Copied = UploadChunk(Current, Limit, bUrgent);
+			if (Copied == 0)
+			{
+				bOutOfBudget = true;
+				break;
+			}
+
+			FrameBytes += Copied;
+			PendingBytes -= Copied;
+			BytesUploaded += Copied;
+
+			if (Current.Uploaded == Current.Size)
+			{
+				if (Current.OnUploaded)
+				{
+					Completed.push_back(std::move(Current.OnUploaded));
+				}
+				Queue.pop_front();
+				++NumUploaded;
+			}
+		}
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, PreviousAlignment);
+
+	CloseRegion();
+
+	for (Callback& OnUploaded : Completed)
+	{
+		OnUploaded();
+	}
+
+	return FrameBytes;
+}
+
+size_t UploadScheduler::UploadChunk(Request& Upload, size_t Limit, bool bWait)
+{
+	size_t Bytes = std::min(Limit, Upload.Size - Upload.Uploaded);
+	if (Upload.bTexture)
+	{
+		//Whole rows, at least one so the upload always progresses
+		Bytes = std::max(Bytes / Upload.RowSize, size_t{ 1 }) * Upload.RowSize;
+	}
+
+	size_t StagingOffset = 0;
+	while (!AllocateStaging(Bytes, StagingOffset))
+	{
+		if (!bWait)
+		{
+			return 0;
+		}
+
+		//The ring is full of copies the GPU has not executed yet
+		PROFILE_SCOPE("WaitForStaging");
+		++NumRingWaits;
+		CloseRegion();
+		RetireRegions(true);
+	}
+
+	void* Mapped = glMapBufferRange(GL_COPY_READ_BUFFER, static_cast<GLintptr>(StagingOffset), static_cast<GLsizeiptr>(Bytes),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (Mapped == nullptr)
+	{
+		LOG_ERROR("Uploads: could not map %zu bytes of the staging ring", Bytes);
+		return 0;
+	}
+
+	std::memcpy(Mapped, Upload.Source + Upload.Uploaded, Bytes);
+	glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+	if (Upload.bTexture)
+	{
+		const GLint FirstRow = static_cast<GLint>(Upload.Uploaded / Upload.RowSize);
+		const GLsizei NumRows = static_cast<GLsizei>(Bytes / Upload.RowSize);
+
+		glBindTexture(GL_TEXTURE_2D, Upload.Object);
+		glTexSubImage2D(GL_TEXTURE_2D, Upload.Level, Upload.X, Upload.Y + FirstRow, Upload.Width, NumRows,
+			Upload.Format, Upload.Type, reinterpret_cast<const void*>(StagingOffset));
+	}
+	else
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, Upload.Object);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(StagingOffset),
+			Upload.Offset + static_cast<GLintptr>(Upload.Uploaded), static_cast<GLsizeiptr>(Bytes));
+	}
+
+	Upload.Uploaded += Bytes;
+	bRegionOpen = true;
+	return Bytes;
+}
+
+bool UploadScheduler::AllocateStaging(size_t Size, size_t& Offset)
+{
+	const size_t StagingSize = SchedulerSettings.StagingSize;
+	const bool bEmpty = Regions.empty() && !bRegionOpen;
+	if (bEmpty)
+	{
+		Head = 0;
+		Tail = 0;
+	}
+
+	const size_t AlignedHead = AlignUp(Head, StagingAlignment);
+
+	//Free space is [Head, end) then [0, Tail)
+	if (bEmpty || Head > Tail)
+	{
+		if (AlignedHead + Size <= StagingSize)
+		{
+			Offset = AlignedHead;
+			Head = Offset + Size;
+			return true;
+		}
+
+		//Wrap around, the end of the ring is skipped
+		if (!bEmpty && Size <= Tail)
+		{
+			Offset = 0;
+			Head = Size;
+			return true;
+		}
+		return false;
+	}
+
+	//Free space is [Head, Tail), Head == Tail is a full ring
+	if (Head < Tail && AlignedHead + Size <= Tail)
+	{
+		Offset = AlignedHead;
+		Head = Offset + Size;
+		return true;
+	}
+	return false;
+}
+
+void UploadScheduler::CloseRegion()
+{
+	if (!bRegionOpen)
+	{
+		return;
+	}
+
+	StagedRegion Region;
+	Region.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	Region.End = Head;
+	Regions.push_back(Region);
+	bRegionOpen = false;
+}
+
+void UploadScheduler::RetireRegions(bool bWaitForOldest)
+{
+	while (!Regions.empty())
+	{
+		StagedRegion& Oldest = Regions.front();
+		const GLenum Result = glClientWaitSync(Oldest.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, bWaitForOldest ? BlockingTimeout : 0);
+
+		if (Result == GL_TIMEOUT_EXPIRED)
+		{
+			if (!bWaitForOldest)
+			{
+				break;
+			}
+
+			//Keep blocking, the GPU is just slow
+			continue;
+		}
+
+		//Signaled, or the wait failed. Failed fences are retired too so the ring never deadlocks
+		Tail = Oldest.End;
+		glDeleteSync(Oldest.Fence);
+		Regions.pop_front();
+
+		//The rest is only collected if already done
+		bWaitForOldest = false;
+	}
+}
+
+uint32_t UploadScheduler::GetNumPending() const
+{
+	size_t NumPending = 0;
+	for (const std::deque<Request>& Queue : Queues)
+	{
+		NumPending += Queue.size();
+	}
+	return static_cast<uint32_t>(NumPending);
+}
+
+size_t UploadScheduler::GetPendingBytes() const
+{
+	return PendingBytes;
+}
+
+void UploadScheduler::FormatSummary(char* Text, size_t TextSize) const
+{
+	std::snprintf(Text, TextSize, "Uploads %.1f MB pending (%u), %u over budget",
+		PendingBytes * BytesToMegabytes, GetNumPending(), TotalOverruns);
+}
+
+void UploadScheduler::ReportIfDue(double Now)
+{
+	if (LastReport < 0.0)
+	{
+		LastReport = Now;
+		return;
+	}
+
+	if (Now - LastReport < 1.0)
+	{
+		return;
+	}
+
+	if (NumFrames > 0)
+	{
+		std::cout << std::fixed << std::setprecision(2)
+			<< "Uploads: " << BytesUploaded * BytesToMegabytes << " MB in " << NumFrames << " frames"
+			<< " (max " << MaxFrameMs << " ms)"
+			<< " | Completed: " << NumUploaded
+			<< " | Over budget: " << NumOverruns
+			<< " | Ring waits: " << NumRingWaits
+			<< " | Pending: " << PendingBytes * BytesToMegabytes << " MB"
+			<< std::endl;
+	}
+
+	BytesUploaded = 0;
+	NumUploaded = 0;
+	NumFrames = 0;
+	NumOverruns = 0;
+	NumRingWaits = 0;
+	MaxFrameMs = 0.0;
+	LastReport = Now;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include <GL/glew.h>
+
+// Time sliced uploads to the GPU, used on the thread owning the context.
+// Texture levels, sub-rectangles of them and buffer ranges are queued with
+// their source data. Every frame Update() copies as much as fits in a byte
+// and a time budget into a staging ring, a pixel unpack buffer, and issues
+// glTexSubImage2D / glCopyBufferSubData from it: a large texture arrives as
+// bands of rows over several frames instead of stalling one.
+//
+// Urgent requests are always completed in the frame they are queued, budget
+// or not, they are what the frame cannot be drawn without. A frame going
+// over its budget records an UploadBudgetOverrun zone in the CPU profiler.
+// Regions of the ring are reused once the fence inserted after the copies
+// of their frame signals.
+class UploadScheduler
+{
+public:
+
+	enum class Priority : uint8_t
+	{
+		Urgent,
+		Normal,
+		Background,
+		NumPriorities
+	};
+
+	// 0 is never a valid upload
+	using UploadId = uint64_t;
+
+	// Runs on the GL thread after the last copy of the request was issued
+	using Callback = std::function<void()>;
+
+	struct Settings
+	{
+		// Budget of Normal and Background uploads per frame, at least 64 KB and 0.1 ms.
+		// The first copy of a frame is always made, so they never stall
+		size_t BytesPerFrame = 8 << 20;
+		double MillisecondsPerFrame = 2.0;
+
+		// Largest copy issued at once, the time budget is checked between copies
+		size_t ChunkSize = 1 << 20;
+
+		// Several frames of budget so the ring never waits on the GPU
+		size_t StagingSize = 32 << 20;
+	};
+
+	explicit UploadScheduler(const Settings& InSettings);
+	~UploadScheduler();
+
+	UploadScheduler(const UploadScheduler&) = delete;
+	UploadScheduler& operator=(const UploadScheduler&) = delete;
+
+	const Settings& GetSettings() const { return SchedulerSettings; }
+
+	// Copy Width x Height texels of Pixels, tightly packed rows, to the
+	// rectangle at X, Y of a level of a 2D texture whose storage is allocated.
+	// Pixels must stay valid until OnUploaded runs or the upload is cancelled
+	UploadId QueueTexture(GLuint Texture, GLint Level, GLint X, GLint Y, GLsizei Width, GLsizei Height,
+		GLenum Format, GLenum Type, const void* Pixels, Priority Class, Callback OnUploaded = nullptr);
+
+	// Copy Size bytes of Data to Offset in a buffer whose storage is allocated
+	UploadId QueueBuffer(GLuint Buffer, GLintptr Offset, GLsizeiptr Size, const void* Data,
+		Priority Class, Callback OnUploaded = nullptr);
+
+	// Drop what is left of an upload, its callback never runs. Copies already
+	// issued still land. False if the upload already completed
+	bool Cancel(UploadId Id);
+
+	// Upload within the budget, once per frame
+	void Update();
+
+	// Upload everything queued now, for loading screens
+	void Flush();
+
+	uint32_t GetNumPending() const;
+	size_t GetPendingBytes() const;
+
+	// One line with the pending bytes and the overruns, for the overlay
+	void FormatSummary(char* Text, size_t TextSize) const;
+
+	// Print the bytes uploaded and the overruns once per second
+	void ReportIfDue(double Now);
+
+private:
+
+	struct Request
+	{
+		UploadId Id = 0;
+		GLuint Object = 0;
+		bool bTexture = false;
+
+		GLint Level = 0;
+		GLint X = 0;
+		GLint Y = 0;
+		GLsizei Width = 0;
+		GLenum Format = GL_NONE;
+		GLenum Type = GL_NONE;
+		size_t RowSize = 0;
+
+		GLintptr Offset = 0;
+
+		const unsigned char* Source = nullptr;
+		size_t Size = 0;
+		size_t Uploaded = 0;
+		Callback OnUploaded;
+	};
+
+	// Part of the ring written during one frame, free once Fence signals
+	struct StagedRegion
+	{
+		GLsync Fence = nullptr;
+		size_t End = 0;
+	};
+
+	UploadId Push(Request&& Upload, Priority Class);
+
+	// Copy the queues into the ring, every queue is Urgent without a budget.
+	// Returns the bytes copied
+	size_t Process(bool bBudgeted, uint64_t Begin);
+
+	// Copy the next chunk of Upload, at most Limit bytes but at least one row.
+	// 0 if the ring has no room and bWait is false
+	size_t UploadChunk(Request& Upload, size_t Limit, bool bWait);
+
+	bool AllocateStaging(size_t Size, size_t& Offset);
+
+	// Fence the copies issued since the last region
+	void CloseRegion();
+
+	// Free the regions the GPU is done with, or block for the oldest one
+	void RetireRegions(bool bWaitForOldest);
+
+	Settings SchedulerSettings;
+
+	GLuint StagingBuffer = 0;
+
+	// Bytes [Tail, Head) of the ring are in use, wrapping around the end
+	size_t Head = 0;
+	size_t Tail = 0;
+	bool bRegionOpen = false;
+	std::deque<StagedRegion> Regions;
+
+	std::array<std::deque<Request>, static_cast<size_t>(Priority::NumPriorities)> Queues;
+	UploadId NextId = 1;
+	size_t PendingBytes = 0;
+
+	// Statistics since the last report
+	double LastReport = -1.0;
+	size_t BytesUploaded = 0;
+	uint32_t NumUploaded = 0;
+	uint32_t NumFrames = 0;
+	uint32_t NumOverruns = 0;
+	uint32_t NumRingWaits = 0;
+	double MaxFrameMs = 0.0;
+
+	// Overruns since startup, shown by the overlay
+	uint32_t TotalOverruns = 0;
+};
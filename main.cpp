@@ -3,6 +3,16 @@
 #include <array>
 #include <fstream>
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <string>
+#include <limits>
 
 #include <GL/glew.h>
 
@@ -12,23 +22,48 @@
 #include <glm/ext.hpp>
 #include <glm/gtx/string_cast.hpp>
 
+#include "MemoryTracker.h"
+#include "FrameArena.h"
+#include "Log.h"
+#include "JobSystem.h"
+#include "FrameGraph.h"
+#include "AssetManager.h"
+#include "AssetArchive.h"
+#include "AsyncIO.h"
+
+#if defined(BLUEPLANET_TRACK_ALLOCATIONS) && BLUEPLANET_TRACK_ALLOCATIONS
+//Decoded images are attributed to the allocation tag of the loader
+#define STBI_MALLOC(Size) MemoryTracker::Allocate(Size)
+#define STBI_REALLOC(Pointer, Size) MemoryTracker::Reallocate(Pointer, Size)
+#define STBI_FREE(Pointer) MemoryTracker::Free(Pointer)
+#endif
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "OcclusionCuller.h"
+#include "TripleBuffer.h"
+#include "FrameTimeline.h"
+#include "SimulationClock.h"
+#include "FramePacer.h"
+#include "GpuProfiler.h"
+#include "TextOverlay.h"
+#include "CpuProfiler.h"
+#include "SphereMesh.h"
+#include "GLTrace.h"
+#include "GpuResources.h"
+#include "UploadScheduler.h"
+#include "TextureResidency.h"
+#include "GpuPools.h"
+#include "ResourceHandles.h"
+#include "TransformHierarchy.h"
+#include "EntityWorld.h"
+
 int Width = 800;
 int Height = 600;
 
-std::string ReadFile(const char* FilePath)
-{
-	std::string FileContents;
-	if (std::ifstream FileStream{ FilePath, std::ios::in })
-	{
-		//Read inside FileContent the content on file pointed by FilePath
-		FileContents.assign(std::istreambuf_iterator<char>(FileStream), std::istreambuf_iterator<char>());
-	}
-
-	return FileContents;
-};
+// Shaders and textures, loose files are read when it is not open
+AssetArchive Archive;
 
 void CheckShader(GLuint ShaderId)
 {
@@ -57,28 +92,49 @@ void CheckShader(GLuint ShaderId)
 	}
 }
 
-GLuint LoadShaders(const char* VertexShaderFile, const char* FragmentShaderFile)
+// Shader sources read by a worker, compiled into a program on the GL thread
+struct ProgramAsset
+{
+	const char* VertexShaderFile = nullptr;
+	const char* FragmentShaderFile = nullptr;
+	AssetData VertexShaderSource;
+	AssetData FragmentShaderSource;
+	ProgramHandle Id;
+};
+
+bool ReadShaders(ProgramAsset& Program)
 {
-	std::string VertexShaderSource = ReadFile(VertexShaderFile);
-	std::string FragmentShaderSource = ReadFile(FragmentShaderFile);
+	PROFILE_FUNCTION();
+	MEMORY_TAG(Shader);
+
+	Program.VertexShaderSource = Archive.ReadOrLoad(Program.VertexShaderFile);
+	Program.FragmentShaderSource = Archive.ReadOrLoad(Program.FragmentShaderFile);
+
+	return Program.VertexShaderSource.GetSize() > 0 && Program.FragmentShaderSource.GetSize() > 0;
+}
 
-	assert(!VertexShaderSource.empty());
-	assert(!FragmentShaderSource.empty());
+bool CompileShaders(ProgramAsset& Program, HandleTable<ProgramTag>& Programs)
+{
+	PROFILE_FUNCTION();
+	MEMORY_TAG(Shader);
 
 	//Create identifiers of Vertex and Fragment shaders
 	GLuint VertexShaderId = glCreateShader(GL_VERTEX_SHADER);
 	GLuint FragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
 
-	std::cout << "Compiling " << VertexShaderFile << std::endl;
-	const char* VertexShaderSourcePtr = VertexShaderSource.c_str();
-	glShaderSource(VertexShaderId, 1, &VertexShaderSourcePtr, nullptr);
+	std::cout << "Compiling " << Program.VertexShaderFile << std::endl;
+	//Sources are not null terminated, they point into the archive
+	const char* VertexShaderSourcePtr = Program.VertexShaderSource.GetText();
+	const GLint VertexShaderLength = static_cast<GLint>(Program.VertexShaderSource.GetSize());
+	glShaderSource(VertexShaderId, 1, &VertexShaderSourcePtr, &VertexShaderLength);
 	glCompileShader(VertexShaderId);
 	//Verify if compilation was successfull
 	CheckShader(VertexShaderId);
 
-	std::cout << "Compiling " << FragmentShaderFile << std::endl;
-	const char* FragmentShaderSourcePtr = FragmentShaderSource.c_str();
-	glShaderSource(FragmentShaderId, 1, &FragmentShaderSourcePtr, nullptr);
+	std::cout << "Compiling " << Program.FragmentShaderFile << std::endl;
+	const char* FragmentShaderSourcePtr = Program.FragmentShaderSource.GetText();
+	const GLint FragmentShaderLength = static_cast<GLint>(Program.FragmentShaderSource.GetSize());
+	glShaderSource(FragmentShaderId, 1, &FragmentShaderSourcePtr, &FragmentShaderLength);
 	glCompileShader(FragmentShaderId);
 	//Verify if compilation was successfull
 	CheckShader(FragmentShaderId);
@@ -119,81 +175,146 @@ GLuint LoadShaders(const char* VertexShaderFile, const char* FragmentShaderFile)
 	glDeleteShader(VertexShaderId);
 	glDeleteShader(FragmentShaderId);
 
-	return ProgramId;
+	GpuResources::RegisterProgram(ProgramId, Program.FragmentShaderFile);
+
+	//The sources are not needed anymore
+	Program.VertexShaderSource.Reset();
+	Program.FragmentShaderSource.Reset();
+	Program.Id = Programs.Create(ProgramId);
+
+	return Result == GL_TRUE;
 }
 
-GLuint LoadTexture(const char* TextureFile)
+AssetManager::Handle<ProgramAsset> RequestProgram(AssetManager& Assets, HandleTable<ProgramTag>& Programs,
+	const char* VertexShaderFile, const char* FragmentShaderFile)
 {
-	std::cout << "Loading texture " << TextureFile << std::endl;
-
-	stbi_set_flip_vertically_on_load(true);
+	return Assets.Request<ProgramAsset>(std::string("program:") + VertexShaderFile + "|" + FragmentShaderFile, {},
+		[VertexShaderFile, FragmentShaderFile](ProgramAsset& Program)
+		{
+			Program.VertexShaderFile = VertexShaderFile;
+			Program.FragmentShaderFile = FragmentShaderFile;
+			return ReadShaders(Program);
+		},
+		[&Programs](ProgramAsset& Program) { return CompileShaders(Program, Programs); },
+		[&Programs](ProgramAsset& Program) { Programs.Destroy(Program.Id); });
+}
 
+// Mip chain built by a worker, handed to the residency manager on the GL thread
+struct TextureAsset
+{
+	const char* TextureFile = nullptr;
+	MipChain Mips;
 	int TextureWidth = 0;
 	int TextureHeight = 0;
+	TextureHandle Id;
+};
+
+bool DecodeTexture(TextureAsset& Texture, AssetData& Encoded)
+{
+	PROFILE_FUNCTION();
+	MEMORY_TAG(Texture);
+
+	//Per thread, the workers decode several images at once
+	stbi_set_flip_vertically_on_load_thread(1);
+
 	int NumberOfComponents = 0;
 	//load texture on RAM memory
-	unsigned char* TextureData = stbi_load(
-		TextureFile,
-		&TextureWidth,
-		&TextureHeight,
+	unsigned char* TextureData = stbi_load_from_memory(
+		Encoded.GetData(),
+		static_cast<int>(Encoded.GetSize()),
+		&Texture.TextureWidth,
+		&Texture.TextureHeight,
 		&NumberOfComponents,
 		3);
-	assert(TextureData);
 
-	//Generate texture identifier
-	GLuint TextureId;
-	glGenTextures(1, &TextureId);
-
-	// enable texture to be modified
-	glBindTexture(GL_TEXTURE_2D, TextureId);
+	if (TextureData == nullptr)
+	{
+		return false;
+	}
 
-	//copy texture to GPU
-	glTexImage2D(
-		GL_TEXTURE_2D,
-		0,
-		GL_RGB,
-		TextureWidth,
-		TextureHeight,
-		0,
-		GL_RGB,
-		GL_UNSIGNED_BYTE, //because TextureData is unsigned char, char is one byte size
-		TextureData);
+	//Every level is kept in RAM, evicted levels are streamed back from it
+	Texture.Mips = BuildMipChain(TextureData, Texture.TextureWidth, Texture.TextureHeight, 3);
+	stbi_image_free(TextureData);
 
-	// Magnification a minification filters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); //solve aliasing issue
+	return true;
+}
 
-	// Texture wrapping | GL_TEXTURE_WRAP_S - axis U | GL_TEXTURE_WRAP_T - axis V
-	glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+bool UploadTexture(TextureAsset& Texture, HandleTable<TextureTag>& Textures, TextureResidency& Residency)
+{
+	PROFILE_FUNCTION();
+	MEMORY_TAG(Texture);
 
-	//Generate texture mipmap from texture
-	glGenerateMipmap(GL_TEXTURE_2D);
+	//Only the small levels are uploaded now, the rest streams in as the texture is seen
+	Texture.Id = Textures.Create(Residency.AddTexture(std::move(Texture.Mips), Texture.TextureFile));
 
-	//unbind texture because is already has been copied to GPU
-	glBindTexture(GL_TEXTURE_2D, 0);
+	return true;
+}
 
-	stbi_image_free(TextureData);
+AssetManager::Handle<TextureAsset> RequestTexture(AssetManager& Assets, HandleTable<TextureTag>& Textures, TextureResidency& Residency,
+	const char* TextureFile)
+{
+	std::cout << "Loading texture " << TextureFile << std::endl;
 
-	return TextureId;
+	//The encoded image is a view of the archive mapping, or read asynchronously when not packed
+	return Assets.RequestFile<TextureAsset>(TextureFile, AsyncIO::Priority::Visible, {},
+		[TextureFile](TextureAsset& Texture, AssetData& Encoded)
+		{
+			Texture.TextureFile = TextureFile;
+			return DecodeTexture(Texture, Encoded);
+		},
+		[&Textures, &Residency](TextureAsset& Texture) { return UploadTexture(Texture, Textures, Residency); },
+		[&Textures](TextureAsset& Texture) { Textures.Destroy(Texture.Id); });
 }
 
-struct Vertex
+// What a textured draw binds, ready once its program and texture are
+struct MaterialAsset
 {
-	glm::vec3 Position;
-	glm::vec3 Normal;
-	glm::vec3 Color;
-	glm::vec2 UV;
+	ProgramHandle Program;
+	TextureHandle Texture;
 };
 
+AssetManager::Handle<MaterialAsset> RequestMaterial(AssetManager& Assets, const char* Name,
+	const AssetManager::Handle<ProgramAsset>& Program, const AssetManager::Handle<TextureAsset>& Texture)
+{
+	//The program and texture are owned by their own assets, nothing to release.
+	//The handles follow them when they are replaced
+	return Assets.Request<MaterialAsset>(std::string("material:") + Name, { Program.GetRecord(), Texture.GetRecord() },
+		nullptr,
+		[Program, Texture](MaterialAsset& Material)
+		{
+			Material.Program = Program.Get().Id;
+			Material.Texture = Texture.Get().Id;
+			return true;
+		},
+		nullptr);
+}
+
 struct DirectionalLight
 {
 	glm::vec3 Direction;
 	GLfloat Intensity;
 };
 
-GLuint LoadGeometry()
+// GL objects of one mesh, deleted together
+struct MeshBuffers
+{
+	GLuint VAO = 0;
+	GLuint VertexBuffer = 0;
+	GLuint ElementBuffer = 0;
+};
+
+void DeleteMesh(MeshBuffers& Mesh)
 {
+	GpuResources::DeleteVertexArray(Mesh.VAO);
+	GpuResources::DeleteBuffer(Mesh.VertexBuffer);
+	GpuResources::DeleteBuffer(Mesh.ElementBuffer);
+	Mesh = MeshBuffers{};
+}
+
+MeshBuffers LoadGeometry()
+{
+	MEMORY_TAG(Mesh);
+
 	//Define a triangle in normalized coordinates
 	//{Position, Color, UV}
 	std::array<Vertex, 6> Quad = {
@@ -225,13 +346,14 @@ GLuint LoadGeometry()
 	};
 
 	//Copy triangle vertices to GPU memory
-	GLuint VertexBuffer;
+	MeshBuffers Mesh;
+	GLuint& VertexBuffer = Mesh.VertexBuffer;
 
 	// Ask OpenGL generate an identifier of VBO
 	glGenBuffers(1, &VertexBuffer);
 
 	//Ask OpenGL to generate EBO identifier
-	GLuint ElementBuffer = 0;
+	GLuint& ElementBuffer = Mesh.ElementBuffer;
 	glGenBuffers(1, &ElementBuffer);
 
 	// Activate VertexBuffer as the buffer where we copy the triangle data to
@@ -239,17 +361,20 @@ GLuint LoadGeometry()
 
 	//Copy data into video memory
 	glBufferData(GL_ARRAY_BUFFER, sizeof(Quad), Quad.data(), GL_STATIC_DRAW);
+	GpuResources::RegisterBuffer(VertexBuffer, sizeof(Quad), GpuResources::Category::Geometry, "Quad vertexes");
 
 	//Copy ElementBuffer data to GPU
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ElementBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indexes), Indexes.data(), GL_STATIC_DRAW);
+	GpuResources::RegisterBuffer(ElementBuffer, sizeof(Indexes), GpuResources::Category::Geometry, "Quad indexes");
 
 	//Generate Vertex Array Object (VAO)
-	GLuint VAO;
+	GLuint& VAO = Mesh.VAO;
 	glGenVertexArrays(1, &VAO);
 
 	//Enable VAO
 	glBindVertexArray(VAO);
+	GpuResources::RegisterVertexArray(VAO, GpuResources::Category::Geometry, "Quad");
 
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
@@ -273,137 +398,112 @@ GLuint LoadGeometry()
 
 	glBindVertexArray(0);
 
-	return VAO;
+	return Mesh;
 }
 
-void GenerateSphereMesh(
-	GLuint Resolution, 
-	std::vector<Vertex>& Vertexes,
-	std::vector<glm::ivec3>& Indexes)
+// Sphere generated by a worker, uploaded on the GL thread
+struct SphereAsset
 {
-	Vertexes.clear();
-	Indexes.clear();
-
-	constexpr float Pi = glm::pi<float>();
-	constexpr float TwoPi = glm::two_pi<float>();
-	float InvResolution = 1.0f / static_cast<float>(Resolution - 1);
-
-	//for (GLuint UIndex = 0; UIndex < Resolution; ++UIndex)
-	//{
-	//	const float U = UIndex * InvResolution;
-	//	const float Theta = glm::mix(0.0f, Pi, U);
-
-	//	for (GLuint VIndex = 0; VIndex < Resolution; ++VIndex)
-	//	{
-	//		const float V = VIndex * InvResolution;
-	//		const float Phi = glm::mix(0.0f, TwoPi, V);
-
-	//		glm::vec3 VertexPosition = {
-	//			glm::sin(Theta) * glm::cos(Phi),
-	//			glm::sin(Theta) * glm::sin(Phi),
-	//			glm::cos(Theta)
-	//		};
-
-	//		Vertex Vertex{
-	//			VertexPosition,
-	//			glm::normalize(VertexPosition),
-	//			glm::vec3(1.0f, 1.0f, 1.0f),
-	//			glm::vec2( 1.0f - U, V)
-	//		};
-
-	//		Vertexes.push_back(Vertex);
-	//	}
+	std::vector<Vertex> Vertexes;
+	std::vector<glm::ivec3> Triangles;
+	VertexArrayHandle VAO;
 
-	//}
+	// Vertexes and indexes are suballocated from the buffer heap
+	BufferHeap::Allocation VertexRange;
+	BufferHeap::Allocation IndexRange;
 
-	for (GLuint UIndex = 0; UIndex < Resolution; ++UIndex)
-	{
-		const float U = UIndex * InvResolution;
-		const float Theta = glm::mix(0.0f, TwoPi, static_cast<float>(U));
+	GLuint NumVertexes = 0;
+	GLuint NumIndexes = 0;
 
-		for (GLuint VIndex = 0; VIndex < Resolution; ++VIndex)
-		{
-			const float V = VIndex * InvResolution;
-			const float Phi = glm::mix(0.0f, Pi, static_cast<float>(V));
-
-			glm::vec3 VertexPosition =
-			{
-				glm::cos(Theta) * glm::sin(Phi),
-				glm::sin(Theta) * glm::sin(Phi),
-				glm::cos(Phi)
-			};
+	// Vertexes and indexes still being copied to the buffers
+	UploadScheduler::UploadId VertexesUpload = 0;
+	UploadScheduler::UploadId IndexesUpload = 0;
+};
 
-			Vertexes.push_back(Vertex{
-				VertexPosition,
-				glm::normalize(VertexPosition),
-				glm::vec3{ 1.0f, 1.0f, 1.0f },
-				glm::vec2{ 1.0f - U, V }
-				});
-		}
-	}
+bool GenerateSphere(SphereAsset& Sphere)
+{
+	PROFILE_FUNCTION();
+	MEMORY_TAG(Mesh);
 
-	for (GLuint U = 0; U < Resolution - 1; ++U)
-	{
-		for (GLuint V = 0; V < Resolution - 1; ++V)
-		{
-			GLuint P0 = U + V * Resolution;
-			GLuint P1 = (U + 1) + V * Resolution;
-			GLuint P2 = (U + 1) + (V + 1) * Resolution;
-			GLuint P3 = U + (V + 1) * Resolution;
+	GenerateSphereMesh(50, Sphere.Vertexes, Sphere.Triangles);
 
-			Indexes.push_back(glm::ivec3{ P0, P1, P3 });
-			Indexes.push_back(glm::ivec3{ P3, P1, P2 });
-		}
-		
-	}
+	Sphere.NumVertexes = Sphere.Vertexes.size();
+	Sphere.NumIndexes = Sphere.Triangles.size() * 3;
 
+	return true;
 }
 
-GLuint LoadSphere(GLuint& NumVertexes, GLuint& NumIndexes)
+bool UploadSphere(SphereAsset& Sphere, HandleTable<VertexArrayTag>& VertexArrays, BufferHeap& Heap, UploadScheduler& Uploads)
 {
-	std::vector<Vertex> Vertexes;
-	std::vector<glm::ivec3> Triangles;
-	GenerateSphereMesh(50, Vertexes, Triangles);
-
-	NumVertexes = Vertexes.size();
-	NumIndexes = Triangles.size() * 3;
+	PROFILE_FUNCTION();
+	MEMORY_TAG(Mesh);
 
-	GLuint VertexBuffer;
-	glGenBuffers(1, &VertexBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, Vertexes.size() * sizeof(Vertex), Vertexes.data(), GL_STATIC_DRAW);
+	const std::vector<Vertex>& Vertexes = Sphere.Vertexes;
+	const std::vector<glm::ivec3>& Triangles = Sphere.Triangles;
+	const GLuint NumIndexes = Sphere.NumIndexes;
 
-	GLuint ElementBuffer;
-	glGenBuffers(1, &ElementBuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ElementBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-				NumIndexes * sizeof(GLuint), //Triangles.size() * sizeof(glm::ivec3)
-				Triangles.data(),
-				GL_STATIC_DRAW);
+	const BufferHeap::Allocation& VertexRange = Sphere.VertexRange = Heap.Allocate(Vertexes.size() * sizeof(Vertex));
+	const BufferHeap::Allocation& IndexRange = Sphere.IndexRange = Heap.Allocate(NumIndexes * sizeof(GLuint));
 
-	GLuint VAO;
+	GLuint VAO = 0;
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
+	GpuResources::RegisterVertexArray(VAO, GpuResources::Category::Geometry, "Sphere");
+	Sphere.VAO = VertexArrays.Create(VAO);
 
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
 	glEnableVertexAttribArray(2);
 	glEnableVertexAttribArray(3);
 
-	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ElementBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, VertexRange.Buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexRange.Buffer);
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), nullptr);
+	//The vertexes start at the offset of their range, the draws pass the offset of the indexes
+	const GLintptr VertexOffset = VertexRange.Offset;
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+		reinterpret_cast<void*>(VertexOffset));
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, sizeof(Vertex),
-		reinterpret_cast<void*>(offsetof(Vertex, Normal)));
+		reinterpret_cast<void*>(VertexOffset + offsetof(Vertex, Normal)));
 	glVertexAttribPointer(2, 3, GL_FLOAT, GL_TRUE, sizeof(Vertex),
-		reinterpret_cast<void*>(offsetof(Vertex, Color)));
+		reinterpret_cast<void*>(VertexOffset + offsetof(Vertex, Color)));
 	glVertexAttribPointer(3, 2, GL_FLOAT, GL_TRUE, sizeof(Vertex),
-		reinterpret_cast<void*>(offsetof(Vertex, UV)));
+		reinterpret_cast<void*>(VertexOffset + offsetof(Vertex, UV)));
 
 	glBindVertexArray(0);
 
-	return VAO;
+	//The CPU copies are freed once the GPU has its own
+	Sphere.VertexesUpload = Uploads.QueueBuffer(VertexRange.Buffer, VertexRange.Offset, Vertexes.size() * sizeof(Vertex), Vertexes.data(),
+		UploadScheduler::Priority::Normal,
+		[&Sphere]()
+		{
+			Sphere.Vertexes = std::vector<Vertex>();
+			Sphere.VertexesUpload = 0;
+		});
+	Sphere.IndexesUpload = Uploads.QueueBuffer(IndexRange.Buffer, IndexRange.Offset, NumIndexes * sizeof(GLuint), Triangles.data(),
+		UploadScheduler::Priority::Normal,
+		[&Sphere]()
+		{
+			Sphere.Triangles = std::vector<glm::ivec3>();
+			Sphere.IndexesUpload = 0;
+		});
+
+	return true;
+}
+
+AssetManager::Handle<SphereAsset> RequestSphere(AssetManager& Assets, HandleTable<VertexArrayTag>& VertexArrays, BufferHeap& Heap,
+	UploadScheduler& Uploads)
+{
+	return Assets.Request<SphereAsset>("sphere:50", {}, GenerateSphere,
+		[&VertexArrays, &Heap, &Uploads](SphereAsset& Sphere) { return UploadSphere(Sphere, VertexArrays, Heap, Uploads); },
+		[&VertexArrays, &Heap, &Uploads](SphereAsset& Sphere)
+		{
+			Uploads.Cancel(Sphere.VertexesUpload);
+			Uploads.Cancel(Sphere.IndexesUpload);
+			VertexArrays.Destroy(Sphere.VAO);
+			Heap.Free(Sphere.VertexRange);
+			Heap.Free(Sphere.IndexRange);
+		});
 }
 
 class FlyCamera
@@ -441,10 +541,14 @@ public:
 		return glm::lookAt(Location, Location + Direction, Up);
 	}
 
+	glm::mat4 GetProjection() const
+	{
+		return glm::perspective(FieldOfView, AspectRatio, Near, Far);
+	}
+
 	glm::mat4 GetViewProjection() const
 	{
-		glm::mat4 Projection = glm::perspective(FieldOfView, AspectRatio, Near, Far);
-		return Projection * GetView();
+		return GetProjection() * GetView();
 	}
 
 	//Iterativity parameters
@@ -464,14 +568,23 @@ public:
 };
 
 FlyCamera Camera;
+SimulationClock Clock;
 bool bEnableMouseMovement = false;
 glm::vec2 PreviousCursor{ 0.0f, 0.0f };
 
+//Set by the callbacks when something that changes the image happened since the last frame
+bool bInputChanged = true;
+bool bIconified = false;
+bool bShowOverlay = true;
+
+// Chrome trace written by CPU profiler captures
+std::string TraceFile = "profile_capture.json";
+
 void MouseButtonCallback(GLFWwindow* Window, int Button, int Action, int Modifiers)
 {
-	std::cout << "Button: " << Button <<
-		" Action: " << Action <<
-		" Modifiers: " << Modifiers << std::endl;
+	bInputChanged = true;
+
+	LOG_DEBUG("Button: %d Action: %d Modifiers: %d", Button, Action, Modifiers);
 
 	if (Button == GLFW_MOUSE_BUTTON_LEFT)
 	{
@@ -501,50 +614,389 @@ void MouseMotionCallback(GLFWwindow* Window, double X, double Y)
 		glm::vec2 CurrentCursor{ X, Y };
 		glm::vec2 DeltaCursor = CurrentCursor - PreviousCursor;
 
-		std::cout << glm::to_string(DeltaCursor) << std::endl;
+		LOG_TRACE("Mouse delta: %.1f, %.1f", DeltaCursor.x, DeltaCursor.y);
 
 		Camera.Look(DeltaCursor.x, DeltaCursor.y);
+		bInputChanged = true;
 
 		PreviousCursor = CurrentCursor;
 	}
 	
 }
 
+void KeyCallback(GLFWwindow* Window, int Key, int ScanCode, int Action, int Modifiers)
+{
+	if (Action != GLFW_PRESS)
+	{
+		return;
+	}
+
+	bInputChanged = true;
+
+	// Time warp for orbital playback: '.' faster, ',' slower, '/' back to real time
+	if (Key == GLFW_KEY_PERIOD)
+	{
+		Clock.SetTimeWarp(glm::min(Clock.GetTimeWarp() * 2.0, 65536.0));
+	}
+
+	if (Key == GLFW_KEY_COMMA)
+	{
+		Clock.SetTimeWarp(Clock.GetTimeWarp() * 0.5);
+	}
+
+	if (Key == GLFW_KEY_SLASH)
+	{
+		Clock.SetTimeWarp(1.0);
+	}
+
+	if (Key == GLFW_KEY_F1)
+	{
+		bShowOverlay = !bShowOverlay;
+	}
+
+	// F2 starts and stops a CPU profiler capture
+	if (Key == GLFW_KEY_F2)
+	{
+		if (CpuProfiler::IsCapturing())
+		{
+			CpuProfiler::EndCapture(TraceFile.c_str());
+		}
+		else
+		{
+			CpuProfiler::BeginCapture();
+		}
+	}
+
+	// F3 writes every GL call of the next frame to a file when GL tracing is compiled in
+	if (Key == GLFW_KEY_F3)
+	{
+		GLTRACE_REQUEST_FRAME_LOG();
+	}
+}
+
 void Resize(GLFWwindow* Window, int NewWidth, int NewHeight)
 {
 	Width = NewWidth;
 	Height = NewHeight;
 
-	Camera.AspectRatio = static_cast<float>(Width) / Height;
-	glViewport(0, 0, Width, Height);
+	//The viewport itself is set by the render thread, which owns the GL context
+	if (Height > 0)
+	{
+		Camera.AspectRatio = static_cast<float>(Width) / Height;
+	}
+
+	bInputChanged = true;
 }
 
-int main()
+void IconifyCallback(GLFWwindow* Window, int Iconified)
 {
+	bIconified = Iconified == GLFW_TRUE;
+	bInputChanged = true;
+}
 
-	// initialize GLFW
-	assert(glfwInit() == GLFW_TRUE);
+//The window content was damaged (uncovered, moved between monitors) and must be drawn again
+void RefreshCallback(GLFWwindow* Window)
+{
+	bInputChanged = true;
+}
 
-	// Create window
-	GLFWwindow* Window = glfwCreateWindow(Width, Height, "Blue Planet", nullptr, nullptr);
-	assert(Window);
+void SetSphereUniforms(
+	GLuint ProgramId,
+	const glm::mat4& ModelViewProjection,
+	const glm::mat3& NormalMatrix,
+	const glm::vec4& LightDirection,
+	const DirectionalLight& Light)
+{
+	GLint ModelViewProjectionLoc = glGetUniformLocation(ProgramId, "ModelViewProjection");
+	glUniformMatrix4fv(ModelViewProjectionLoc, 1, GL_FALSE, glm::value_ptr(ModelViewProjection));
 
-	//sign callbacks on GLFW
-	glfwSetMouseButtonCallback(Window, MouseButtonCallback);
-	glfwSetCursorPosCallback(Window, MouseMotionCallback);
+	GLint NormalMatrixLoc = glGetUniformLocation(ProgramId, "NormalMatrix");
+	glUniformMatrix3fv(NormalMatrixLoc, 1, GL_FALSE, glm::value_ptr(NormalMatrix));
 
-	//Call Resize aways when the window aspect ratio change
-	glfwSetFramebufferSizeCallback(Window, Resize);
+	GLint LightDirectionLoc = glGetUniformLocation(ProgramId, "LightDirection");
+	glUniform3fv(LightDirectionLoc, 1, glm::value_ptr(LightDirection));
+
+	GLint LightIntensityLoc = glGetUniformLocation(ProgramId, "LightIntensity");
+	glUniform1f(LightIntensityLoc, Light.Intensity);
+}
+
+// Pixels spanned on screen by a sphere centered at ViewCenter, in view space. Unbounded from inside
+float GetProjectedDiameter(const glm::vec4& ViewCenter, float Radius, const glm::mat4& Projection, int ViewportHeight)
+{
+	const float Distance = glm::length(glm::vec3(ViewCenter));
+	if (Distance <= Radius)
+	{
+		return std::numeric_limits<float>::max();
+	}
+
+	//Tangent of the half angle of the silhouette cone, scaled by the focal length in pixels
+	const float TanHalfAngle = Radius / glm::sqrt(Distance * Distance - Radius * Radius);
+	return TanHalfAngle * Projection[1][1] * static_cast<float>(ViewportHeight);
+}
+
+// One line per GPU pass: last, min, avg and max time in milliseconds
+void FormatProfilerOverlay(const GpuProfiler& Profiler, char* Text, size_t TextSize)
+{
+	if (!Profiler.IsSupported())
+	{
+		std::snprintf(Text, TextSize, "GPU timer queries not supported");
+		return;
+	}
+
+	const GpuProfiler::PassStatistics FrameStats = Profiler.GetFrameStatistics();
+	int Length = std::snprintf(Text, TextSize, "GPU %-8s %6.3f ms (min %6.3f avg %6.3f max %6.3f)\n",
+		FrameStats.Name, FrameStats.LastMs, FrameStats.MinMs, FrameStats.AverageMs, FrameStats.MaxMs);
+
+	for (int PassIndex = 0; PassIndex < Profiler.GetNumPasses() && Length > 0 && Length < static_cast<int>(TextSize); ++PassIndex)
+	{
+		const GpuProfiler::PassStatistics Pass = Profiler.GetPassStatistics(PassIndex);
+		Length += std::snprintf(Text + Length, TextSize - Length, "    %-8s %6.3f ms (min %6.3f avg %6.3f max %6.3f)\n",
+			Pass.Name, Pass.LastMs, Pass.MinMs, Pass.AverageMs, Pass.MaxMs);
+	}
+}
+
+void WriteBenchmarkReport(const char* FilePath, uint64_t NumFrames, double TotalRenderTime, const GpuProfiler& Profiler)
+{
+	std::ofstream Report{ FilePath };
+	if (!Report)
+	{
+		std::cout << "Could not write benchmark report " << FilePath << std::endl;
+		return;
+	}
+
+	Report << "{\n  \"frames\": " << NumFrames
+		<< ",\n  \"cpu_render_avg_ms\": " << (NumFrames > 0 ? 1000.0 * TotalRenderTime / NumFrames : 0.0)
+		<< ",\n  \"gpu\": ";
+	Profiler.WriteJson(Report);
+	Report << "\n}\n";
+
+	std::cout << "Benchmark report written to " << FilePath << std::endl;
+}
+
+// Components of the bodies of the scene
+struct BodyComponent
+{
+	TransformHierarchy::NodeId Node;
+};
+
+// World space bounding sphere, centered on the transform node
+struct BoundsComponent
+{
+	glm::vec3 Center;
+	float Radius;
+};
+
+struct VisibilityComponent
+{
+	bool bVisible;
+};
+
+// Immutable state of one simulated frame, everything the render thread needs to draw it
+struct FrameSnapshot
+{
+	uint64_t FrameIndex = 0;
+
+	// When the input used for this frame was sampled, to measure input to present latency
+	double InputSampleTime = 0.0;
+
+	// Interpolated world time and the cloud layer offset derived from it in double precision
+	double Time = 0.0;
+	glm::vec2 CloudsOffset{ 0.0f, 0.0f };
+
+	glm::mat4 View{ 1.0f };
+	glm::mat4 Projection{ 1.0f };
+	glm::mat4 ModelMatrix{ 1.0f };
+
+	// Normals from model to view space
+	glm::mat3 NormalMatrix{ 1.0f };
+
+	DirectionalLight Light{ glm::vec3{ 0.0f, 0.0f, -1.0f }, 1.0f };
+
+	bool bPlanetVisible = true;
+	bool bShowOverlay = true;
+
+	// Diameter of the planet on screen in pixels, picks the resolution of its textures
+	float PlanetScreenSize = 0.0f;
+
+	// Simulation statistics for the overlay, allocated in the frame arena
+	const char* StatusText = nullptr;
+
+	int ViewportWidth = 0;
+	int ViewportHeight = 0;
+};
+
+// State shared between the simulation (main) thread and the render thread
+struct RenderThreadState
+{
+	TripleBuffer<FrameSnapshot> Snapshots;
+	FrameTimeline Timeline;
+
+	// Transient data referenced by the snapshots. Frame N is built in FrameArenas[N % 2];
+	// the simulation never runs more than one frame ahead of the render thread, so the
+	// arena it resets is not being read anymore
+	std::array<FrameArena, 2> FrameArenas;
+
+	std::atomic<bool> bReady{ false };
+	std::atomic<bool> bQuit{ false };
+
+	// Index of the last frame the render thread finished submitting
+	std::atomic<uint64_t> RenderedFrame{ 0 };
+
+	FramePacer::Settings PacingSettings;
+	double RefreshRate = 60.0;
+
+	UploadScheduler::Settings UploadSettings;
+	TextureResidency::Settings ResidencySettings;
+
+	// Just-in-time pacing: when the render thread wants to start the next frame, 0 if as soon as possible
+	std::atomic<double> NextRenderStart{ 0.0 };
+
+	// Wakes the render thread when a snapshot is published, so it sleeps while nothing is drawn
+	std::mutex WakeMutex;
+	std::condition_variable WakeCondition;
+
+	// Size of one cloud texel in UV units, set once the texture is loaded
+	std::atomic<float> CloudsTexelSize{ 1.0f / 2048.0f };
+
+	// Benchmark mode: report written by the render thread when it exits
+	std::string BenchmarkFile;
+
+	// Set from any thread when the image changed outside the simulation (e.g. a streamed asset arrived)
+	std::atomic<bool> bRedrawRequested{ false };
+
+	void PublishSnapshot()
+	{
+		Snapshots.Publish();
+
+		{
+			std::lock_guard<std::mutex> Lock(WakeMutex);
+		}
+		WakeCondition.notify_one();
+	}
+
+	void RequestRedraw()
+	{
+		bRedrawRequested = true;
+		glfwPostEmptyEvent();
+	}
+};
+
+struct AppSettings
+{
+	FramePacer::Settings Pacing;
+
+	// Render on demand: only draw when something visible changed
+	bool bOnDemand = false;
+
+	// Rate at which the simulation wakes up when idle in on-demand mode
+	double IdleFrameRate = 4.0;
+
+	// Benchmark mode: run a fixed number of frames and write a JSON report
+	std::string BenchmarkFile;
+	uint64_t BenchmarkFrames = 600;
+
+	// CPU profiler capture of the whole run
+	std::string TraceFile;
+
+	// Log output, stderr when empty
+	std::string LogFile;
+
+	// Packed shaders and textures, written by AssetPacker
+	std::string ArchiveFile = "assets.pak";
+
+	// Texture and buffer uploads per frame
+	UploadScheduler::Settings Uploads;
+
+	// Video memory of the textures
+	TextureResidency::Settings Residency;
+};
+
+// Command line: --swap-interval N, --frames-in-flight N, --jit, --on-demand, --idle-fps N,
+// --benchmark FILE, --benchmark-frames N, --trace FILE, --log FILE, --archive FILE,
+// --upload-budget MB, --upload-ms MS, --texture-budget MB
+AppSettings ParseCommandLine(int argc, char** argv)
+{
+	AppSettings Settings;
+
+	for (int Index = 1; Index < argc; ++Index)
+	{
+		if (std::strcmp(argv[Index], "--swap-interval") == 0 && Index + 1 < argc)
+		{
+			Settings.Pacing.SwapInterval = std::atoi(argv[++Index]);
+		}
+		else if (std::strcmp(argv[Index], "--frames-in-flight") == 0 && Index + 1 < argc)
+		{
+			Settings.Pacing.MaxFramesInFlight = std::atoi(argv[++Index]);
+		}
+		else if (std::strcmp(argv[Index], "--jit") == 0)
+		{
+			Settings.Pacing.bJustInTime = true;
+		}
+		else if (std::strcmp(argv[Index], "--on-demand") == 0)
+		{
+			Settings.bOnDemand = true;
+		}
+		else if (std::strcmp(argv[Index], "--idle-fps") == 0 && Index + 1 < argc)
+		{
+			Settings.IdleFrameRate = glm::max(std::atof(argv[++Index]), 0.01);
+		}
+		else if (std::strcmp(argv[Index], "--benchmark") == 0 && Index + 1 < argc)
+		{
+			Settings.BenchmarkFile = argv[++Index];
+		}
+		else if (std::strcmp(argv[Index], "--benchmark-frames") == 0 && Index + 1 < argc)
+		{
+			Settings.BenchmarkFrames = std::strtoull(argv[++Index], nullptr, 10);
+		}
+		else if (std::strcmp(argv[Index], "--trace") == 0 && Index + 1 < argc)
+		{
+			Settings.TraceFile = argv[++Index];
+		}
+		else if (std::strcmp(argv[Index], "--log") == 0 && Index + 1 < argc)
+		{
+			Settings.LogFile = argv[++Index];
+		}
+		else if (std::strcmp(argv[Index], "--archive") == 0 && Index + 1 < argc)
+		{
+			Settings.ArchiveFile = argv[++Index];
+		}
+		else if (std::strcmp(argv[Index], "--upload-budget") == 0 && Index + 1 < argc)
+		{
+			Settings.Uploads.BytesPerFrame = static_cast<size_t>(glm::max(std::atof(argv[++Index]), 0.0) * 1024.0 * 1024.0);
+		}
+		else if (std::strcmp(argv[Index], "--upload-ms") == 0 && Index + 1 < argc)
+		{
+			Settings.Uploads.MillisecondsPerFrame = glm::max(std::atof(argv[++Index]), 0.0);
+		}
+		else if (std::strcmp(argv[Index], "--texture-budget") == 0 && Index + 1 < argc)
+		{
+			Settings.Residency.BudgetBytes = static_cast<size_t>(glm::max(std::atof(argv[++Index]), 0.0) * 1024.0 * 1024.0);
+		}
+	}
+
+	return Settings;
+}
 
-	//Activate context created on window Window
+void RenderThreadMain(GLFWwindow* Window, RenderThreadState& State)
+{
+	PROFILE_THREAD_NAME("Render");
+
+	//Activate context created on window Window. From now on this thread owns it
 	glfwMakeContextCurrent(Window);
 
-	//Enable or disable V-Sync
-	glfwSwapInterval(1);
+	//Released when the function returns, after the destructors of the GL objects declared below
+	struct ContextRelease
+	{
+		~ContextRelease() { glfwMakeContextCurrent(nullptr); }
+	} ReleaseContext;
 
 	//Initialize glew
 	assert(glewInit() == GLEW_OK);
 
+	//Enables V-Sync and bounds the number of frames queued on the GPU
+	FramePacer Pacer(State.PacingSettings);
+	Pacer.SetRefreshRate(State.RefreshRate);
+
 	//Verify OpenGL version
 	GLint GLMajorVersion = 0;
 	GLint GLMinorVersion = 0;
@@ -558,32 +1010,76 @@ int main()
 	std::cout << "OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
 	std::cout << "GLSL Version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 
-	Resize(Window, Width, Height);
+	//Outlive the assets, their release cancels what they still have queued and frees their ranges
+	BufferHeap Heap(BufferHeap::Settings{});
+	UploadScheduler Uploads(State.UploadSettings);
+	TextureResidency Residency(Uploads, State.ResidencySettings);
+
+	//Draws hold handles, the objects behind them can be replaced while running
+	HandleTable<ProgramTag> Programs(GpuResources::DeleteProgram);
+	HandleTable<TextureTag> Textures([&Residency](GLuint Texture) { Residency.RemoveTexture(Texture); });
+	HandleTable<VertexArrayTag> VertexArrays(GpuResources::DeleteVertexArray);
+
+	//Every load starts at once: the workers read and decode files while this thread compiles and uploads
+	AssetManager Assets;
+	Assets.SetArchive(&Archive);
+	Assets.SetDecodedCallback([&State]() { State.RequestRedraw(); });
+
+	const auto SurfaceProgram = RequestProgram(Assets, Programs, "shaders/triangle_vert.glsl", "shaders/triangle_frag.glsl");
+	const auto CloudsProgram = RequestProgram(Assets, Programs, "shaders/triangle_vert.glsl", "shaders/clouds_frag.glsl");
+	const auto OverlayProgram = RequestProgram(Assets, Programs, "shaders/overlay_vert.glsl", "shaders/overlay_frag.glsl");
 
-	GLuint ProgramId = LoadShaders("shaders/triangle_vert.glsl", "shaders/triangle_frag.glsl");
+	const auto SurfaceTexture = RequestTexture(Assets, Textures, Residency, "textures/earth_2k.jpg");
+	const auto CloudsTexture = RequestTexture(Assets, Textures, Residency, "textures/earth_clouds_2k.jpg");
 
-	GLuint TextureId = LoadTexture("textures/earth_2k.jpg");
-	GLuint CloudTextureId = LoadTexture("textures/earth_clouds_2k.jpg");
+	const auto SurfaceMaterial = RequestMaterial(Assets, "Earth", SurfaceProgram, SurfaceTexture);
+	const auto CloudsMaterial = RequestMaterial(Assets, "Clouds", CloudsProgram, CloudsTexture);
 
-	GLuint QuadVAO = LoadGeometry();
+	const auto SphereGeometry = RequestSphere(Assets, VertexArrays, Heap, Uploads);
 
-	GLuint SphereNumVertexes = 0;
-	GLuint SphereNumIndexes = 0;
-	GLuint SphereVAO = LoadSphere(SphereNumVertexes, SphereNumIndexes);
+	//The quad is tiny, built here while the rest loads
+	MeshBuffers Quad = LoadGeometry();
+
+	Assets.WaitAll();
+	Assets.PrintReport();
+
+	//The first frame is drawn with every texel in place, as far as the texture budget allows
+	Uploads.Flush();
+	while (Residency.IsStreaming())
+	{
+		Residency.Update();
+		Uploads.Flush();
+	}
+	Residency.PrintReport();
+
+	assert(SurfaceMaterial.IsReady() && CloudsMaterial.IsReady() && OverlayProgram.IsReady() && SphereGeometry.IsReady());
+
+	const MaterialAsset& Surface = SurfaceMaterial.Get();
+	const MaterialAsset& Clouds = CloudsMaterial.Get();
+	const GLuint OverlayProgramId = Programs.Resolve(OverlayProgram.Get().Id);
+
+	if (CloudsTexture.Get().TextureWidth > 0)
+	{
+		State.CloudsTexelSize = 1.0f / CloudsTexture.Get().TextureWidth;
+	}
+
+	const SphereAsset& Sphere = SphereGeometry.Get();
+	const void* SphereIndexOffset = reinterpret_cast<const void*>(Sphere.IndexRange.Offset);
+	const GLuint SphereNumVertexes = SphereGeometry.Get().NumVertexes;
+	const GLuint SphereNumIndexes = SphereGeometry.Get().NumIndexes;
 
 	std::cout << "Number of vertexes of sphere" << SphereNumVertexes << std::endl;
 	std::cout << "Number of indexes of sphere" << SphereNumIndexes << std::endl;
 
-	//Model Matrix
-	glm::mat4 I = glm::identity<glm::mat4>();
-	glm::mat4 ModelMatrix = glm::rotate(I, glm::radians(90.0f), glm::vec3{ 1, 0, 0});
+	GpuResources::PrintReport();
+
+	char HeapSummary[128];
+	Heap.FormatSummary(HeapSummary, sizeof(HeapSummary));
+	std::cout << HeapSummary << std::endl;
 
 	//Define background color
 	glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
 
-	// store previous frame time
-	double PreviousTime = glfwGetTime();
-
 	// Enable Backface culling
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_BACK);
@@ -592,110 +1088,635 @@ int main()
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
 
+	int ViewportWidth = 0;
+	int ViewportHeight = 0;
+
+	GpuProfiler Profiler;
+	TextOverlay Overlay(OverlayProgramId);
+	char OverlayText[1024] = {};
+
+	uint64_t NumRenderedFrames = 0;
+	double TotalRenderTime = 0.0;
+
+	State.bReady = true;
+
+	while (!State.bQuit)
+	{
+		MEMORY_TAG(Frame);
+
+		//Assets requested after startup are finalized between frames, their data copied within the budget
+		Assets.Update();
+		Uploads.Update();
+
+		//Never queue more than MaxFramesInFlight frames on the GPU
+		{
+			PROFILE_SCOPE("WaitForFrameSlot");
+			Pacer.WaitForFrameSlot();
+		}
+
+		//Wait for the simulation thread to publish a new frame
+		if (!State.Snapshots.Acquire())
+		{
+			std::unique_lock<std::mutex> Lock(State.WakeMutex);
+			State.WakeCondition.wait_for(Lock, std::chrono::milliseconds(100),
+				[&State] { return State.bQuit || State.Snapshots.HasPending(); });
+			continue;
+		}
+
+		PROFILE_SCOPE("RenderFrame");
+
+		const FrameSnapshot& Frame = State.Snapshots.GetReadSlot();
+		const double RenderBegin = glfwGetTime();
+		Pacer.BeginSubmit(RenderBegin);
+
+		if (Frame.ViewportWidth != ViewportWidth || Frame.ViewportHeight != ViewportHeight)
+		{
+			ViewportWidth = Frame.ViewportWidth;
+			ViewportHeight = Frame.ViewportHeight;
+			glViewport(0, 0, ViewportWidth, ViewportHeight);
+		}
+
+		//Resolved every frame, a replaced program or texture is drawn from the next frame
+		const GLuint ProgramId = Programs.Resolve(Surface.Program);
+		const GLuint TextureId = Textures.Resolve(Surface.Texture);
+		const GLuint CloudsProgramId = Programs.Resolve(Clouds.Program);
+		const GLuint CloudTextureId = Textures.Resolve(Clouds.Texture);
+		const GLuint SphereVAO = VertexArrays.Resolve(Sphere.VAO);
+
+		//An equirectangular map wraps the whole equator, pi times the diameter of the disc
+		if (Frame.bPlanetVisible)
+		{
+			const float Coverage = glm::pi<float>() * Frame.PlanetScreenSize;
+			Residency.SetCoverage(TextureId, Coverage);
+			Residency.SetCoverage(CloudTextureId, Coverage);
+		}
+		Residency.Update();
+
+		Profiler.BeginFrame();
+
+		{
+			GpuProfiler::Scope Zone(Profiler, "clear");
+
+			//Clear framebuffer. GL_COLOR_BUFFER_BIT clear color buffer and fullfil with the color defined on glClearColor
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
+
+		const glm::mat3& NormalMatrix = Frame.NormalMatrix;
+		glm::mat4 ViewProjectionMatrix = Frame.Projection * Frame.View;
+		glm::mat4 ModelViewProjection = ViewProjectionMatrix * Frame.ModelMatrix;
+		glm::vec4 LightDirection = Frame.View * glm::vec4{ Frame.Light.Direction, 0.0f };
+
+		//glBindVertexArray(Quad.VAO);
+		glBindVertexArray(SphereVAO);
+
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+		if (Frame.bPlanetVisible)
+		{
+			GpuProfiler::Scope Zone(Profiler, "planet");
+
+			// Activate shader program
+			glUseProgram(ProgramId);
+
+			SetSphereUniforms(ProgramId, ModelViewProjection, NormalMatrix, LightDirection, Frame.Light);
+
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, TextureId);
+
+			GLint TextureSamplerLoc = glGetUniformLocation(ProgramId, "TextureSampler");
+			glUniform1i(TextureSamplerLoc, 0);
+
+			//glDrawArrays(GL_TRIANGLES, 0, Quad.size());
+			//glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+			//glDrawArrays(GL_POINTS, 0, SphereNumVertexes);
+			glDepthFunc(GL_LESS);
+			glDrawElements(GL_TRIANGLES, SphereNumIndexes, GL_UNSIGNED_INT, SphereIndexOffset);
+		}
+
+		if (Frame.bPlanetVisible)
+		{
+			GpuProfiler::Scope Zone(Profiler, "clouds");
+
+			// Clouds are added on top of the surface drawn with the same geometry
+			glUseProgram(CloudsProgramId);
+
+			SetSphereUniforms(CloudsProgramId, ModelViewProjection, NormalMatrix, LightDirection, Frame.Light);
+
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, CloudTextureId);
+
+			GLint CloudTextureLoc = glGetUniformLocation(CloudsProgramId, "CloudsTexture");
+			glUniform1i(CloudTextureLoc, 1);
+
+			GLint CloudsOffsetLoc = glGetUniformLocation(CloudsProgramId, "CloudsOffset");
+			glUniform2fv(CloudsOffsetLoc, 1, glm::value_ptr(Frame.CloudsOffset));
+
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_ONE, GL_ONE);
+			glDepthFunc(GL_LEQUAL);
+			glDepthMask(GL_FALSE);
+
+			glDrawElements(GL_TRIANGLES, SphereNumIndexes, GL_UNSIGNED_INT, SphereIndexOffset);
+
+			glDepthMask(GL_TRUE);
+			glDepthFunc(GL_LESS);
+			glDisable(GL_BLEND);
+		}
+
+		glBindVertexArray(0);
+
+		//Disable active program
+		glUseProgram(0);
+
+		if (Frame.bShowOverlay)
+		{
+			GpuProfiler::Scope Zone(Profiler, "overlay");
+
+			FormatProfilerOverlay(Profiler, OverlayText, sizeof(OverlayText));
+
+			size_t OverlayLength = std::strlen(OverlayText);
+			GpuResources::FormatSummary(OverlayText + OverlayLength, sizeof(OverlayText) - OverlayLength);
+
+			OverlayLength = std::strlen(OverlayText);
+			std::snprintf(OverlayText + OverlayLength, sizeof(OverlayText) - OverlayLength, "\n");
+
+			OverlayLength = std::strlen(OverlayText);
+			Uploads.FormatSummary(OverlayText + OverlayLength, sizeof(OverlayText) - OverlayLength);
+
+			OverlayLength = std::strlen(OverlayText);
+			std::snprintf(OverlayText + OverlayLength, sizeof(OverlayText) - OverlayLength, "\n");
+
+			OverlayLength = std::strlen(OverlayText);
+			Residency.FormatSummary(OverlayText + OverlayLength, sizeof(OverlayText) - OverlayLength);
+
+			OverlayLength = std::strlen(OverlayText);
+			if (Frame.StatusText != nullptr)
+			{
+				std::snprintf(OverlayText + OverlayLength, sizeof(OverlayText) - OverlayLength, "\n%s", Frame.StatusText);
+			}
+			Overlay.Draw(OverlayText, 10.0f, 10.0f, 2.0f, ViewportWidth, ViewportHeight);
+		}
+
+		Profiler.EndFrame();
+
+		// Send framebuffer content of window to be draw on screen
+		{
+			PROFILE_SCOPE("SwapBuffers");
+			glfwSwapBuffers(Window);
+		}
+
+		GLTRACE_END_FRAME();
+
+		//After the frame was submitted, so its fence covers the draws that used the freed objects
+		Heap.Update();
+		Programs.Update();
+		Textures.Update();
+		VertexArrays.Update();
+
+		const double RenderEnd = glfwGetTime();
+		Pacer.EndFrame(RenderEnd, Frame.InputSampleTime);
+		State.NextRenderStart = Pacer.GetNextRenderStart(RenderEnd);
+
+		State.Timeline.AddInterval(FrameTimeline::Track::Render, RenderBegin, RenderEnd);
+		State.Timeline.ReportIfDue(RenderEnd);
+		Pacer.ReportIfDue(RenderEnd);
+		Uploads.ReportIfDue(RenderEnd);
+		Residency.ReportIfDue(RenderEnd);
+
+		//Keep frames coming in on-demand mode until the textures are sharp
+		if (Residency.IsStreaming() || Uploads.GetNumPending() > 0)
+		{
+			State.RequestRedraw();
+		}
+
+		State.RenderedFrame = Frame.FrameIndex;
+
+		++NumRenderedFrames;
+		TotalRenderTime += RenderEnd - RenderBegin;
+	}
+
+	if (!State.BenchmarkFile.empty())
+	{
+		WriteBenchmarkReport(State.BenchmarkFile.c_str(), NumRenderedFrames, TotalRenderTime, Profiler);
+	}
+
+	// Unalocate VertexBuffer
+	DeleteMesh(Quad);
+
+	//Meshes, textures and programs
+	Assets.ReleaseAll();
+}
+
+int main(int argc, char** argv)
+{
+	const AppSettings Settings = ParseCommandLine(argc, argv);
+
+	Log::Initialize(Settings.LogFile.c_str());
+
+	//Workers for every hardware thread, this one included
+	JobSystem::Initialize();
+
+	//Files outside the archive are read without blocking the workers
+	AsyncIO::Initialize();
+
+	//Capture from the very start to profile the loading, written when the application exits
+	if (!Settings.TraceFile.empty())
+	{
+		TraceFile = Settings.TraceFile;
+		CpuProfiler::BeginCapture();
+	}
+
+	PROFILE_THREAD_NAME("Simulation");
+
+	if (!Archive.Open(Settings.ArchiveFile.c_str()))
+	{
+		std::cout << "No asset archive " << Settings.ArchiveFile << ", loading loose files" << std::endl;
+	}
+
+	// initialize GLFW
+	assert(glfwInit() == GLFW_TRUE);
+
+	// Create window
+	GLFWwindow* Window = glfwCreateWindow(Width, Height, "Blue Planet", nullptr, nullptr);
+	assert(Window);
+
+	//sign callbacks on GLFW
+	glfwSetMouseButtonCallback(Window, MouseButtonCallback);
+	glfwSetCursorPosCallback(Window, MouseMotionCallback);
+	glfwSetKeyCallback(Window, KeyCallback);
+
+	//Call Resize aways when the window aspect ratio change
+	glfwSetFramebufferSizeCallback(Window, Resize);
+
+	glfwSetWindowIconifyCallback(Window, IconifyCallback);
+	glfwSetWindowRefreshCallback(Window, RefreshCallback);
+
+	Resize(Window, Width, Height);
+
+	// GL submission runs on its own thread, this thread handles events and simulation
+	RenderThreadState State;
+	State.PacingSettings = Settings.Pacing;
+	State.UploadSettings = Settings.Uploads;
+	State.ResidencySettings = Settings.Residency;
+	State.BenchmarkFile = Settings.BenchmarkFile;
+
+	//Video modes can only be queried from the main thread
+	if (const GLFWvidmode* VideoMode = glfwGetVideoMode(glfwGetPrimaryMonitor()))
+	{
+		State.RefreshRate = VideoMode->refreshRate;
+	}
+
+	std::thread RenderThread(RenderThreadMain, Window, std::ref(State));
+
+	while (!State.bReady)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	//Bodies of the scene, world transforms are only evaluated again when one moves
+	TransformHierarchy Transforms;
+	EntityWorld Bodies;
+
+	//The sphere mesh has unit radius
+	const float PlanetRadius = 1.0f;
+
+	const TransformHierarchy::NodeId PlanetNode = Transforms.AddNode(TransformHierarchy::InvalidNode,
+		glm::vec3{ 0.0f }, glm::angleAxis(glm::radians(90.0f), glm::vec3{ 1, 0, 0 }), glm::vec3{ 1.0f });
+	const Entity Planet = Bodies.Create(BodyComponent{ PlanetNode }, BoundsComponent{ glm::vec3{ 0.0f }, PlanetRadius },
+		VisibilityComponent{ true });
+
+	// store previous frame time
+	double PreviousTime = glfwGetTime();
+
 	//Create a directional light source
 	DirectionalLight Light;
 	Light.Direction = glm::vec3{ 0.0f, 0.0f, -1.0f };
 	Light.Intensity = 1.0f;
 
-	// Start event loop
-	while (!glfwWindowShouldClose(Window))
+	//Cloud layer rotation in UV units per second of world time
+	const glm::dvec2 CloudsRotationSpeed{ 0.001, 0.0 };
+
+	//State of the previous fixed step, rendering interpolates from it to the current one
+	glm::vec3 PreviousCameraLocation = Camera.Location;
+	double PreviousWorldTime = Clock.GetWorldTime();
+
+	OcclusionCuller Culler;
+
+	uint64_t FrameIndex = 0;
+
+	// What the last published frame showed, to skip frames that would look the same
+	glm::mat4 PublishedView{ 0.0f };
+	glm::vec2 PublishedCloudsOffset{ 0.0f, 0.0f };
+
+	// Keep polling at full rate while the user interacts, even in on-demand mode
+	bool bInteracting = false;
+
+	// Moving average of the simulation time, to start it just in time before rendering
+	double PredictedSimulationTime = 0.0;
+
+	// Per frame data of the graph tasks. Input is sampled before the graph runs
+	double SimulationBegin = 0.0;
+	double DeltaTime = 0.0;
+	glm::vec2 MovementInput{ 0.0f, 0.0f };
+	bool bInputEvent = false;
+	bool bMoving = false;
+	FlyCamera RenderCamera = Camera;
+	double WorldTime = 0.0;
+	glm::mat4 View{ 1.0f };
+	glm::mat4 Projection{ 1.0f };
+	glm::vec2 CloudsOffset{ 0.0f, 0.0f };
+	bool bPublish = false;
+	bool bPlanetVisible = true;
+	const char* StatusText = "";
+	FrameArena* FrameGraphArena = nullptr;
+
+	// Stages of the simulation frame, dependencies follow from what each one reads and writes
+	FrameGraph Graph;
+	const FrameGraph::ResourceId Simulation = Graph.AddResource("Simulation");
+	const FrameGraph::ResourceId Scene = Graph.AddResource("Scene");
+	const FrameGraph::ResourceId ViewState = Graph.AddResource("View");
+	const FrameGraph::ResourceId Redraw = Graph.AddResource("Redraw");
+	const FrameGraph::ResourceId Occlusion = Graph.AddResource("Occlusion");
+	const FrameGraph::ResourceId Status = Graph.AddResource("Status");
+	const FrameGraph::ResourceId Snapshot = Graph.AddResource("Snapshot");
+
+	Graph.AddTask("Simulate", {}, { Simulation }, [&]()
 	{
-		double CurrentTime = glfwGetTime();
-		double DeltaTime = CurrentTime - PreviousTime;
-		if (DeltaTime > 0.0)
+		if (Settings.bOnDemand && !bMoving && !bInputEvent)
 		{
-			PreviousTime = CurrentTime;
+			// Idle: only world time moves, no need to run the fixed steps for it
+			Clock.AdvanceIdle(DeltaTime);
+			PreviousCameraLocation = Camera.Location;
+			PreviousWorldTime = Clock.GetWorldTime();
+			return;
 		}
 
-		//Clear framebuffer. GL_COLOR_BUFFER_BIT clear color buffer and fullfil with the color defined on glClearColor
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// Run the simulation in fixed steps, independent of the frame rate
+		const int NumSteps = Clock.Advance(DeltaTime);
+		const float FixedStep = static_cast<float>(Clock.GetFixedStep());
 
-		// Activate shader program
-		glUseProgram(ProgramId);
+		for (int StepIndex = 0; StepIndex < NumSteps; ++StepIndex)
+		{
+			PreviousCameraLocation = Camera.Location;
+			PreviousWorldTime = Clock.GetWorldTime();
 
-		glm::mat4 NormalMatrix = glm::inverse(glm::transpose(Camera.GetView() * ModelMatrix));
-		glm::mat4 ViewProjectionMatrix = Camera.GetViewProjection();
-		glm::mat4 ModelViewProjection = ViewProjectionMatrix * ModelMatrix;
+			Camera.MoveForward(MovementInput.y * FixedStep);
+			Camera.MoveRight(MovementInput.x * FixedStep);
 
-		GLint TimeLoc = glGetUniformLocation(ProgramId, "Time");
-		glUniform1f(TimeLoc, CurrentTime);
+			Clock.Step();
+		}
+	});
 
-		GLint ModelViewProjectionLoc = glGetUniformLocation(ProgramId, "ModelViewProjection");
-		glUniformMatrix4fv(ModelViewProjectionLoc, 1, GL_FALSE, glm::value_ptr(ModelViewProjection));
+	Graph.AddTask("Transforms", { Simulation }, { Scene }, [&]()
+	{
+		if (Transforms.Update() == 0)
+		{
+			return;
+		}
 
-		GLint NormalMatrixLoc = glGetUniformLocation(ProgramId, "NormalMatrix");
-		glUniformMatrix4fv(NormalMatrixLoc, 1, GL_FALSE, glm::value_ptr(NormalMatrix));
+		Bodies.ForEach<BodyComponent, BoundsComponent>([&Transforms](const BodyComponent& Body, BoundsComponent& Bounds)
+		{
+			Bounds.Center = Transforms.GetWorldPosition(Body.Node);
+		});
+	});
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, TextureId);
+	Graph.AddTask("Camera", { Simulation }, { ViewState }, [&]()
+	{
+		// Render between the last two steps. Mouse look is not integrated over time so it is used as is
+		const double Alpha = Clock.GetAlpha();
+		WorldTime = glm::mix(PreviousWorldTime, Clock.GetWorldTime(), Alpha);
 
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, CloudTextureId);
+		RenderCamera = Camera;
+		RenderCamera.Location = glm::mix(PreviousCameraLocation, Camera.Location, static_cast<float>(Alpha));
 
-		GLint TextureSamplerLoc = glGetUniformLocation(ProgramId, "TextureSampler");
-		glUniform1i(TextureSamplerLoc, 0);
+		View = RenderCamera.GetView();
+		Projection = RenderCamera.GetProjection();
+		CloudsOffset = glm::vec2{ glm::fract(CloudsRotationSpeed * WorldTime) };
+	});
 
-		GLint CloudTextureLoc = glGetUniformLocation(ProgramId, "CloudsTexture");
-		glUniform1i(CloudTextureLoc, 1);
+	Graph.AddTask("RedrawCheck", { ViewState }, { Redraw }, [&]()
+	{
+		if (Settings.bOnDemand)
+		{
+			//Clouds only count once they moved at least one texel
+			const glm::vec2 CloudsDelta = glm::abs(CloudsOffset - PublishedCloudsOffset);
+			const glm::vec2 CloudsWrappedDelta = glm::min(CloudsDelta, 1.0f - CloudsDelta);
+			const bool bCloudsMoved = glm::max(CloudsWrappedDelta.x, CloudsWrappedDelta.y) >= State.CloudsTexelSize;
 
-		GLint LightDirectionLoc = glGetUniformLocation(ProgramId, "LightDirection");
-		glUniform3fv(LightDirectionLoc, 1, 
-			glm::value_ptr(Camera.GetView() * glm::vec4{ Light.Direction, 0.0f }));
+			const bool bViewChanged = View != PublishedView;
 
-		GLint LightIntensityLoc = glGetUniformLocation(ProgramId, "LightIntensity");
-		glUniform1f(LightIntensityLoc, Light.Intensity);
+			bInteracting = bMoving || bInputEvent || bViewChanged;
 
-		//glBindVertexArray(QuadVAO);
-		glBindVertexArray(SphereVAO);
+			if (FrameIndex > 0 && !bInteracting && !bCloudsMoved)
+			{
+				bPublish = false;
+				return;
+			}
+		}
 
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		bPublish = true;
+		PublishedView = View;
+		PublishedCloudsOffset = CloudsOffset;
+	});
 
-		//glDrawArrays(GL_TRIANGLES, 0, Quad.size());
-		//glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-		//glDrawArrays(GL_POINTS, 0, SphereNumVertexes);
-		glDepthFunc(GL_LESS);
-		glDrawElements(GL_TRIANGLES, SphereNumIndexes, GL_UNSIGNED_INT, nullptr);
+	//Rasterize the occluders and test the bodies before they are drawn
+	Graph.AddTask("OcclusionCulling", { Scene, ViewState, Redraw }, { Occlusion }, [&]()
+	{
+		if (!bPublish)
+		{
+			return;
+		}
 
-		glBindVertexArray(0);
+		Culler.BeginFrame(View, Projection, RenderCamera.Near);
+		Bodies.ForEach<BoundsComponent>([&Culler](const BoundsComponent& Bounds)
+		{
+			Culler.AddSphereOccluder(Bounds.Center, Bounds.Radius);
+		});
+		Culler.BuildHierarchy();
+		Bodies.ForEach<BoundsComponent, VisibilityComponent>([&Culler](const BoundsComponent& Bounds, VisibilityComponent& Visibility)
+		{
+			Visibility.bVisible = Culler.IsSphereVisible(Bounds.Center, Bounds.Radius);
+		});
+		bPlanetVisible = Bodies.Get<VisibilityComponent>(Planet).bVisible;
+	});
 
-		//Disable active program
-		glUseProgram(0);
+	Graph.AddTask("StatusText", { Simulation, Redraw }, { Status }, [&]()
+	{
+		if (!bPublish)
+		{
+			return;
+		}
+
+		FrameArena& Arena = *FrameGraphArena;
+		StatusText = Arena.Format("Time warp x%g, frame arena %.1f KB (peak %.1f of %.0f KB, %llu overflows)",
+			Clock.GetTimeWarp(), Arena.GetUsed() / 1024.0, Arena.GetHighWaterMark() / 1024.0, Arena.GetCapacity() / 1024.0,
+			static_cast<unsigned long long>(Arena.GetNumOverflows()));
+	});
+
+	Graph.AddTask("Snapshot", { Scene, ViewState, Redraw, Occlusion, Status }, { Snapshot }, [&]()
+	{
+		if (!bPublish)
+		{
+			return;
+		}
+
+		FrameSnapshot& Frame = State.Snapshots.GetWriteSlot();
+		Frame.FrameIndex = ++FrameIndex;
+		Frame.InputSampleTime = SimulationBegin;
+		Frame.Time = WorldTime;
+		Frame.CloudsOffset = CloudsOffset;
+		Frame.View = View;
+		Frame.Projection = Projection;
+		Frame.ModelMatrix = Transforms.GetWorld(PlanetNode);
+		Frame.NormalMatrix = Transforms.GetNormalMatrix(PlanetNode, View);
+		Frame.Light = Light;
+		Frame.bPlanetVisible = bPlanetVisible;
+		Frame.bShowOverlay = bShowOverlay;
+		const BoundsComponent& PlanetBounds = Bodies.Get<BoundsComponent>(Planet);
+		Frame.PlanetScreenSize = GetProjectedDiameter(View * glm::vec4{ PlanetBounds.Center, 1.0f }, PlanetBounds.Radius, Projection, Height);
+		Frame.ViewportWidth = Width;
+		Frame.ViewportHeight = Height;
+		Frame.StatusText = StatusText;
+	});
+
+	Graph.Compile();
+
+	// Start event loop
+	while (!glfwWindowShouldClose(Window))
+	{
+		MEMORY_TAG(Frame);
+
+		FrameArena& Arena = State.FrameArenas[(FrameIndex + 1) % State.FrameArenas.size()];
+		Arena.Reset();
 
 		// Process all events on GLFW event queue 
 		// Can be keyboard events, mouse or gamepad events
-		glfwPollEvents();
+		// In on-demand mode sleep until an event arrives or the idle animation tick is due
+		{
+			PROFILE_SCOPE("ProcessEvents");
 
-		// Send framebuffer content of window to be draw on screen
-		glfwSwapBuffers(Window);
+			if (Settings.bOnDemand && !bInteracting)
+			{
+				glfwWaitEventsTimeout(1.0 / Settings.IdleFrameRate);
+			}
+			else
+			{
+				glfwPollEvents();
+			}
+		}
+
+		//Nothing can be seen, stop rendering until the window is restored
+		if (bIconified || Width == 0 || Height == 0 || !glfwGetWindowAttrib(Window, GLFW_VISIBLE))
+		{
+			glfwWaitEvents();
+			continue;
+		}
+
+		PROFILE_SCOPE("SimulateFrame");
+
+		// Input is sampled as late as possible, right before the frame is simulated
+		SimulationBegin = glfwGetTime();
+
+		double CurrentTime = glfwGetTime();
+		DeltaTime = CurrentTime - PreviousTime;
+		if (DeltaTime > 0.0)
+		{
+			PreviousTime = CurrentTime;
+		}
+
+		// Sample keyboard input once per frame, it is held for all the fixed steps
+		MovementInput = glm::vec2{ 0.0f, 0.0f };
 
-		// Process keyboard input
 		if (glfwGetKey(Window, GLFW_KEY_W) == GLFW_PRESS)
 		{
-			Camera.MoveForward(1.0f * DeltaTime);
+			MovementInput.y += 1.0f;
 		}
 
 		if (glfwGetKey(Window, GLFW_KEY_S) == GLFW_PRESS)
 		{
-			Camera.MoveForward(-1.0f * DeltaTime);
+			MovementInput.y -= 1.0f;
 		}
 
 		if (glfwGetKey(Window, GLFW_KEY_A) == GLFW_PRESS)
 		{
-			Camera.MoveRight(-1.0f * DeltaTime);
+			MovementInput.x -= 1.0f;
 		}
 
 		if (glfwGetKey(Window, GLFW_KEY_D) == GLFW_PRESS)
 		{
-			Camera.MoveRight(1.0f * DeltaTime);
+			MovementInput.x += 1.0f;
+		}
+
+		bInputEvent = bInputChanged || State.bRedrawRequested.exchange(false);
+		bInputChanged = false;
+
+		bMoving = MovementInput != glm::vec2{ 0.0f, 0.0f };
+
+		//GLFW input stays on this thread, the rest of the frame is the graph
+		FrameGraphArena = &Arena;
+		Graph.Execute();
+
+		if (!bPublish)
+		{
+			continue;
+		}
+
+		State.PublishSnapshot();
+
+		if (!Settings.BenchmarkFile.empty() && FrameIndex >= Settings.BenchmarkFrames)
+		{
+			glfwSetWindowShouldClose(Window, GLFW_TRUE);
+		}
+
+		const double SimulationEnd = glfwGetTime();
+		State.Timeline.AddInterval(FrameTimeline::Track::Simulation, SimulationBegin, SimulationEnd);
+		MEMORY_END_FRAME(SimulationEnd);
+		Graph.ReportIfDue(SimulationEnd);
+		PredictedSimulationTime = glm::mix(PredictedSimulationTime, SimulationEnd - SimulationBegin, 0.1);
+
+		//Stay at most one frame ahead: frame N+1 is simulated while frame N is submitted.
+		//Just-in-time pacing trades that overlap for latency and waits for frame N to be done
+		PROFILE_SCOPE("WaitForRender");
+
+		const uint64_t MaxFramesAhead = State.PacingSettings.bJustInTime ? 0 : 1;
+		while (State.RenderedFrame + MaxFramesAhead < FrameIndex && !glfwWindowShouldClose(Window))
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+
+		//Just-in-time: the render thread tells when it will start the next frame.
+		//Wait until just before it so the next input sample is as fresh as possible
+		const double NextRenderStart = State.NextRenderStart;
+		if (NextRenderStart > 0.0)
+		{
+			const double WakeTime = NextRenderStart - PredictedSimulationTime;
+			while (glfwGetTime() < WakeTime && !glfwWindowShouldClose(Window))
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(250));
+			}
 		}
 	}
 
-	// Unalocate VertexBuffer
-	glDeleteVertexArrays(1, &QuadVAO);
+	State.bQuit = true;
+	State.WakeCondition.notify_one();
+	RenderThread.join();
+
+	GpuResources::ReportLeaks();
+	MEMORY_REPORT();
+
+	if (CpuProfiler::IsCapturing())
+	{
+		CpuProfiler::EndCapture(TraceFile.c_str());
+	}
 
 	// End GLFW
 	glfwTerminate();
 
+	//Completions schedule jobs, the I/O threads stop first
+	AsyncIO::Shutdown();
+	JobSystem::Shutdown();
+	Log::Shutdown();
+
 	
 	return 0;
-}
\ No newline at end of file
+}
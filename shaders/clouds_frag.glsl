@@ -0,0 +1,31 @@
+#version 330 core
+
+uniform sampler2D CloudsTexture;
+
+// Cloud layer offset, wrapped to [0, 1) on the CPU in double precision
+uniform vec2 CloudsOffset;
+
+in vec3 Normal;
+in vec3 Color;
+in vec2 UV;
+
+uniform vec3 LightDirection;
+uniform float LightIntensity;
+
+out vec4 OutColor;
+
+// Drawn additively over the planet surface
+void main()
+{
+	//Renormalize normal to avoid problem with linear interpolation
+	vec3 N = normalize(Normal);
+
+	//Invert light direction to calculate L vector
+	vec3 L = -normalize(LightDirection);
+
+	float Lambertian = max(dot(N, L), 0.0);
+
+	vec3 CloudColor = texture(CloudsTexture, UV + CloudsOffset).rgb;
+
+	OutColor = vec4(CloudColor * LightIntensity * Lambertian, 1.0);
+}
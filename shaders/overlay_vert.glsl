@@ -0,0 +1,14 @@
+#version 330 core
+
+layout (location = 0) in vec2 InPosition;
+layout (location = 1) in vec4 InColor;
+
+uniform mat4 ScreenTransform;
+
+out vec4 Color;
+
+void main()
+{
+	Color = InColor;
+	gl_Position = ScreenTransform * vec4(InPosition, 0.0, 1.0);
+}
@@ -1,11 +1,6 @@
 #version 330 core
 
 uniform sampler2D TextureSampler;
-uniform sampler2D CloudsTexture;
-
-uniform float Time;
-
-uniform vec2 CloudsRotationSpeed = vec2(0.001, 0.0);
 
 in vec3 Normal;
 in vec3 Color;
@@ -41,8 +36,8 @@ void main()
 
 	//float ColorIntensity = 1.0f;
 	vec3 SurfaceColor = texture(TextureSampler, UV).rgb;
-	vec3 CloudColor = texture(CloudsTexture, UV + Time * CloudsRotationSpeed).rgb;
-	vec3 FinalColor = (SurfaceColor + CloudColor)* LightIntensity * Lambertian + Specular;
+	// Clouds are added on top by a second pass (clouds_frag.glsl)
+	vec3 FinalColor = SurfaceColor * LightIntensity * Lambertian + Specular;
 
 	OutColor = vec4(FinalColor, 1.0);
 }
\ No newline at end of file
@@ -5,7 +5,7 @@ layout (location = 1) in vec3 InNormal;
 layout (location = 2) in vec3 InColor;
 layout (location = 3) in vec2 InUV;
 
-uniform mat4 NormalMatrix;
+uniform mat3 NormalMatrix;
 uniform mat4 ModelViewProjection;
 
 out vec3 Normal;
@@ -14,7 +14,7 @@ out vec2 UV;
 
 void main()
 {
-	Normal = vec3(NormalMatrix * vec4(InNormal, 0.0));
+	Normal = NormalMatrix * InNormal;
 	Color = InColor;
 	UV = InUV;
 	gl_Position	= ModelViewProjection * vec4(InPosition, 1.0);